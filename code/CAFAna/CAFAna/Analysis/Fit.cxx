@@ -9,6 +9,7 @@
 #include "OscLib/func/IOscCalculator.h"
 #include "Utilities/func/MathUtil.h"
 
+#include "TDecompChol.h"
 #include "TError.h"
 #include "TGraph.h"
 #include "TH1.h"
@@ -19,6 +20,7 @@
 #include "Math/Factory.h"
 #include "Math/Functor.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
@@ -109,6 +111,8 @@ namespace ana
     // Why, when this is called for each seed?
     fCalc = seed;
     fShifts = systSeed;
+    // The cached chisq was for a different calculator
+    fGradPars.clear();
 
     if(fPrec & kIncludeSimplex) std::cout << "Simplex option specified but not implemented. Ignored." << std::endl;
     if((fPrec & kAlgoMask) == kGradDesc){
@@ -165,9 +169,20 @@ namespace ana
       }
     }
 
+    fTempAnalyticCovar.reset();
     if (fPrec & kIncludeHesse){
-      std::cout << "It's Hesse o'clock" << std::endl;
-      mnMin->Hesse();
+      // When the experiment can give us the second derivatives there's no
+      // need for Minuit to estimate them numerically
+      if(fVars.empty() && fSupportsDerivatives)
+        fTempAnalyticCovar = AnalyticCovariance(mnMin->X());
+
+      if(fTempAnalyticCovar){
+        std::cout << "It's Hesse o'clock (analytic)" << std::endl;
+      }
+      else{
+        std::cout << "It's Hesse o'clock" << std::endl;
+        mnMin->Hesse();
+      }
     }
 
     if (fPrec & kIncludeMinos){
@@ -244,11 +259,18 @@ namespace ana
         fIsValid = !thisMin->Status();
 
         delete fCovar;
-        fCovar = new TMatrixDSym(thisMin->NDim());
+        if(fTempAnalyticCovar){
+          fCovar = fTempAnalyticCovar.release();
+          for(unsigned int i = 0; i < thisMin->NDim(); ++i)
+            fPostFitErrors[i] = sqrt((*fCovar)(i, i));
+        }
+        else{
+          fCovar = new TMatrixDSym(thisMin->NDim());
 
-        for(unsigned int row = 0; row < thisMin->NDim(); ++row){
-          for(unsigned int col = 0; col < thisMin->NDim(); ++col){
-            (*fCovar)(row, col) = thisMin->CovMatrix(row, col);
+          for(unsigned int row = 0; row < thisMin->NDim(); ++row){
+            for(unsigned int col = 0; col < thisMin->NDim(); ++col){
+              (*fCovar)(row, col) = thisMin->CovMatrix(row, col);
+            }
           }
         }
 
@@ -381,8 +403,14 @@ namespace ana
       penalty += fSysts[j]->Penalty(pars[fVars.size()+j]);
     }
 
-    if(fNEval%1000 == 0) std::cout << fNEval << ": EXPT chi2 = " << fExpt->ChiSq(fCalc, fShifts) << "; penalty = " << penalty << std::endl;
-    return fExpt->ChiSq(fCalc, fShifts) + penalty;
+    // Minuit generally asks for the gradient and the value at the same
+    // point. Gradient() already evaluated the chisq alongside the derivatives
+    const bool cached = (fGradPars.size() == NDim() &&
+                         std::equal(pars, pars+NDim(), fGradPars.begin()));
+    const double chi = cached ? fGradChi : fExpt->ChiSq(fCalc, fShifts);
+
+    if(fNEval%1000 == 0) std::cout << fNEval << ": EXPT chi2 = " << chi << "; penalty = " << penalty << std::endl;
+    return chi + penalty;
   }
 
   //----------------------------------------------------------------------
@@ -410,7 +438,9 @@ namespace ana
 
     std::unordered_map<const ISyst*, double> dchi;
     for(const ISyst* s: fSysts) dchi[s] = 0;
-    fExpt->Derivative(fCalc, fShifts, dchi);
+    // Save the chisq too, in case DoEval() is asked for the same point
+    fGradChi = fExpt->ChiSqAndDerivative(fCalc, fShifts, dchi);
+    fGradPars.assign(pars, pars+NDim());
 
     for(unsigned int j = 0; j < fSysts.size(); ++j){
       // Get the un-truncated systematic shift
@@ -420,6 +450,40 @@ namespace ana
     }
   }
 
+  //----------------------------------------------------------------------
+  std::unique_ptr<TMatrixDSym> Fitter::AnalyticCovariance(const double* pars) const
+  {
+    assert(fVars.empty());
+
+    DecodePars(pars); // Updates fCalc and fShifts
+
+    const unsigned int S = fSysts.size();
+    std::vector<double> hess;
+    fExpt->Hessian(fCalc, fShifts, fSysts, hess);
+    if(hess.size() != S*S) return 0; // experiment doesn't implement it
+
+    TMatrixDSym h(S);
+    for(unsigned int i = 0; i < S; ++i){
+      for(unsigned int j = 0; j < S; ++j) h(i, j) = hess[i*S+j];
+      h(i, i) += fSysts[i]->PenaltySecondDerivative(pars[i]);
+    }
+
+    // A positive determinant doesn't rule out pairs of negative eigenvalues,
+    // but the Cholesky decomposition only exists for positive definite
+    // matrices
+    TDecompChol chol(h);
+    auto ret = std::make_unique<TMatrixDSym>(S);
+    if(!chol.Decompose() || !chol.Invert(*ret)){
+      std::cout << "Fitter: analytic Hessian is not positive definite, "
+                << "falling back to numerical estimate" << std::endl;
+      return 0;
+    }
+
+    // Minuit's convention for a chisq (UP = 1) is twice the inverse Hessian
+    *ret *= 2;
+    return ret;
+  }
+
   //----------------------------------------------------------------------
   TH1* Profile(const IExperiment* expt,
 	       osc::IOscCalculatorAdjustable* calc, const IFitVar* v,
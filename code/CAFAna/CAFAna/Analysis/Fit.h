@@ -7,6 +7,7 @@
 #include "CAFAna/Analysis/SeedList.h"
 
 #include "Math/Minimizer.h"
+#include "TMatrixDSym.h"
 
 #include <memory>
 
@@ -178,6 +179,13 @@ namespace ana
     /// Updates mutable fCalc and fShifts
     void DecodePars(const double* pars) const;
 
+    /// \brief Covariance of the systs from the Hessian given by the
+    /// experiment
+    ///
+    /// Null if the experiment doesn't implement \ref IExperiment::Hessian, or
+    /// it isn't positive definite. Only valid without any fVars.
+    std::unique_ptr<TMatrixDSym> AnalyticCovariance(const double* pars) const;
+
     /// Intended to be called only once (from constructor) to initialize
     /// fSupportsDerivatives
     bool SupportsDerivatives() const;
@@ -193,6 +201,9 @@ namespace ana
 
     mutable int fNEval = 0;
     mutable int fNEvalGrad = 0;
+    /// Point and result of the last ChiSqAndDerivative() in \ref Gradient
+    mutable std::vector<double> fGradPars;
+    mutable double fGradChi = 0;
     mutable int fNEvalFiniteDiff = 0;
 
     // Some information for post-fit evaluation if necessary
@@ -207,6 +218,7 @@ namespace ana
     mutable std::vector<double> fPostFitErrors;
     mutable std::vector<std::pair<double, double> > fMinosErrors;
     mutable std::vector<std::pair<double, double> > fTempMinosErrors; // Bit of a hack
+    mutable std::unique_ptr<TMatrixDSym> fTempAnalyticCovar; // Likewise
   };
 
   // Modern C++ thinks that enum | enum == int. Make things work like we expect
@@ -0,0 +1,361 @@
+#include "CAFAna/Analysis/OscCalculatorGrid.h"
+
+#include "CAFAna/Core/IFitVar.h"
+#include "CAFAna/Core/OscCurve.h"
+#include "CAFAna/Core/Progress.h"
+
+#include "TMD5.h"
+#include "TRandom3.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+namespace ana
+{
+  namespace
+  {
+    std::atomic<unsigned int> gNextGridID{0};
+  }
+
+  //----------------------------------------------------------------------
+  OscCalculatorGrid::OscCalculatorGrid(const osc::IOscCalculatorAdjustable& exact,
+                                       const std::vector<Axis>& axes,
+                                       const Binning& trueBins,
+                                       unsigned int nValidation)
+    : fGrid(std::make_shared<Grid>(trueBins)),
+      fExact(exact.Copy()),
+      fVersion(1), fKeyValid(false), fKeyVersion(0),
+      fDirty(true), fOnGrid(false),
+      fNGrid(0), fNExact(0)
+  {
+    assert(!axes.empty());
+
+    fGrid->axes = axes;
+    fGrid->energies = OscCurveSet::BinCenters(trueBins);
+    fGrid->nBins = trueBins.NBins()+2;
+    fGrid->ref.reset(exact.Copy());
+    fGrid->maxError = -1;
+    fGrid->id = gNextGridID++;
+
+    unsigned int nNodes = 1;
+    for(const Axis& a: axes){
+      if(a.nPoints < 2 || !(a.max > a.min)){
+        std::cout << "OscCalculatorGrid: axis " << a.var->ShortName()
+                  << " needs at least two points and a non-empty range"
+                  << std::endl;
+        abort();
+      }
+      nNodes *= a.nPoints;
+    }
+
+    const unsigned int nBins = fGrid->nBins;
+    const int K = OscCurveSet::kNChannels;
+    fGrid->probs.resize(nNodes*K*nBins);
+
+    std::unique_ptr<osc::IOscCalculatorAdjustable> calc(exact.Copy());
+
+    Progress prog("Filling oscillation probability grid");
+    for(unsigned int node = 0; node < nNodes; ++node){
+      // The first axis varies fastest
+      unsigned int rem = node;
+      for(const Axis& a: axes){
+        const unsigned int i = rem % a.nPoints;
+        rem /= a.nPoints;
+        a.var->SetValue(calc.get(), a.min + i*(a.max-a.min)/(a.nPoints-1));
+      }
+
+      const OscCurveSet curves(calc.get(), trueBins);
+      for(int sign: {+1, -1}){
+        for(int from: {12, 14, 16}){
+          for(int to: {12, 14, 16}){
+            const int chan = OscCurveSet::Index(sign*from, sign*to);
+            const double* P = curves.P(sign*from, sign*to);
+            std::copy(P, P+nBins, &fGrid->probs[(node*K+chan)*nBins]);
+          }
+        }
+      }
+
+      prog.SetProgress(double(node+1)/nNodes);
+    }
+    prog.Done();
+
+    SyncParams(exact);
+
+    if(nValidation > 0){
+      fGrid->maxError = Validate(nValidation);
+      std::cout << "OscCalculatorGrid: " << nNodes << " nodes, largest error "
+                << fGrid->maxError << " in probability at "
+                << nValidation << " random points" << std::endl;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  OscCalculatorGrid::OscCalculatorGrid(const OscCalculatorGrid& rhs)
+    : osc::IOscCalculatorAdjustable(rhs),
+      fGrid(rhs.fGrid),
+      fExact(rhs.fExact->Copy()),
+      fVersion(1), fKeyValid(false), fKeyVersion(0),
+      fDirty(true), fOnGrid(false),
+      fNGrid(0), fNExact(0)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  OscCalculatorGrid::~OscCalculatorGrid()
+  {
+  }
+
+  //----------------------------------------------------------------------
+  osc::IOscCalculatorAdjustable* OscCalculatorGrid::Copy() const
+  {
+    return new OscCalculatorGrid(*this);
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SyncParams(const osc::IOscCalculatorAdjustable& calc)
+  {
+    fL      = calc.GetL();
+    fRho    = calc.GetRho();
+    fDmsq21 = calc.GetDmsq21();
+    fDmsq32 = calc.GetDmsq32();
+    fTh12   = calc.GetTh12();
+    fTh13   = calc.GetTh13();
+    fTh23   = calc.GetTh23();
+    fdCP    = calc.GetdCP();
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetL(double L)
+  {
+    fExact->SetL(L); fL = L; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetRho(double rho)
+  {
+    fExact->SetRho(rho); fRho = rho; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetDmsq21(const double& dmsq21)
+  {
+    fExact->SetDmsq21(dmsq21); fDmsq21 = dmsq21; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetDmsq32(const double& dmsq32)
+  {
+    fExact->SetDmsq32(dmsq32); fDmsq32 = dmsq32; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetTh12(const double& th12)
+  {
+    fExact->SetTh12(th12); fTh12 = th12; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetTh13(const double& th13)
+  {
+    fExact->SetTh13(th13); fTh13 = th13; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetTh23(const double& th23)
+  {
+    fExact->SetTh23(th23); fTh23 = th23; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::SetdCP(const double& dCP)
+  {
+    fExact->SetdCP(dCP); fdCP = dCP; fDirty = true; ++fVersion;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCalculatorGrid::Locate()
+  {
+    fDirty = false;
+    fOnGrid = false;
+
+    const std::vector<Axis>& axes = fGrid->axes;
+    const unsigned int D = axes.size();
+
+    std::vector<double> vals(D);
+    std::vector<unsigned int> idxs(D);
+    std::vector<double> fracs(D);
+    for(unsigned int d = 0; d < D; ++d){
+      const Axis& a = axes[d];
+      vals[d] = a.var->GetValue(fExact.get());
+
+      const double pos = (vals[d]-a.min)/(a.max-a.min)*(a.nPoints-1);
+      // Allow for rounding right at the edges
+      if(pos < -1e-9 || pos > a.nPoints-1+1e-9) return;
+
+      idxs[d] = std::min((unsigned int)std::max(pos, 0.), a.nPoints-2);
+      fracs[d] = std::min(std::max(pos-idxs[d], 0.), 1.);
+    }
+
+    // The grid only describes the other parameters as they were when it was
+    // made. Check setting the grid variables reproduces the current point.
+    std::unique_ptr<osc::IOscCalculatorAdjustable> test(fGrid->ref->Copy());
+    for(unsigned int d = 0; d < D; ++d) axes[d].var->SetValue(test.get(), vals[d]);
+
+    auto same = [](double a, double b)
+      {
+        return fabs(a-b) <= 1e-9*std::max(fabs(a), fabs(b));
+      };
+    if(!same(test->GetL(), fL) || !same(test->GetRho(), fRho) ||
+       !same(test->GetDmsq21(), fDmsq21) || !same(test->GetDmsq32(), fDmsq32) ||
+       !same(test->GetTh12(), fTh12) || !same(test->GetTh13(), fTh13) ||
+       !same(test->GetTh23(), fTh23)) return;
+    // dCP is only defined modulo 2pi
+    if(fabs(cos(test->GetdCP())-cos(fdCP)) > 1e-9 ||
+       fabs(sin(test->GetdCP())-sin(fdCP)) > 1e-9) return;
+
+    // All the corners of the cell we're in
+    fNodes.clear();
+    fWeights.clear();
+    for(unsigned int corner = 0; corner < (1u << D); ++corner){
+      unsigned int node = 0;
+      unsigned int stride = 1;
+      double w = 1;
+      for(unsigned int d = 0; d < D; ++d){
+        const bool up = corner & (1u << d);
+        node += (idxs[d] + up)*stride;
+        stride *= axes[d].nPoints;
+        w *= up ? fracs[d] : 1-fracs[d];
+      }
+      if(w == 0) continue;
+      fNodes.push_back(node);
+      fWeights.push_back(w);
+    }
+
+    fOnGrid = true;
+  }
+
+  //----------------------------------------------------------------------
+  int OscCalculatorGrid::EnergyBin(double E) const
+  {
+    const int bin = fGrid->trueBins.FindBin(E);
+
+    // FindBin only has float precision, so check the neighbours too
+    for(int b = std::max(bin-1, 0); b <= std::min(bin+1, int(fGrid->nBins)-1); ++b){
+      if(fabs(fGrid->energies[b]-E) <= 1e-9*std::max(fabs(E), 1.)) return b;
+    }
+    return -1;
+  }
+
+  //----------------------------------------------------------------------
+  double OscCalculatorGrid::P(int from, int to, double E)
+  {
+    if(fDirty) Locate();
+
+    if(fOnGrid){
+      const int chan = OscCurveSet::Index(from, to);
+      const int bin = chan >= 0 ? EnergyBin(E) : -1;
+
+      if(bin >= 0){
+        ++fNGrid;
+
+        const unsigned int nBins = fGrid->nBins;
+        const int K = OscCurveSet::kNChannels;
+        const double* probs = fGrid->probs.data();
+
+        double ret = 0;
+        for(unsigned int i = 0; i < fNodes.size(); ++i)
+          ret += fWeights[i]*probs[(fNodes[i]*K+chan)*nBins+bin];
+        return ret;
+      }
+    }
+
+    ++fNExact;
+    return fExact->P(from, to, E);
+  }
+
+  //----------------------------------------------------------------------
+  TMD5* OscCalculatorGrid::GetParamsHash() const
+  {
+    TMD5* exact = fExact->GetParamsHash();
+    if(!exact) return 0;
+
+    // Same parameters, but not the same answers as the exact calculator
+    TMD5* ret = new TMD5;
+    const std::string str = std::string("OscCalculatorGrid")+exact->AsString()+
+      std::to_string(fGrid->id);
+    ret->Update((const unsigned char*)str.c_str(), str.size());
+    ret->Final();
+
+    delete exact;
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  bool OscCalculatorGrid::CalcKey(std::string& key) const
+  {
+    if(fKeyVersion != fVersion){
+      fKeyValid = GetOscCalcKey(fExact.get(), fKey);
+      fKey += ":OscCalculatorGrid"+std::to_string(fGrid->id);
+      fKeyVersion = fVersion;
+    }
+
+    key = fKey;
+    return fKeyValid;
+  }
+
+  //----------------------------------------------------------------------
+  double OscCalculatorGrid::Validate(unsigned int nPoints, unsigned int seed) const
+  {
+    TRandom3 rng(seed);
+
+    // Start both from the point the grid was made at, so that only the
+    // gridded parameters differ
+    const osc::IOscCalculatorAdjustable& ref = *fGrid->ref;
+    OscCalculatorGrid grid(*this);
+    grid.SetL(ref.GetL());
+    grid.SetRho(ref.GetRho());
+    grid.SetDmsq21(ref.GetDmsq21());
+    grid.SetDmsq32(ref.GetDmsq32());
+    grid.SetTh12(ref.GetTh12());
+    grid.SetTh13(ref.GetTh13());
+    grid.SetTh23(ref.GetTh23());
+    grid.SetdCP(ref.GetdCP());
+    std::unique_ptr<osc::IOscCalculatorAdjustable> exact(ref.Copy());
+
+    double maxErr = 0;
+
+    for(unsigned int n = 0; n < nPoints; ++n){
+      for(const Axis& a: fGrid->axes){
+        const double val = rng.Uniform(a.min, a.max);
+        a.var->SetValue(&grid, val);
+        a.var->SetValue(exact.get(), val);
+      }
+
+      for(unsigned int bin = 0; bin < fGrid->nBins; ++bin){
+        const double E = fGrid->energies[bin];
+        if(E <= 0) continue;
+
+        for(int sign: {+1, -1}){
+          for(int from: {12, 14, 16}){
+            for(int to: {12, 14, 16}){
+              const double err = fabs(grid.P(sign*from, sign*to, E) -
+                                      exact->P(sign*from, sign*to, E));
+              maxErr = std::max(maxErr, err);
+            }
+          }
+        }
+      }
+    }
+
+    return maxErr;
+  }
+
+  //----------------------------------------------------------------------
+  double OscCalculatorGrid::GridFraction() const
+  {
+    if(fNGrid+fNExact == 0) return 0;
+    return double(fNGrid)/(fNGrid+fNExact);
+  }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "CAFAna/Core/Binning.h"
+#include "CAFAna/Core/OscCalcKey.h"
+
+#include "OscLib/func/IOscCalculator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ana
+{
+  class IFitVar;
+
+  /// \brief Oscillation calculator that interpolates probabilities
+  /// precomputed on a grid of the floated parameters
+  ///
+  /// Built from an exact calculator and a list of \ref IFitVar axes. The
+  /// probabilities for every channel are evaluated once at each grid node,
+  /// for the centres of \a trueBins, and afterwards \ref P interpolates them
+  /// multilinearly in the fit variables. Requests that can't be served from
+  /// the grid - other energies, points outside it, or any change to the
+  /// parameters that aren't gridded - go to the exact calculator, so results
+  /// are never silently wrong by more than the interpolation error.
+  ///
+  /// The accuracy is controlled by the number of points along each axis, and
+  /// measured on construction by comparing against the exact calculator at
+  /// random points within the grid, see \ref MaxError.
+  class OscCalculatorGrid: public osc::IOscCalculatorAdjustable,
+                           public IOscCalcKeyed
+  {
+  public:
+    struct Axis
+    {
+      const IFitVar* var;
+      unsigned int nPoints; ///< At least 2, evenly spaced including the ends
+      double min, max;
+    };
+
+    /// \param exact       Copied. Provides the values of all the parameters
+    ///                    not on the grid
+    /// \param nValidation Number of random points to compare the
+    ///                    interpolation to the exact calculator at
+    OscCalculatorGrid(const osc::IOscCalculatorAdjustable& exact,
+                      const std::vector<Axis>& axes,
+                      const Binning& trueBins = kTrueEnergyBins,
+                      unsigned int nValidation = 100);
+
+    virtual ~OscCalculatorGrid();
+
+    /// Shares the grid with the original
+    virtual osc::IOscCalculatorAdjustable* Copy() const override;
+
+    virtual double P(int from, int to, double E) override;
+
+    virtual void SetL(double L) override;
+    virtual void SetRho(double rho) override;
+    virtual void SetDmsq21(const double& dmsq21) override;
+    virtual void SetDmsq32(const double& dmsq32) override;
+    virtual void SetTh12(const double& th12) override;
+    virtual void SetTh13(const double& th13) override;
+    virtual void SetTh23(const double& th23) override;
+    virtual void SetdCP(const double& dCP) override;
+
+    /// Distinct from the exact calculator's hash at the same point
+    virtual TMD5* GetParamsHash() const override;
+
+    /// \brief Distinct from the exact calculator's key at the same point
+    ///
+    /// Only recomputed when the parameters have changed
+    virtual bool CalcKey(std::string& key) const override;
+
+    /// \brief Largest absolute difference in probability from the exact
+    /// calculator found on construction, negative if it wasn't checked
+    double MaxError() const {return fGrid->maxError;}
+
+    /// \brief Compare to the exact calculator at \a nPoints random points
+    /// within the grid, for all channels and energies
+    ///
+    /// \return The largest absolute difference found
+    double Validate(unsigned int nPoints, unsigned int seed = 0) const;
+
+    /// Fraction of \ref P calls so far served from the grid
+    double GridFraction() const;
+
+  protected:
+    struct Grid
+    {
+      Grid(const Binning& bins) : trueBins(bins) {}
+
+      std::vector<Axis> axes;
+      Binning trueBins;
+      std::vector<double> energies; ///< Bin centres, as \ref OscCurve uses
+      unsigned int nBins; ///< Including under and overflow
+      /// \brief Probabilities, indexed [(node*kNChannels+channel)*nBins+bin]
+      /// with channels numbered as \ref OscCurveSet::Index
+      std::vector<double> probs;
+      /// The calculator the grid was made with, for the non-gridded values
+      std::unique_ptr<osc::IOscCalculatorAdjustable> ref;
+      double maxError; ///< Negative if not measured
+      unsigned int id; ///< Distinguishes the grids in \ref GetParamsHash
+    };
+
+    OscCalculatorGrid(const OscCalculatorGrid& rhs);
+
+    /// Copy the parameters of \a calc into the base class' fields
+    void SyncParams(const osc::IOscCalculatorAdjustable& calc);
+
+    /// Work out where the current parameters fall on the grid, if at all
+    void Locate();
+
+    /// Energy bin \a E is the centre of, or -1
+    int EnergyBin(double E) const;
+
+    std::shared_ptr<Grid> fGrid;
+    std::unique_ptr<osc::IOscCalculatorAdjustable> fExact;
+
+    /// Incremented whenever the parameters change
+    unsigned long fVersion;
+    /// The key as of \ref fKeyVersion
+    mutable std::string fKey;
+    mutable bool fKeyValid;
+    mutable unsigned long fKeyVersion;
+
+    bool fDirty; ///< Parameters changed since \ref Locate
+    bool fOnGrid;
+    /// Nodes surrounding the current point, and their weights
+    std::vector<unsigned int> fNodes;
+    std::vector<double> fWeights;
+
+    long fNGrid, fNExact;
+  };
+}
@@ -235,6 +235,8 @@ TH1 *PRISMExtrapolator::GetMatchCoefficientsEventRate(
     FillTH1FromEigenVector(fDebugBF["last_match"].get(), NDFluxMatrix * soln);
   }
 
+  UpdateCacheTally();
+
   return fMatchCache["last_match"].get();
 }
 
@@ -348,6 +350,8 @@ TH1 *PRISMExtrapolator::GetMatchCoefficientsFlux(
       FillTH1FromEigenVector(fDebugBF[uniq_soln_name].get(),
                              NDFluxMatrix * OffAxisWeights);
     }
+
+    UpdateCacheTally();
   }
 
   return fMatchCache[uniq_soln_name].get();
@@ -362,6 +366,17 @@ TH1 *PRISMExtrapolator::GetMatchCoefficients(
              : GetMatchCoefficientsFlux(osc, max_OffAxis_m, NDMode, FDMode);
 }
 
+void PRISMExtrapolator::UpdateCacheTally() const {
+  long bytes = 0, items = 0;
+  for (auto const *cache : {&fMatchCache, &fDebugTarget, &fDebugBF}) {
+    for (auto const &it : *cache) {
+      bytes += ana::MemoryTally::HistBytes(it.second.get());
+    }
+    items += cache->size();
+  }
+  fCacheTally.Set(bytes, items);
+}
+
 void PRISMExtrapolator::Write(TDirectory *dir) {
   for (auto &fit : fMatchCache) {
     std::cout << "Writing Match: " << fit.first << std::endl;
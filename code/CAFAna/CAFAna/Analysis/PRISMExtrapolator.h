@@ -1,5 +1,7 @@
 #pragma once
 
+#include "CAFAna/Core/MemoryTally.h"
+
 #include <map>
 #include <memory>
 #include <string>
@@ -92,4 +94,8 @@ protected:
   bool fStoreDebugMatches;
   mutable std::map<std::string, std::unique_ptr<TH1>> fDebugTarget;
   mutable std::map<std::string, std::unique_ptr<TH1>> fDebugBF;
+
+  /// Accounts for everything held in the caches above
+  mutable ana::MemoryTally::Handle fCacheTally{ana::MemoryTally::kCaches};
+  void UpdateCacheTally() const;
 };
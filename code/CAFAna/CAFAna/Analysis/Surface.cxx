@@ -3,6 +3,7 @@
 #include "CAFAna/Experiment/IExperiment.h"
 #include "CAFAna/Analysis/Fit.h"
 #include "CAFAna/Core/LoadFromFile.h"
+#include "CAFAna/Core/MemoryTally.h"
 #include "CAFAna/Core/IFitVar.h"
 #include "CAFAna/Core/Progress.h"
 #include "CAFAna/Core/ThreadPool.h"
@@ -213,36 +214,6 @@ namespace ana
     }
   }
 
-  /// \brief Helper for Surface::FillSurfacePoint
-  ///
-  /// The cacheing of the nominal done in PredictionInterp is not
-  /// threadsafe. This is an inelegant but pragmatic way of surpressing it.
-  class OscCalcNoHash: public osc::IOscCalculatorAdjustable
-  {
-  public:
-    OscCalcNoHash(osc::IOscCalculatorAdjustable* c) : fCalc(c) {}
-
-    osc::IOscCalculatorAdjustable* Copy() const override
-    {
-      std::cout << "Surface::OscCalcNoHash not copyable." << std::endl;
-      abort();
-    }
-    double P(int a, int b, double E) override {return fCalc->P(a, b, E);}
-    /// Marks this calculator "unhashable" so the cacheing won't occur
-    TMD5* GetParamsHash() const override {return 0;}
-
-    // It's a shame we have to forward all the getters and setters explicitly,
-    // but I don't see how to avoid it. Take away some drudgery with a macro.
-#define F(v)\
-    void Set##v(double x) override {fCalc->Set##v(x);}\
-    double Get##v() const override {return fCalc->Get##v();}
-    F(L); F(Rho); F(Dmsq21); F(Dmsq32); F(Th12); F(Th13); F(Th23); F(dCP);
-#undef F
-
-  protected:
-    osc::IOscCalculatorAdjustable* fCalc;
-  };
-
   //----------------------------------------------------------------------
   void Surface::FillSurfacePoint(const IExperiment* expt,
                                  osc::IOscCalculatorAdjustable* calc,
@@ -253,7 +224,7 @@ namespace ana
                                  const std::map<const IFitVar*, std::vector<double>>& seedPts,
                                  const std::vector<SystShifts>& systSeedPts)
   {
-    osc::IOscCalculatorAdjustable* calcNoHash = 0; // specific to parallel mode
+    MemoryTally::Handle calcTally(MemoryTally::kCalculators);
 
     if(fParallel){
       // Need to take our own copy so that we don't get overwritten by someone
@@ -262,7 +233,7 @@ namespace ana
       xvar->SetValue(calc, x);
       yvar->SetValue(calc, y);
 
-      calcNoHash = new OscCalcNoHash(calc);
+      calcTally.Set(0, 1);
     }
 
     //Make sure that the profiled values of fitvars do not persist between steps.
@@ -270,7 +241,7 @@ namespace ana
 
     double chi;
     if(profVars.empty() && profSysts.empty()){
-      chi = expt->ChiSq(fParallel ? calcNoHash : calc);
+      chi = expt->ChiSq(calc);
     }
     else{
       Fitter fitter(expt, profVars, profSysts);
@@ -290,7 +261,6 @@ namespace ana
 
     if(fParallel){
       delete calc;
-      delete calcNoHash;
     }
   }
 
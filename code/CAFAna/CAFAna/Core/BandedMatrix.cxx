@@ -0,0 +1,155 @@
+#include "CAFAna/Core/BandedMatrix.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace ana
+{
+  //----------------------------------------------------------------------
+  BandedMatrix::BandedMatrix(const double* arr, unsigned int nx, unsigned int ny,
+                             double tolerance)
+    : fNX(nx), fNY(ny), fMaxError(0), fDropped(0)
+  {
+    assert(tolerance >= 0);
+
+    // Storing a short gap costs less than the bookkeeping for a new run
+    const unsigned int kMaxGap = 2;
+
+    std::vector<char> keep(nx*ny);
+    for(unsigned int i = 0; i < nx*ny; ++i) keep[i] = (arr[i] != 0);
+
+    std::vector<double> colTot(nx);
+    for(unsigned int y = 0; y < ny; ++y)
+      for(unsigned int x = 0; x < nx; ++x)
+        colTot[x] += std::abs(arr[y*nx+x]);
+
+    if(tolerance > 0){
+      std::vector<std::pair<double, unsigned int>> col;
+      for(unsigned int x = 0; x < nx; ++x){
+        col.clear();
+        for(unsigned int y = 0; y < ny; ++y){
+          const double v = std::abs(arr[y*nx+x]);
+          if(v) col.emplace_back(v, y);
+        }
+        std::sort(col.begin(), col.end());
+
+        const double budget = tolerance*colTot[x];
+        double dropped = 0;
+        for(const std::pair<double, unsigned int>& e: col){
+          if(dropped+e.first > budget) break;
+          dropped += e.first;
+          keep[e.second*nx+x] = false;
+        }
+      }
+    }
+
+    fRowStart.reserve(ny+1);
+    for(unsigned int y = 0; y < ny; ++y){
+      fRowStart.push_back(fRuns.size());
+
+      const double* row = arr+y*nx;
+      const char* rowKeep = &keep[y*nx];
+
+      unsigned int x = 0;
+      while(x < nx){
+        if(!rowKeep[x]){++x; continue;}
+
+        // Extend the run over any gaps short enough to be worth storing
+        unsigned int last = x;
+        for(unsigned int x2 = x+1; x2 < nx && x2 <= last+kMaxGap+1; ++x2){
+          if(rowKeep[x2]) last = x2;
+        }
+
+        fRuns.push_back({x, last-x+1, (unsigned int)fVals.size()});
+        fVals.insert(fVals.end(), row+x, row+last+1);
+        x = last+1;
+      }
+    }
+    fRowStart.push_back(fRuns.size());
+
+    fRuns.shrink_to_fit();
+    fVals.shrink_to_fit();
+
+    // Now measure what actually got left out, which the gaps may have reduced
+    std::vector<double> colDrop(nx);
+    for(unsigned int i = 0; i < nx*ny; ++i) colDrop[i%nx] += std::abs(arr[i]);
+    for(unsigned int y = 0; y < ny; ++y){
+      for(unsigned int r = fRowStart[y]; r < fRowStart[y+1]; ++r){
+        for(unsigned int x = fRuns[r].x0; x < fRuns[r].x0+fRuns[r].len; ++x){
+          colDrop[x] -= std::abs(arr[y*nx+x]);
+        }
+      }
+    }
+
+    double totDrop = 0, tot = 0;
+    for(unsigned int x = 0; x < nx; ++x){
+      if(colTot[x] == 0) continue;
+      colDrop[x] = std::max(colDrop[x], 0.); // Rounding
+      fMaxError = std::max(fMaxError, colDrop[x]/colTot[x]);
+      totDrop += colDrop[x];
+      tot += colTot[x];
+    }
+    if(tot) fDropped = totDrop/tot;
+  }
+
+  //----------------------------------------------------------------------
+  void BandedMatrix::AddWeightedTo(const double* ws, double scale,
+                                   double* arr) const
+  {
+    for(unsigned int y = 0; y < fNY; ++y){
+      const double w = scale*ws[y];
+      if(w == 0) continue;
+
+      for(unsigned int r = fRowStart[y]; r < fRowStart[y+1]; ++r){
+        const Run& run = fRuns[r];
+        const double* vals = &fVals[run.offset];
+        double* ret = arr+run.x0;
+        for(unsigned int i = 0; i < run.len; ++i) ret[i] += vals[i]*w;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void BandedMatrix::ProjectX(double* arr) const
+  {
+    for(const Run& run: fRuns){
+      const double* vals = &fVals[run.offset];
+      for(unsigned int i = 0; i < run.len; ++i) arr[run.x0+i] += vals[i];
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void BandedMatrix::ProjectY(double* arr) const
+  {
+    for(unsigned int y = 0; y < fNY; ++y){
+      for(unsigned int r = fRowStart[y]; r < fRowStart[y+1]; ++r){
+        const Run& run = fRuns[r];
+        const double* vals = &fVals[run.offset];
+        for(unsigned int i = 0; i < run.len; ++i) arr[y] += vals[i];
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void BandedMatrix::Expand(double* arr) const
+  {
+    for(unsigned int y = 0; y < fNY; ++y){
+      for(unsigned int r = fRowStart[y]; r < fRowStart[y+1]; ++r){
+        const Run& run = fRuns[r];
+        std::copy(fVals.begin()+run.offset, fVals.begin()+run.offset+run.len,
+                  arr+y*fNX+run.x0);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  long BandedMatrix::Bytes() const
+  {
+    return sizeof(*this) +
+      fRowStart.capacity()*sizeof(unsigned int) +
+      fRuns.capacity()*sizeof(Run) +
+      fVals.capacity()*sizeof(double);
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+namespace ana
+{
+  /// \brief Compact approximation of a 2D histogram dominated by a band of
+  /// significant entries
+  ///
+  /// Each row (true bin) keeps only a few contiguous runs of reco bins. Within
+  /// each column (reco bin), the smallest entries are dropped for as long as
+  /// their sum stays below \a tolerance times the column's total, and runs
+  /// separated by short gaps are merged. Exact zeros are always dropped, so a
+  /// tolerance of zero is lossless.
+  ///
+  /// Since oscillation weights lie between zero and one, the dropped sum
+  /// bounds the absolute error of any oscillated reco bin, see \ref MaxError.
+  class BandedMatrix
+  {
+  public:
+    /// \param arr In the layout of TH2::GetArray(), \a nx * \a ny entries
+    ///            including under and overflows
+    BandedMatrix(const double* arr, unsigned int nx, unsigned int ny,
+                 double tolerance);
+
+    /// arr[x] += scale * sum_y ws[y]*M[y][x]
+    void AddWeightedTo(const double* ws, double scale, double* arr) const;
+
+    /// arr[x] += sum_y M[y][x]
+    void ProjectX(double* arr) const;
+    /// arr[y] += sum_x M[y][x]
+    void ProjectY(double* arr) const;
+
+    /// Write the approximated matrix into \a arr, which must be zeroed
+    void Expand(double* arr) const;
+
+    /// \brief Largest fraction of any reco bin's unweighted content that was
+    /// dropped
+    ///
+    /// For any weights between 0 and 1 the absolute error on that bin is at
+    /// most this times its unweighted content. The error relative to the
+    /// weighted bin grows as the weights get smaller.
+    double MaxError() const {return fMaxError;}
+    /// Fraction of the total content that was dropped
+    double DroppedFraction() const {return fDropped;}
+
+    unsigned int NX() const {return fNX;}
+    unsigned int NY() const {return fNY;}
+
+    long Bytes() const;
+
+  protected:
+    struct Run
+    {
+      unsigned int x0, len;
+      unsigned int offset; ///< Into \ref fVals
+    };
+
+    unsigned int fNX, fNY;
+    std::vector<unsigned int> fRowStart; ///< Runs of row y are [fRowStart[y], fRowStart[y+1])
+    std::vector<Run> fRuns;
+    std::vector<double> fVals;
+
+    double fMaxError;
+    double fDropped;
+  };
+}
@@ -5,13 +5,16 @@
 #include "TObjString.h"
 #include "TVectorD.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace ana
 {
   int Binning::fgNextID = 0;
 
   //----------------------------------------------------------------------
   Binning::Binning()
-    : fID(-1)
+    : fLookupScale(0), fID(-1)
   {
   }
 
@@ -76,9 +79,44 @@ namespace ana
     bins.fMax = edges.back();
     bins.fIsSimple = false;
 
+    bins.BuildLookup();
+
     return bins;
   }
 
+  //----------------------------------------------------------------------
+  void Binning::BuildLookup()
+  {
+    // Aim for cells no wider than the narrowest bin, so that at most one edge
+    // falls inside any cell. Cap the size for pathological binnings, in which
+    // case FindBinCustom() just has a few more edges to step over.
+    const int kMaxLookupCells = 1<<15;
+
+    double minWidth = fMax-fMin;
+    for(int i = 0; i < fNBins; ++i)
+      minWidth = std::min(minWidth, fEdges[i+1]-fEdges[i]);
+
+    int nCells = fNBins;
+    if(minWidth > 0)
+      nCells = std::max(nCells, int(std::min(double(kMaxLookupCells),
+                                             std::ceil((fMax-fMin)/minWidth))));
+    nCells = std::min(nCells, kMaxLookupCells);
+
+    fLookupScale = nCells/(fMax-fMin);
+
+    std::vector<int>* lookup = new std::vector<int>(nCells);
+    for(int cell = 0; cell < nCells; ++cell){
+      const double lo = fMin + cell/fLookupScale;
+      // First edge above the low edge of the cell is the upper edge of the
+      // bin it's in, which by ROOT convention has the same index
+      int bin = std::upper_bound(fEdges.begin(), fEdges.end(), lo) - fEdges.begin();
+      // Keep us inside the real bins so FindBinCustom() can't walk off the end
+      (*lookup)[cell] = std::max(1, std::min(bin, fNBins));
+    }
+
+    fLookup.reset(lookup);
+  }
+
   //----------------------------------------------------------------------
   Binning Binning::Custom(const std::vector<double>& edges)
   {
@@ -111,13 +149,45 @@ namespace ana
       return bin;
     }
 
-    int bin =
-      std::lower_bound(fEdges.begin(), fEdges.end(), x) - fEdges.begin();
-    if (x == fEdges[bin]) bin++;
+    const int bin = FindBinCustom(x);
     assert(bin >= 0 && bin < (int)fEdges.size());
     return bin;
   }
 
+  //----------------------------------------------------------------------
+  void Binning::FindBins(const float* xs, int n, int* bins) const
+  {
+    if(IsSimple()){
+      // Same arithmetic as FindBin(), but with no branches on the bin
+      // structure, so the compiler is free to vectorize this loop
+      const double binwidth = (fMax - fMin) / fNBins;
+      const int overflow = fEdges.size();
+      for(int i = 0; i < n; ++i){
+        const double x = xs[i];
+        // Clamp before converting so out-of-range values stay well-defined
+        const double xc = std::min(fMax, std::max(fMin, x));
+        const int bin = (xc - fMin) / binwidth + 1;
+        bins[i] = (x < fMin) ? 0 : (x >= fMax) ? overflow : bin;
+      }
+      return;
+    }
+
+    for(int i = 0; i < n; ++i){
+      const double x = xs[i];
+      if(x < fMin)       bins[i] = 0;
+      else if(x >= fMax) bins[i] = fEdges.size();
+      else               bins[i] = FindBinCustom(x);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  std::vector<int> Binning::FindBins(const std::vector<float>& xs) const
+  {
+    std::vector<int> ret(xs.size());
+    if(!xs.empty()) FindBins(&xs.front(), xs.size(), &ret.front());
+    return ret;
+  }
+
   //----------------------------------------------------------------------
   Binning Binning::FromTAxis(const TAxis* ax)
   {
@@ -28,6 +28,12 @@ namespace ana
     double Min() const {return fMin;}
     double Max() const {return fMax;}
     int FindBin(float x) const;
+    /// \brief Find the bins of many values at once
+    ///
+    /// Same convention as \ref FindBin. \a bins must have space for \a n
+    /// entries. Cheaper than looping over FindBin for large batches.
+    void FindBins(const float* xs, int n, int* bins) const;
+    std::vector<int> FindBins(const std::vector<float>& xs) const;
     bool IsSimple() const {return fIsSimple;}
     const std::vector<double>& Edges() const
     {
@@ -52,12 +58,36 @@ namespace ana
 
     static Binning CustomHelper(const std::vector<double>& edges);
 
+    /// Fill \ref fLookup for a custom binning
+    void BuildLookup();
+    /// Bin lookup for custom binnings, assumes x is within [fMin, fMax)
+    int FindBinCustom(double x) const
+    {
+      int cell = (x-fMin)*fLookupScale;
+      if(cell < 0) cell = 0;
+      if(cell >= int(fLookup->size())) cell = fLookup->size()-1;
+      int bin = (*fLookup)[cell];
+      // The grid is fine enough that there is usually at most one edge to
+      // step over. Go back too in case rounding put us in the cell above.
+      while(x < fEdges[bin-1]) --bin;
+      while(x >= fEdges[bin]) ++bin;
+      return bin;
+    }
+
     std::vector<double> fEdges;
     std::vector<std::string> fLabels;
     int fNBins;
     double fMin, fMax;
     bool fIsSimple;
 
+    /// \brief Uniform grid over [fMin, fMax) giving the bin containing the
+    /// low edge of each cell
+    ///
+    /// Only filled for custom binnings. Shared so that copies stay cheap.
+    std::shared_ptr<const std::vector<int>> fLookup;
+    /// Number of lookup cells per unit x
+    double fLookupScale;
+
     int fID;
     /// The next ID that hasn't yet been assigned
     static int fgNextID;
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ana
+{
+  /// \brief Fixed-size key-value cache, safe to share between threads
+  ///
+  /// The entries are spread over several independently-locked shards by the
+  /// hash of their key, so threads working on different keys rarely wait for
+  /// each other. Each shard holds at most its share of the total size and
+  /// evicts its least-recently-used entry to make room.
+  ///
+  /// Values are only ever touched with their shard locked, which is why
+  /// lookup takes a function to apply to the value rather than handing out a
+  /// reference.
+  template<class K, class V, class H = std::hash<K>> class BoundedCache
+  {
+  public:
+    /// \param maxEntries Total capacity, rounded up to a multiple of \a nShards
+    BoundedCache(unsigned int maxEntries, unsigned int nShards = 8)
+      : fShards(std::max(nShards, 1u)),
+        fShardSize(std::max((maxEntries+fShards.size()-1)/fShards.size(), size_t(1)))
+    {
+    }
+
+    /// Copies start out empty
+    BoundedCache(const BoundedCache& rhs)
+      : fShards(rhs.fShards.size()), fShardSize(rhs.fShardSize)
+    {
+    }
+
+    BoundedCache& operator=(const BoundedCache&) = delete;
+
+    /// \brief Call \a f on the value stored for \a key, if there is one
+    ///
+    /// \a f is called with the shard locked, so should be quick
+    ///
+    /// \return whether \a key was found
+    template<class F> bool Visit(const K& key, F f) const
+    {
+      Shard& s = GetShard(key);
+      std::lock_guard<std::mutex> lock(s.mutex);
+
+      auto it = s.index.find(key);
+      if(it == s.index.end()) return false;
+
+      // Mark as most recently used
+      s.entries.splice(s.entries.begin(), s.entries, it->second);
+      f(const_cast<const V&>(it->second->second));
+      return true;
+    }
+
+    /// Insert or overwrite the value for \a key, evicting if necessary
+    void Insert(const K& key, V val) const
+    {
+      Shard& s = GetShard(key);
+      std::lock_guard<std::mutex> lock(s.mutex);
+
+      auto it = s.index.find(key);
+      if(it != s.index.end()){
+        it->second->second = std::move(val);
+        s.entries.splice(s.entries.begin(), s.entries, it->second);
+        return;
+      }
+
+      if(s.entries.size() >= fShardSize){
+        s.index.erase(s.entries.back().first);
+        s.entries.pop_back();
+      }
+
+      s.entries.emplace_front(key, std::move(val));
+      s.index.emplace(key, s.entries.begin());
+    }
+
+    void Clear() const
+    {
+      for(Shard& s: fShards){
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.index.clear();
+        s.entries.clear();
+      }
+    }
+
+    unsigned int Size() const
+    {
+      unsigned int ret = 0;
+      for(Shard& s: fShards){
+        std::lock_guard<std::mutex> lock(s.mutex);
+        ret += s.entries.size();
+      }
+      return ret;
+    }
+
+    unsigned int MaxSize() const {return fShardSize*fShards.size();}
+
+  protected:
+    typedef std::list<std::pair<K, V>> List_t;
+
+    struct Shard
+    {
+      std::mutex mutex;
+      List_t entries; ///< Most recently used first
+      std::unordered_map<K, typename List_t::iterator, H> index;
+    };
+
+    Shard& GetShard(const K& key) const
+    {
+      return fShards[H()(key) % fShards.size()];
+    }
+
+    mutable std::vector<Shard> fShards;
+    size_t fShardSize;
+  };
+}
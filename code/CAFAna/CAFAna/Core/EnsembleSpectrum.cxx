@@ -0,0 +1,323 @@
+#include "CAFAna/Core/EnsembleSpectrum.h"
+
+#include "CAFAna/Core/HistCache.h"
+#include "CAFAna/Core/SpectrumLoaderBase.h"
+#include "CAFAna/Core/Utilities.h"
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TObjString.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace ana
+{
+  //----------------------------------------------------------------------
+  /// Same convention as Spectrum::Bins1D()
+  static Binning FlattenBinnings(const std::vector<Binning>& bins)
+  {
+    assert(!bins.empty());
+
+    if(bins.size() == 1) return bins[0];
+
+    int n = 1;
+    for(const Binning& b: bins) n *= b.NBins();
+    return Binning::Simple(n, 0, n);
+  }
+
+  //----------------------------------------------------------------------
+  EnsembleSpectrum::EnsembleSpectrum(const std::vector<std::string>& labels,
+                                     const std::vector<Binning>& bins,
+                                     unsigned int nUniv)
+    : fLabels(labels), fBins(bins), fBins1D(FlattenBinnings(bins)),
+      fNUniv(nUniv),
+      fNomData(Stride()), fNomSumW2(Stride()),
+      fData(nUniv*Stride()),
+      fPOT(0), fLivetime(0)
+  {
+    fTally.Set((fData.size()+fNomData.size()+fNomSumW2.size())*sizeof(double),
+               fNUniv+1);
+  }
+
+  //----------------------------------------------------------------------
+  EnsembleSpectrum::EnsembleSpectrum(SpectrumLoaderBase& loader,
+                                     const HistAxis& axis,
+                                     const Cut& cut,
+                                     const MultiVar& univWeis,
+                                     unsigned int nUniv,
+                                     const SystShifts& shift,
+                                     const Var& wei)
+    : EnsembleSpectrum(axis.GetLabels(), axis.GetBinnings(), nUniv)
+  {
+    fUnivWeis = std::make_unique<MultiVar>(univWeis);
+
+    loader.AddEnsembleSpectrum(*this, axis.GetMultiDVar(), cut, shift, wei);
+  }
+
+  //----------------------------------------------------------------------
+  EnsembleSpectrum::EnsembleSpectrum(SpectrumLoaderBase& loader,
+                                     const HistAxis& axis,
+                                     const Cut& cut,
+                                     const MultiVar& univVars,
+                                     const MultiVar& univWeis,
+                                     unsigned int nUniv,
+                                     const SystShifts& shift,
+                                     const Var& wei)
+    : EnsembleSpectrum(axis.GetLabels(), axis.GetBinnings(), nUniv)
+  {
+    fUnivVars = std::make_unique<MultiVar>(univVars);
+    fUnivWeis = std::make_unique<MultiVar>(univWeis);
+
+    loader.AddEnsembleSpectrum(*this, axis.GetMultiDVar(), cut, shift, wei);
+  }
+
+  //----------------------------------------------------------------------
+  EnsembleSpectrum::~EnsembleSpectrum()
+  {
+    for(SpectrumLoaderBase* loader: fLoaderCount)
+      loader->RemoveEnsembleSpectrum(this);
+  }
+
+  //----------------------------------------------------------------------
+  EnsembleSpectrum::EnsembleSpectrum(const EnsembleSpectrum& rhs)
+    : fLabels(rhs.fLabels), fBins(rhs.fBins), fBins1D(rhs.fBins1D),
+      fNUniv(rhs.fNUniv),
+      fUnivVars(rhs.fUnivVars ? std::make_unique<MultiVar>(*rhs.fUnivVars) : 0),
+      fUnivWeis(rhs.fUnivWeis ? std::make_unique<MultiVar>(*rhs.fUnivWeis) : 0),
+      fNomData(rhs.fNomData), fNomSumW2(rhs.fNomSumW2),
+      fData(rhs.fData),
+      fTally(rhs.fTally),
+      fPOT(rhs.fPOT), fLivetime(rhs.fLivetime)
+  {
+    assert( rhs.fLoaderCount.empty() ); // Copying with pending loads is unexpected
+  }
+
+  //----------------------------------------------------------------------
+  void EnsembleSpectrum::Fill(double x, double w, const caf::StandardRecord* sr)
+  {
+    const unsigned int N = Stride();
+
+    const int nomBin = fBins1D.FindBin(x);
+    fNomData[nomBin] += w;
+    fNomSumW2[nomBin] += w*w;
+
+    const std::vector<double> ws = (*fUnivWeis)(sr);
+    if(ws.size() != fNUniv){
+      std::cout << "EnsembleSpectrum: universe weights returned " << ws.size()
+                << " entries, expected " << fNUniv << std::endl;
+      abort();
+    }
+
+    if(!fUnivVars){
+      // All universes share the one bin
+      double* arr = &fData[nomBin];
+      for(unsigned int u = 0; u < fNUniv; ++u) arr[u*N] += w*ws[u];
+      return;
+    }
+
+    const std::vector<double> xs = (*fUnivVars)(sr);
+    if(xs.size() != fNUniv){
+      std::cout << "EnsembleSpectrum: universe vars returned " << xs.size()
+                << " entries, expected " << fNUniv << std::endl;
+      abort();
+    }
+
+    for(unsigned int u = 0; u < fNUniv; ++u){
+      fData[u*N + fBins1D.FindBin(xs[u])] += w*ws[u];
+    }
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum EnsembleSpectrum::Nominal() const
+  {
+    DontAddDirectory guard;
+
+    TH1D* h = HistCache::New("", fBins1D);
+    if(h->GetSumw2N() == 0) h->Sumw2();
+    double* arr = h->GetArray();
+    double* sumw2 = h->GetSumw2()->GetArray();
+    for(unsigned int i = 0; i < Stride(); ++i){
+      arr[i] = fNomData[i];
+      sumw2[i] = fNomSumW2[i];
+    }
+
+    return Spectrum(std::unique_ptr<TH1D>(h), fLabels, fBins, fPOT, fLivetime);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum EnsembleSpectrum::Universe(unsigned int univIdx) const
+  {
+    assert(univIdx < fNUniv);
+
+    DontAddDirectory guard;
+
+    TH1D* h = HistCache::New("", fBins1D);
+    double* arr = h->GetArray();
+    const double* src = &fData[univIdx*Stride()];
+    for(unsigned int i = 0; i < Stride(); ++i) arr[i] = src[i];
+
+    return Spectrum(std::unique_ptr<TH1D>(h), fLabels, fBins, fPOT, fLivetime);
+  }
+
+  //----------------------------------------------------------------------
+  std::unique_ptr<TMatrixD> EnsembleSpectrum::
+  CovarianceMatrix(double exposure, bool fractional, bool aboutMean) const
+  {
+    const unsigned int N = Stride();
+    const int nBins = fBins1D.NBins();
+
+    if(fNUniv < 2 && aboutMean) return std::unique_ptr<TMatrixD>(nullptr);
+
+    const double scale = (fPOT > 0) ? exposure/fPOT : 1;
+
+    // Reference point for the deviations, skipping the underflow bin
+    std::vector<double> ref(nBins);
+    if(aboutMean){
+      for(unsigned int u = 0; u < fNUniv; ++u)
+        for(int i = 0; i < nBins; ++i) ref[i] += fData[u*N+i+1];
+      for(int i = 0; i < nBins; ++i) ref[i] /= fNUniv;
+    }
+    else{
+      for(int i = 0; i < nBins; ++i) ref[i] = fNomData[i+1];
+    }
+
+    auto covmx = std::make_unique<TMatrixD>(nBins, nBins);
+    TMatrixD& cov = *covmx;
+
+    std::vector<double> dev(nBins);
+    for(unsigned int u = 0; u < fNUniv; ++u){
+      const double* univ = &fData[u*N+1];
+      for(int i = 0; i < nBins; ++i) dev[i] = univ[i]-ref[i];
+
+      for(int i = 0; i < nBins; ++i){
+        for(int j = i; j < nBins; ++j) cov(i, j) += dev[i]*dev[j];
+      }
+    }
+
+    const double norm = aboutMean ? 1./(fNUniv-1) : 1./fNUniv;
+
+    for(int i = 0; i < nBins; ++i){
+      for(int j = i; j < nBins; ++j){
+        double c = cov(i, j)*norm;
+
+        if(fractional){
+          const double nom = fNomData[i+1]*fNomData[j+1];
+          c = (nom > 0) ? c/nom : 0;
+        }
+        else{
+          c *= scale*scale;
+        }
+
+        // Covariance matrices are always symmetric
+        cov(i, j) = c;
+        cov(j, i) = c;
+      }
+    }
+
+    return covmx;
+  }
+
+  //----------------------------------------------------------------------
+  void EnsembleSpectrum::RemoveLoader(SpectrumLoaderBase* p)
+  { fLoaderCount.erase(p); }
+
+  //----------------------------------------------------------------------
+  void EnsembleSpectrum::AddLoader(SpectrumLoaderBase* p)
+  { fLoaderCount.insert(p); }
+
+  //----------------------------------------------------------------------
+  void EnsembleSpectrum::SaveTo(TDirectory* dir) const
+  {
+    TDirectory* tmp = gDirectory;
+    dir->cd();
+
+    TObjString("EnsembleSpectrum").Write("type");
+
+    const unsigned int N = Stride();
+
+    // Bin numbers, including under and overflow, on x. Universes on y, with
+    // the nominal in the first row
+    TH2D hist("", "", N, 0, N, fNUniv+1, 0, fNUniv+1);
+    TH1D hNomSumW2("", "", N, 0, N);
+    for(unsigned int i = 0; i < N; ++i){
+      hist.SetBinContent(i+1, 1, fNomData[i]);
+      hNomSumW2.SetBinContent(i+1, fNomSumW2[i]);
+      for(unsigned int u = 0; u < fNUniv; ++u)
+        hist.SetBinContent(i+1, u+2, fData[u*N+i]);
+    }
+    hist.Write("hist");
+    hNomSumW2.Write("nom_sumw2");
+
+    TH1D hPot("", "", 1, 0, 1);
+    hPot.Fill(.5, fPOT);
+    hPot.Write("pot");
+    TH1D hLivetime("", "", 1, 0, 1);
+    hLivetime.Fill(.5, fLivetime);
+    hLivetime.Write("livetime");
+
+    for(unsigned int i = 0; i < fBins.size(); ++i){
+      TObjString(fLabels[i].c_str()).Write(TString::Format("label%d", i).Data());
+      fBins[i].SaveTo(dir->mkdir(TString::Format("bins%d", i)));
+    }
+
+    tmp->cd();
+  }
+
+  //----------------------------------------------------------------------
+  std::unique_ptr<EnsembleSpectrum> EnsembleSpectrum::LoadFrom(TDirectory* dir)
+  {
+    DontAddDirectory guard;
+
+    TObjString* tag = (TObjString*)dir->Get("type");
+    assert(tag);
+    assert(tag->GetString() == "EnsembleSpectrum");
+    delete tag;
+
+    TH2* hist = (TH2*)dir->Get("hist");
+    assert(hist);
+    TH1* hNomSumW2 = (TH1*)dir->Get("nom_sumw2");
+    assert(hNomSumW2);
+    TH1* hPot = (TH1*)dir->Get("pot");
+    assert(hPot);
+    TH1* hLivetime = (TH1*)dir->Get("livetime");
+    assert(hLivetime);
+
+    std::vector<std::string> labels;
+    std::vector<Binning> bins;
+    for(int i = 0; ; ++i){
+      TDirectory* subdir = dir->GetDirectory(TString::Format("bins%d", i));
+      if(!subdir) break;
+      bins.push_back(*Binning::LoadFrom(subdir));
+      TObjString* label = (TObjString*)dir->Get(TString::Format("label%d", i));
+      labels.push_back(label ? label->GetString().Data() : "");
+      delete subdir;
+      delete label;
+    }
+
+    const unsigned int nUniv = hist->GetNbinsY()-1;
+
+    std::unique_ptr<EnsembleSpectrum> ret(new EnsembleSpectrum(labels, bins, nUniv));
+
+    const unsigned int N = ret->Stride();
+    assert(int(N) == hist->GetNbinsX());
+
+    for(unsigned int i = 0; i < N; ++i){
+      ret->fNomData[i] = hist->GetBinContent(i+1, 1);
+      ret->fNomSumW2[i] = hNomSumW2->GetBinContent(i+1);
+      for(unsigned int u = 0; u < nUniv; ++u)
+        ret->fData[u*N+i] = hist->GetBinContent(i+1, u+2);
+    }
+
+    ret->fPOT = hPot->GetBinContent(1);
+    ret->fLivetime = hLivetime->GetBinContent(1);
+
+    delete hist;
+    delete hNomSumW2;
+    delete hPot;
+    delete hLivetime;
+
+    return ret;
+  }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CAFAna/Core/Binning.h"
+#include "CAFAna/Core/Cut.h"
+#include "CAFAna/Core/HistAxis.h"
+#include "CAFAna/Core/MemoryTally.h"
+#include "CAFAna/Core/MultiVar.h"
+#include "CAFAna/Core/Spectrum.h"
+#include "CAFAna/Core/SystShifts.h"
+#include "CAFAna/Core/Var.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TMatrixD.h"
+
+class TDirectory;
+
+namespace caf{class StandardRecord;}
+
+namespace ana
+{
+  class SpectrumLoaderBase;
+
+  /// \brief A nominal spectrum plus N systematically-varied universes, all
+  /// filled in a single pass over the events
+  ///
+  /// Each event that passes the cut is filled into every universe using one
+  /// evaluation of the cut, var, and weight. The per-universe variation comes
+  /// from a \ref MultiVar that returns one weight per universe (eg a set of
+  /// GENIE universe weights, or a seeded throw of flux/xsec systematics). The
+  /// universes may also supply their own values of the variable, to describe
+  /// energy-scale type uncertainties that move events between bins.
+  ///
+  /// The universe contents are stored contiguously, universe-major, with
+  /// the same under/overflow convention as TH1.
+  class EnsembleSpectrum
+  {
+  public:
+    friend class SpectrumLoaderBase;
+    friend class SpectrumLoader;
+    friend class NullLoader;
+
+    /// \param univWeis Returns one weight per universe for each event. These
+    ///                 multiply the nominal weight \a wei
+    /// \param nUniv    Number of universes. \a univWeis must always return
+    ///                 this many entries
+    EnsembleSpectrum(SpectrumLoaderBase& loader,
+                     const HistAxis& axis,
+                     const Cut& cut,
+                     const MultiVar& univWeis,
+                     unsigned int nUniv,
+                     const SystShifts& shift = kNoShift,
+                     const Var& wei = kUnweighted);
+
+    /// \param univVars Returns the value of the axis variable in each
+    ///                 universe, to be used instead of the nominal value. For
+    ///                 multi-dimensional axes this must already be flattened
+    ///                 in the same way as \ref Var2D
+    /// \param univWeis As above
+    EnsembleSpectrum(SpectrumLoaderBase& loader,
+                     const HistAxis& axis,
+                     const Cut& cut,
+                     const MultiVar& univVars,
+                     const MultiVar& univWeis,
+                     unsigned int nUniv,
+                     const SystShifts& shift = kNoShift,
+                     const Var& wei = kUnweighted);
+
+    virtual ~EnsembleSpectrum();
+
+    EnsembleSpectrum(const EnsembleSpectrum& rhs);
+    EnsembleSpectrum& operator=(const EnsembleSpectrum& rhs) = delete;
+
+    unsigned int NUniverses() const {return fNUniv;}
+
+    double POT() const {return fPOT;}
+    double Livetime() const {return fLivetime;}
+
+    /// The spectrum filled with the nominal weight and variable
+    Spectrum Nominal() const;
+    /// The spectrum in universe \a univIdx
+    Spectrum Universe(unsigned int univIdx) const;
+
+    /// \brief Bin-to-bin covariance across the universes
+    ///
+    /// Over and underflow bins are not included. For multi-dimensional axes
+    /// the bins are ordered the same way as the flattened 1D spectrum.
+    ///
+    /// \param exposure   POT to scale to. The fractional form doesn't depend
+    ///                   on this
+    /// \param fractional Divide each element by the nominal contents of the
+    ///                   two bins involved. Elements involving an empty
+    ///                   nominal bin are zero
+    /// \param aboutMean  Measure deviations from the ensemble mean (with the
+    ///                   usual N-1) rather than from the nominal spectrum
+    std::unique_ptr<TMatrixD> CovarianceMatrix(double exposure,
+                                               bool fractional = false,
+                                               bool aboutMean = false) const;
+
+    void SaveTo(TDirectory* dir) const;
+    static std::unique_ptr<EnsembleSpectrum> LoadFrom(TDirectory* dir);
+
+  protected:
+    /// Constructor for LoadFrom. No vars, so can't be filled
+    EnsembleSpectrum(const std::vector<std::string>& labels,
+                     const std::vector<Binning>& bins,
+                     unsigned int nUniv);
+
+    /// Number of entries per universe in fData, including under/overflow
+    unsigned int Stride() const {return fBins1D.NBins()+2;}
+
+    /// Called by the loader for each event passing the cut
+    void Fill(double x, double w, const caf::StandardRecord* sr);
+
+    void RemoveLoader(SpectrumLoaderBase*);
+    void AddLoader(SpectrumLoaderBase*);
+
+    std::vector<std::string> fLabels;
+    std::vector<Binning> fBins;
+    Binning fBins1D;
+
+    unsigned int fNUniv;
+
+    /// May be null, in which case universes use the nominal value
+    std::unique_ptr<MultiVar> fUnivVars;
+    /// May be null if loaded from file
+    std::unique_ptr<MultiVar> fUnivWeis;
+
+    /// Nominal contents and sum of weights squared
+    std::vector<double> fNomData, fNomSumW2;
+
+    /// Indexed [universe][bin]
+    std::vector<double> fData;
+    MemoryTally::Handle fTally{MemoryTally::kSpectra};
+
+    double fPOT;
+    double fLivetime;
+
+    /// This count is maintained by SpectrumLoader, as a sanity check
+    std::set<SpectrumLoaderBase*> fLoaderCount;
+  };
+}
@@ -0,0 +1,499 @@
+#include "CAFAna/Core/EventList.h"
+
+#include "CAFAna/Core/ISyst.h"
+#include "CAFAna/Core/SpectrumLoaderBase.h"
+#include "CAFAna/Core/SystRegistry.h"
+#include "CAFAna/Core/Utilities.h"
+
+#include "StandardRecord/StandardRecord.h"
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TObjString.h"
+#include "TVectorD.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace ana
+{
+  //----------------------------------------------------------------------
+  template<class T> static TVectorD ToTVectorD(const std::vector<T>& v)
+  {
+    TVectorD ret(v.size());
+    for(unsigned int i = 0; i < v.size(); ++i) ret[i] = v[i];
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  /// Missing entries are only allowed if \a optional
+  template<class T> static std::vector<T> FromTVectorD(TDirectory* dir,
+                                                       const std::string& name,
+                                                       bool optional = false)
+  {
+    TVectorD* v = (TVectorD*)dir->Get(name.c_str());
+    if(!v && optional) return {};
+    assert(v);
+    std::vector<T> ret(v->GetNrows());
+    for(unsigned int i = 0; i < ret.size(); ++i) ret[i] = T((*v)[i]);
+    delete v;
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  int EventList::CCChannel(int from, int to)
+  {
+    if((from > 0) != (to > 0)) return -1;
+
+    int ret = (from < 0) ? 6 : 0;
+
+    switch(abs(from)){
+    case 12: break;
+    case 14: ret += 3; break;
+    default: return -1;
+    }
+
+    switch(abs(to)){
+    case 12: break;
+    case 14: ret += 1; break;
+    case 16: ret += 2; break;
+    default: return -1;
+    }
+
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  int EventList::ChannelFrom(int chan)
+  {
+    assert(chan >= 0 && chan < kNCChannels);
+    const int pdg = ((chan%6)/3 == 0) ? 12 : 14;
+    return (chan < 6) ? pdg : -pdg;
+  }
+
+  //----------------------------------------------------------------------
+  int EventList::ChannelTo(int chan)
+  {
+    assert(chan >= 0 && chan < kNCChannels);
+    const int pdg = 12+2*(chan%3);
+    return (chan < 6) ? pdg : -pdg;
+  }
+
+  //----------------------------------------------------------------------
+  EventList::EventList(const std::string& label,
+                       const Binning& bins,
+                       const Binning& trueBins)
+    : fLabel(label), fBins(bins), fTrueBins(trueBins),
+      fNSelectionChanges(0),
+      fPOT(0), fLivetime(0)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  EventList::EventList(SpectrumLoaderBase& loader,
+                       const HistAxis& axis,
+                       const Cut& cut,
+                       const std::vector<const ISyst*>& systs,
+                       const SystShifts& shift,
+                       const Var& wei,
+                       const Binning& trueBins)
+    : EventList(axis.GetLabels()[0], axis.GetBinnings()[0], trueBins)
+  {
+    if(axis.GetBinnings().size() != 1){
+      std::cout << "EventList: only one-dimensional axes are supported" << std::endl;
+      abort();
+    }
+
+    fVar = std::make_unique<Var>(axis.GetMultiDVar());
+    fCut = std::make_unique<Cut>(cut);
+    fWei = std::make_unique<Var>(wei);
+
+    for(const ISyst* syst: systs){
+      // The same shifts PredictionInterp would make, but always including
+      // nominal and at least one either side of it to interpolate between
+      const int maxN = syst->PredInterpMaxNSigma();
+      const int x0 = std::min(0, std::max(-maxN, int(trunc(syst->Min()))));
+      const int x1 = std::max(x0+1, std::min(+maxN, int(trunc(syst->Max()))));
+
+      SystResponse sp;
+      sp.syst = syst;
+      sp.x0 = x0;
+      sp.nKnots = x1-x0+1;
+      fSysts.push_back(sp);
+    }
+
+    loader.AddEventList(*this, axis.GetMultiDVar(), cut, shift, wei);
+  }
+
+  //----------------------------------------------------------------------
+  EventList::~EventList()
+  {
+    for(SpectrumLoaderBase* loader: fLoaderCount)
+      loader->RemoveEventList(this);
+  }
+
+  //----------------------------------------------------------------------
+  EventList::EventList(const EventList& rhs)
+    : fLabel(rhs.fLabel), fBins(rhs.fBins), fTrueBins(rhs.fTrueBins),
+      fVar(rhs.fVar ? std::make_unique<Var>(*rhs.fVar) : 0),
+      fCut(rhs.fCut ? std::make_unique<Cut>(*rhs.fCut) : 0),
+      fWei(rhs.fWei ? std::make_unique<Var>(*rhs.fWei) : 0),
+      fX(rhs.fX), fBin(rhs.fBin), fTrueBin(rhs.fTrueBin),
+      fChannel(rhs.fChannel), fWeight(rhs.fWeight),
+      fSysts(rhs.fSysts),
+      fNSelectionChanges(rhs.fNSelectionChanges),
+      fTally(rhs.fTally),
+      fPOT(rhs.fPOT), fLivetime(rhs.fLivetime)
+  {
+    assert( rhs.fLoaderCount.empty() ); // Copying with pending loads is unexpected
+  }
+
+  //----------------------------------------------------------------------
+  void EventList::Fill(double x, double w, caf::StandardRecord* sr)
+  {
+    int chan = kNCChannel;
+    if(sr->dune.isCC){
+      chan = CCChannel(sr->dune.nuPDGunosc, sr->dune.nuPDG);
+      if(chan < 0){
+        static bool once = true;
+        if(once){
+          once = false;
+          std::cout << "EventList: skipping CC event(s) with unexpected flavours "
+                    << sr->dune.nuPDGunosc << " -> " << sr->dune.nuPDG << std::endl;
+        }
+        return;
+      }
+    }
+
+    const unsigned int idx = fWeight.size();
+    fX.push_back(x);
+    fBin.push_back(fBins.FindBin(x));
+    fTrueBin.push_back(fTrueBins.FindBin(sr->dune.Ev));
+    fChannel.push_back(chan);
+    fWeight.push_back(w);
+
+    if(fSysts.empty()) return;
+
+    // The knots are relative to this, which doesn't include the weights of
+    // any shift the whole list was made with
+    const double weiNom = (*fWei)(sr);
+
+    std::vector<float> ratios, deltas;
+    for(SystResponse& sp: fSysts){
+      ratios.assign(sp.nKnots, 1);
+      deltas.assign(sp.nKnots, 0);
+      bool responds = false;
+      bool moves = false;
+      bool fails = false;
+
+      for(unsigned int k = 0; k < sp.nKnots; ++k){
+        const int sigma = sp.x0+int(k);
+        if(sigma == 0) continue;
+
+        double systWeight = 1;
+        // Puts the record back at the end of each iteration
+        Restorer restore;
+        sp.syst->Shift(sigma, restore, sr, systWeight);
+
+        if(!restore.Empty()){
+          const double xShift = (*fVar)(sr);
+          if(!(*fCut)(sr) || std::isnan(xShift) || std::isinf(xShift)){
+            ratios[k] = 0;
+            responds = fails = true;
+            continue;
+          }
+          systWeight *= (*fWei)(sr)/weiNom;
+          deltas[k] = xShift-x;
+          if(deltas[k] != 0) moves = true;
+        }
+
+        ratios[k] = systWeight;
+        if(ratios[k] != 1) responds = true;
+      } // end for k
+
+      if(fails) ++fNSelectionChanges;
+      if(!responds && !moves) continue;
+
+      // Only start storing deltas once some event needs them
+      if(moves && sp.deltas.empty()) sp.deltas.resize(sp.ratios.size(), 0);
+
+      sp.events.push_back(idx);
+      sp.ratios.insert(sp.ratios.end(), ratios.begin(), ratios.end());
+      if(!sp.deltas.empty())
+        sp.deltas.insert(sp.deltas.end(), deltas.begin(), deltas.end());
+    } // end for sp
+  }
+
+  //----------------------------------------------------------------------
+  void EventList::InterpKnots(const SystResponse& sp, double sigma,
+                              unsigned int& knot, double& frac)
+  {
+    // Beyond the outermost knots, extrapolate the end segments
+    int k = int(std::floor(sigma))-sp.x0;
+    k = std::max(0, std::min(k, int(sp.nKnots)-2));
+
+    knot = k;
+    frac = sigma-(sp.x0+k);
+  }
+
+  //----------------------------------------------------------------------
+  void EventList::AddTo(const double* chanWeights,
+                        const SystShifts& shift,
+                        double* arr) const
+  {
+    const unsigned int N = fWeight.size();
+    const unsigned int nTrue = fTrueBins.NBins()+2;
+
+    std::vector<double> w(N);
+    for(unsigned int i = 0; i < N; ++i)
+      w[i] = fWeight[i]*chanWeights[fChannel[i]*nTrue+fTrueBin[i]];
+
+    // Only filled if some syst moves events
+    std::vector<float> xs;
+
+    for(auto it: shift){
+      const SystResponse& sp = FindSyst(it.first);
+      if(sp.events.empty()) continue;
+
+      unsigned int k;
+      double t;
+      InterpKnots(sp, it.second, k, t);
+
+      const unsigned int K = sp.nKnots;
+      const unsigned int nEntries = sp.events.size();
+
+      for(unsigned int e = 0; e < nEntries; ++e){
+        const float* r = &sp.ratios[e*K+k];
+        w[sp.events[e]] *= std::max(0., r[0]+t*(r[1]-r[0]));
+      }
+
+      if(!sp.deltas.empty()){
+        if(xs.empty()) xs = fX;
+        for(unsigned int e = 0; e < nEntries; ++e){
+          const float* d = &sp.deltas[e*K+k];
+          xs[sp.events[e]] += d[0]+t*(d[1]-d[0]);
+        }
+      }
+    } // end for it
+
+    if(xs.empty()){
+      for(unsigned int i = 0; i < N; ++i) arr[fBin[i]] += w[i];
+      return;
+    }
+
+    const std::vector<int> bins = fBins.FindBins(xs);
+    for(unsigned int i = 0; i < N; ++i) arr[bins[i]] += w[i];
+  }
+
+  //----------------------------------------------------------------------
+  const EventList::SystResponse& EventList::FindSyst(const ISyst* syst) const
+  {
+    for(const SystResponse& sp: fSysts) if(sp.syst == syst) return sp;
+
+    std::cout << "EventList: syst " << syst->ShortName()
+              << " wasn't evaluated when the events were loaded" << std::endl;
+    abort();
+  }
+
+  //----------------------------------------------------------------------
+  bool EventList::SystKnots(const ISyst* syst, int& x0, unsigned int& nKnots) const
+  {
+    for(const SystResponse& sp: fSysts){
+      if(sp.syst != syst) continue;
+      x0 = sp.x0;
+      nKnots = sp.nKnots;
+      return true;
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------
+  void EventList::AddMigrationsTo(const ISyst* syst,
+                                  const double* chanWeights,
+                                  const int* chanComps,
+                                  double* mx) const
+  {
+    const SystResponse& sp = FindSyst(syst);
+
+    const unsigned int N = fBins.NBins()+2;
+    const unsigned int NN = N*N;
+    const unsigned int K = sp.nKnots;
+    const unsigned int nTrue = fTrueBins.NBins()+2;
+
+    // Everything starts out where it was
+    for(unsigned int i = 0; i < fWeight.size(); ++i){
+      const int comp = chanComps[fChannel[i]];
+      if(comp < 0) continue;
+      const double w = fWeight[i]*chanWeights[fChannel[i]*nTrue+fTrueBin[i]];
+      const unsigned int diag = fBin[i]*N+fBin[i];
+      for(unsigned int k = 0; k < K; ++k) mx[(comp*K+k)*NN + diag] += w;
+    }
+
+    // Then the responding events are moved and reweighted
+    for(unsigned int e = 0; e < sp.events.size(); ++e){
+      const unsigned int i = sp.events[e];
+      const int comp = chanComps[fChannel[i]];
+      if(comp < 0) continue;
+      const double w = fWeight[i]*chanWeights[fChannel[i]*nTrue+fTrueBin[i]];
+      const int from = fBin[i];
+
+      for(unsigned int k = 0; k < K; ++k){
+        const float x = sp.deltas.empty() ? fX[i] : fX[i]+sp.deltas[e*K+k];
+        const int to = sp.deltas.empty() ? from : fBins.FindBin(x);
+
+        double* m = &mx[(comp*K+k)*NN];
+        m[from*N+from] -= w;
+        m[to*N+from] += w*sp.ratios[e*K+k];
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  std::vector<const ISyst*> EventList::GetAllSysts() const
+  {
+    std::vector<const ISyst*> ret;
+    for(const SystResponse& sp: fSysts) ret.push_back(sp.syst);
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  bool EventList::HasSyst(const ISyst* syst) const
+  {
+    for(const SystResponse& sp: fSysts) if(sp.syst == syst) return true;
+    return false;
+  }
+
+  //----------------------------------------------------------------------
+  void EventList::UpdateTally()
+  {
+    long bytes = fX.size()*sizeof(float) +
+      (fBin.size()+fTrueBin.size())*sizeof(int) +
+      fChannel.size() + fWeight.size()*sizeof(double);
+
+    for(const SystResponse& sp: fSysts){
+      bytes += sp.events.size()*sizeof(unsigned int) +
+        (sp.ratios.size()+sp.deltas.size())*sizeof(float);
+    }
+
+    fTally.Set(bytes);
+  }
+
+  //----------------------------------------------------------------------
+  void EventList::RemoveLoader(SpectrumLoaderBase* p)
+  { fLoaderCount.erase(p); }
+
+  //----------------------------------------------------------------------
+  void EventList::AddLoader(SpectrumLoaderBase* p)
+  { fLoaderCount.insert(p); }
+
+  //----------------------------------------------------------------------
+  void EventList::SaveTo(TDirectory* dir) const
+  {
+    TDirectory* tmp = gDirectory;
+    dir->cd();
+
+    TObjString("EventList").Write("type");
+
+    ToTVectorD(fX).Write("x");
+    ToTVectorD(fTrueBin).Write("true_bin");
+    ToTVectorD(fChannel).Write("channel");
+    ToTVectorD(fWeight).Write("weight");
+
+    TH1D hPot("", "", 1, 0, 1);
+    hPot.Fill(.5, fPOT);
+    hPot.Write("pot");
+    TH1D hLivetime("", "", 1, 0, 1);
+    hLivetime.Fill(.5, fLivetime);
+    hLivetime.Write("livetime");
+
+    TObjString(fLabel.c_str()).Write("label");
+    fBins.SaveTo(dir->mkdir("bins"));
+    fTrueBins.SaveTo(dir->mkdir("true_bins"));
+
+    for(unsigned int i = 0; i < fSysts.size(); ++i){
+      const SystResponse& sp = fSysts[i];
+
+      TDirectory* systDir = dir->mkdir(TString::Format("syst%d", i));
+      systDir->cd();
+
+      TObjString(sp.syst->ShortName().c_str()).Write("name");
+      TVectorD knots(2);
+      knots[0] = sp.x0;
+      knots[1] = sp.nKnots;
+      knots.Write("knots");
+      ToTVectorD(sp.events).Write("events");
+      ToTVectorD(sp.ratios).Write("ratios");
+      if(!sp.deltas.empty()) ToTVectorD(sp.deltas).Write("deltas");
+    }
+
+    tmp->cd();
+  }
+
+  //----------------------------------------------------------------------
+  std::unique_ptr<EventList> EventList::LoadFrom(TDirectory* dir)
+  {
+    DontAddDirectory guard;
+
+    TObjString* tag = (TObjString*)dir->Get("type");
+    assert(tag);
+    assert(tag->GetString() == "EventList");
+    delete tag;
+
+    TObjString* label = (TObjString*)dir->Get("label");
+    TDirectory* binsDir = dir->GetDirectory("bins");
+    TDirectory* trueBinsDir = dir->GetDirectory("true_bins");
+    assert(binsDir && trueBinsDir);
+
+    std::unique_ptr<EventList> ret(new EventList(label ? label->GetString().Data() : "",
+                                                 *Binning::LoadFrom(binsDir),
+                                                 *Binning::LoadFrom(trueBinsDir)));
+    delete label;
+    delete binsDir;
+    delete trueBinsDir;
+
+    ret->fX = FromTVectorD<float>(dir, "x");
+    ret->fTrueBin = FromTVectorD<int>(dir, "true_bin");
+    ret->fChannel = FromTVectorD<unsigned char>(dir, "channel");
+    ret->fWeight = FromTVectorD<double>(dir, "weight");
+    ret->fBin = ret->fBins.FindBins(ret->fX);
+
+    TH1* hPot = (TH1*)dir->Get("pot");
+    assert(hPot);
+    TH1* hLivetime = (TH1*)dir->Get("livetime");
+    assert(hLivetime);
+    ret->fPOT = hPot->GetBinContent(1);
+    ret->fLivetime = hLivetime->GetBinContent(1);
+    delete hPot;
+    delete hLivetime;
+
+    for(int i = 0; ; ++i){
+      TDirectory* systDir = dir->GetDirectory(TString::Format("syst%d", i));
+      if(!systDir) break;
+
+      TObjString* name = (TObjString*)systDir->Get("name");
+      assert(name);
+      TVectorD* knots = (TVectorD*)systDir->Get("knots");
+      assert(knots);
+
+      SystResponse sp;
+      sp.syst = SystRegistry::ShortNameToSyst(name->GetString().Data());
+      sp.x0 = int((*knots)[0]);
+      sp.nKnots = (unsigned int)((*knots)[1]);
+      sp.events = FromTVectorD<unsigned int>(systDir, "events");
+      sp.ratios = FromTVectorD<float>(systDir, "ratios");
+      sp.deltas = FromTVectorD<float>(systDir, "deltas", true);
+      ret->fSysts.push_back(sp);
+
+      delete name;
+      delete knots;
+      delete systDir;
+    }
+
+    ret->UpdateTally();
+
+    return ret;
+  }
+}
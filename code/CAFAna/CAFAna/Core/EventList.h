@@ -0,0 +1,191 @@
+#pragma once
+
+#include "CAFAna/Core/Binning.h"
+#include "CAFAna/Core/Cut.h"
+#include "CAFAna/Core/HistAxis.h"
+#include "CAFAna/Core/MemoryTally.h"
+#include "CAFAna/Core/SystShifts.h"
+#include "CAFAna/Core/Var.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class TDirectory;
+
+namespace caf{class StandardRecord;}
+
+namespace ana
+{
+  class ISyst;
+  class SpectrumLoaderBase;
+
+  /// \brief The selected events themselves, along with their response to a
+  /// list of systematics, so that they can be reweighted on the fly
+  ///
+  /// For each event passing the cut we keep the value of the axis variable,
+  /// the true energy bin, the oscillation channel, and the weight. Every
+  /// syst is evaluated at the same integer shifts \ref PredictionInterp uses,
+  /// all within the one pass over the files, and the weight ratio and change
+  /// in the variable are stored for the events each syst affects. Between
+  /// the shifts the response is interpolated linearly, event by event, which
+  /// is exact for the GENIE knob systematics.
+  ///
+  /// The cut is only evaluated for the nominal event. Events that a shift
+  /// moves out of the selection get zero weight at that shift, but events it
+  /// would move in can't be represented. \ref NSelectionChanges counts the
+  /// former, as an indication of how much that matters.
+  ///
+  /// Only one-dimensional axes are supported, since shifts in the variable
+  /// are interpolated in its value.
+  class EventList
+  {
+  public:
+    friend class SpectrumLoaderBase;
+    friend class SpectrumLoader;
+    friend class NullLoader;
+
+    /// \brief Oscillation channel of an event
+    ///
+    /// CC channels are numbered by initial flavour, final flavour and sign,
+    /// see \ref CCChannel.
+    enum {kNCChannels = 12, kNCChannel = kNCChannels, kNChannels};
+
+    /// \param from Unoscillated PDG code, signed, of a CC event
+    /// \param to   PDG code after oscillation
+    /// \return -1 for combinations that can't be represented
+    static int CCChannel(int from, int to);
+    /// Signed initial PDG code of CC channel \a chan
+    static int ChannelFrom(int chan);
+    /// Signed final PDG code of CC channel \a chan
+    static int ChannelTo(int chan);
+
+    EventList(SpectrumLoaderBase& loader,
+              const HistAxis& axis,
+              const Cut& cut,
+              const std::vector<const ISyst*>& systs,
+              const SystShifts& shift = kNoShift,
+              const Var& wei = kUnweighted,
+              const Binning& trueBins = kTrueEnergyBins);
+
+    virtual ~EventList();
+
+    EventList(const EventList& rhs);
+    EventList& operator=(const EventList& rhs) = delete;
+
+    double POT() const {return fPOT;}
+    double Livetime() const {return fLivetime;}
+
+    const Binning& GetBinning() const {return fBins;}
+    const std::string& GetLabel() const {return fLabel;}
+    const Binning& TrueBinning() const {return fTrueBins;}
+
+    unsigned int NEvents() const {return fWeight.size();}
+    /// Number of (event, syst) pairs where some shift fails the cut
+    unsigned int NSelectionChanges() const {return fNSelectionChanges;}
+
+    std::vector<const ISyst*> GetAllSysts() const;
+    bool HasSyst(const ISyst* syst) const;
+
+    /// \brief Add the reweighted events into \a arr
+    ///
+    /// \param chanWeights Factor for each channel and true energy bin,
+    ///                    indexed [chan*(NTrueBins+2)+trueBin], for example
+    ///                    oscillation probabilities times a POT scale
+    /// \param shift       Must only involve systs known to this list
+    /// \param arr         In the layout of TH1::GetArray() for \ref
+    ///                    GetBinning
+    void AddTo(const double* chanWeights,
+               const SystShifts& shift,
+               double* arr) const;
+
+    /// \brief The shifts \a syst was evaluated at, x0, x0+1, ...
+    ///
+    /// \return false if it wasn't
+    bool SystKnots(const ISyst* syst, int& x0, unsigned int& nKnots) const;
+
+    /// \brief Add where the events move to under \a syst into one migration
+    /// matrix per knot and component
+    ///
+    /// \param chanWeights As for \ref AddTo
+    /// \param chanComps   Component each channel is accumulated into, or -1
+    ///                    to skip it
+    /// \param mx          Indexed [comp][knot][to bin][from bin], over all
+    ///                    NBins+2 bins. The weight moved includes the syst's
+    ///                    weight ratio
+    void AddMigrationsTo(const ISyst* syst,
+                         const double* chanWeights,
+                         const int* chanComps,
+                         double* mx) const;
+
+    void SaveTo(TDirectory* dir) const;
+    static std::unique_ptr<EventList> LoadFrom(TDirectory* dir);
+
+  protected:
+    /// Constructor for LoadFrom. No vars, so can't be filled
+    EventList(const std::string& label,
+              const Binning& bins,
+              const Binning& trueBins);
+
+    /// How the selected events respond to one systematic
+    struct SystResponse
+    {
+      const ISyst* syst;
+      int x0; ///< The lowest shift evaluated
+      unsigned int nKnots; ///< Shifts are x0, x0+1, ...
+
+      /// Indices of the events that respond, in increasing order
+      std::vector<unsigned int> events;
+      /// Weight ratio to nominal, indexed [entry*nKnots+knot]
+      std::vector<float> ratios;
+      /// \brief Change in the variable, same layout as \ref ratios
+      ///
+      /// Left empty unless the syst ever moves an event
+      std::vector<float> deltas;
+    };
+
+    /// Abort if \a syst wasn't evaluated
+    const SystResponse& FindSyst(const ISyst* syst) const;
+
+    /// Called by the loader for each event passing the cut
+    void Fill(double x, double w, caf::StandardRecord* sr);
+
+    /// Segment of \a sp containing \a sigma, and the position within it
+    static void InterpKnots(const SystResponse& sp, double sigma,
+                            unsigned int& knot, double& frac);
+
+    void UpdateTally();
+
+    void RemoveLoader(SpectrumLoaderBase*);
+    void AddLoader(SpectrumLoaderBase*);
+
+    std::string fLabel;
+    Binning fBins;
+    Binning fTrueBins;
+
+    /// May be null if loaded from file
+    std::unique_ptr<Var> fVar;
+    std::unique_ptr<Cut> fCut;
+    std::unique_ptr<Var> fWei;
+
+    // One entry per event
+    std::vector<float> fX; ///< Value of the variable
+    std::vector<int> fBin; ///< Bin of the nominal value
+    std::vector<int> fTrueBin;
+    std::vector<unsigned char> fChannel;
+    std::vector<double> fWeight;
+
+    std::vector<SystResponse> fSysts;
+
+    unsigned int fNSelectionChanges;
+
+    MemoryTally::Handle fTally{MemoryTally::kSpectra};
+
+    double fPOT;
+    double fLivetime;
+
+    /// This count is maintained by SpectrumLoader, as a sanity check
+    std::set<SpectrumLoaderBase*> fLoaderCount;
+  };
+}
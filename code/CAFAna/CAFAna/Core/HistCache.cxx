@@ -17,9 +17,13 @@ namespace ana
   long HistCache::fgEstMemUsage = 0;
   long HistCache::fgMemHandedOut = 0;
 
+  std::recursive_mutex HistCache::fgMutex;
+
   //---------------------------------------------------------------------
   TH1D* HistCache::New(const std::string& title, const Binning& bins)
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     ++fgOut;
     fgMemHandedOut += 16*bins.NBins();
 
@@ -43,6 +47,8 @@ namespace ana
   //---------------------------------------------------------------------
   TH1D* HistCache::New(const std::string& title, const TAxis* bins)
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     return New(title, Binning::FromTAxis(bins));
   }
 
@@ -55,12 +61,16 @@ namespace ana
   //---------------------------------------------------------------------
   TH2D* HistCache::NewTH2D(const std::string& title, const TAxis* bins)
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     return NewTH2D(title, Binning::FromTAxis(bins));
   }
 
   //---------------------------------------------------------------------
   TH2D* HistCache::NewTH2D(const std::string& title, const Binning& xbins, const Binning& ybins)
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     ++fgOut;
     fgMemHandedOut += 16*xbins.NBins()*ybins.NBins();
 
@@ -81,6 +91,8 @@ namespace ana
   //---------------------------------------------------------------------
   TH2D* HistCache::NewTH2D(const std::string& title, const TAxis* xbins, const TAxis* ybins)
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     return NewTH2D(title, Binning::FromTAxis(xbins), Binning::FromTAxis(ybins));
   }
 
@@ -121,6 +133,8 @@ namespace ana
   {
     if(!h) return;
 
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     ++fgIn;
     fgMemHandedOut -= 16*h->GetNbinsX();
 
@@ -138,6 +152,8 @@ namespace ana
   {
     if(!h) return;
 
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     ++fgIn;
     fgMemHandedOut -= 16*h->GetNbinsX()*h->GetNbinsY();
 
@@ -171,6 +187,8 @@ namespace ana
   //---------------------------------------------------------------------
   void HistCache::ClearCache()
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     fgMap.clear();
     fgMap2D.clear();
     fgEstMemUsage = 0;
@@ -181,6 +199,8 @@ namespace ana
   //---------------------------------------------------------------------
   void HistCache::PrintStats()
   {
+    std::lock_guard<std::recursive_mutex> lock(fgMutex);
+
     // Count number of unique keys
     std::set<int> keys;
     for(auto& it: fgMap) keys.insert(it.first);
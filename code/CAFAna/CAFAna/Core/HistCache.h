@@ -2,6 +2,7 @@
 
 #include <tuple>
 #include <map>
+#include <mutex>
 #include <string>
 
 #include "CAFAna/Core/Binning.h"
@@ -31,7 +32,7 @@ namespace ana
   /// histogram of the same binning instead of creating a new one.
   ///
   /// Allocate new histograms with \ref New, and return them to the cache with
-  /// \ref Delete.
+  /// \ref Delete. All the functions are safe to call from multiple threads.
   class HistCache
   {
   public:
@@ -65,5 +66,9 @@ namespace ana
 
     static long fgEstMemUsage;
     static long fgMemHandedOut;
+
+    /// Protects all of the above. Recursive because the public functions
+    /// call each other
+    static std::recursive_mutex fgMutex;
   };
 }
@@ -62,4 +62,20 @@ namespace ana
       return 2*(x-mean)/rad;
     }
   }
+
+  //----------------------------------------------------------------------
+  double ISyst::PenaltySecondDerivative(double x) const
+  {
+    if(fApplyPenalty){
+      // Regular quadratic penalty term
+      return 2;
+    }
+    else{
+      // Otherwise, no penalty within range, but still apply one outside
+      if(x >= Min() && x <= Max()) return 0;
+
+      const double rad = (Max()-Min())/2;
+      return 2/(rad*rad);
+    }
+  }
 }
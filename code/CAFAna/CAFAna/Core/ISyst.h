@@ -39,6 +39,7 @@ namespace ana
 
     virtual double Penalty(double x) const;
     virtual double PenaltyDerivative(double x) const;
+    virtual double PenaltySecondDerivative(double x) const;
 
     /// Should a penalty be applied for this shift?
     virtual bool ApplyPenalty() const {return fApplyPenalty;}
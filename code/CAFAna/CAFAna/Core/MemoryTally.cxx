@@ -0,0 +1,283 @@
+#include "CAFAna/Core/MemoryTally.h"
+
+#include "TH1.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+
+namespace ana
+{
+  std::atomic<long> MemoryTally::fgBytes[MemoryTally::kNumCategories];
+  std::atomic<long> MemoryTally::fgItems[MemoryTally::kNumCategories];
+  std::atomic<long> MemoryTally::fgPeak[MemoryTally::kNumCategories];
+
+  //----------------------------------------------------------------------
+  MemoryTally::Handle::Handle(const Handle& rhs)
+    : fCat(rhs.fCat), fBytes(0), fItems(0)
+  {
+    Set(rhs.fBytes, rhs.fItems);
+  }
+
+  //----------------------------------------------------------------------
+  MemoryTally::Handle::Handle(Handle&& rhs)
+    : fCat(rhs.fCat), fBytes(rhs.fBytes), fItems(rhs.fItems)
+  {
+    rhs.fBytes = 0;
+    rhs.fItems = 0;
+  }
+
+  //----------------------------------------------------------------------
+  MemoryTally::Handle& MemoryTally::Handle::operator=(const Handle& rhs)
+  {
+    // Our category stays fixed, we just take on the same contribution
+    if(this != &rhs) Set(rhs.fBytes, rhs.fItems);
+    return *this;
+  }
+
+  //----------------------------------------------------------------------
+  MemoryTally::Handle& MemoryTally::Handle::operator=(Handle&& rhs)
+  {
+    if(this == &rhs) return *this;
+
+    Set(rhs.fBytes, rhs.fItems);
+    rhs.Clear();
+    return *this;
+  }
+
+  //----------------------------------------------------------------------
+  MemoryTally::Handle::~Handle()
+  {
+    Adjust(fCat, -fBytes, -fItems);
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::Handle::Set(long bytes, long items)
+  {
+    Adjust(fCat, bytes-fBytes, items-fItems);
+    fBytes = bytes;
+    fItems = items;
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::Handle::Set(const TH1* h)
+  {
+    if(h) Set(HistBytes(h), 1); else Clear();
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::Handle::SetCategory(Category cat)
+  {
+    if(cat == fCat) return;
+
+    Adjust(fCat, -fBytes, -fItems);
+    fCat = cat;
+    Adjust(fCat, +fBytes, +fItems);
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::Adjust(Category cat, long dbytes, long ditems)
+  {
+    if(dbytes == 0 && ditems == 0) return;
+
+    const long now = fgBytes[cat].fetch_add(dbytes, std::memory_order_relaxed) + dbytes;
+    fgItems[cat].fetch_add(ditems, std::memory_order_relaxed);
+
+    long peak = fgPeak[cat].load(std::memory_order_relaxed);
+    while(now > peak &&
+          !fgPeak[cat].compare_exchange_weak(peak, now, std::memory_order_relaxed));
+  }
+
+  //----------------------------------------------------------------------
+  long MemoryTally::Bytes(Category cat)
+  {
+    return fgBytes[cat].load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------
+  long MemoryTally::Count(Category cat)
+  {
+    return fgItems[cat].load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------
+  long MemoryTally::PeakBytes(Category cat)
+  {
+    return fgPeak[cat].load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------
+  long MemoryTally::TotalBytes()
+  {
+    long ret = 0;
+    for(int cat = 0; cat < kNumCategories; ++cat) ret += Bytes(Category(cat));
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  const char* MemoryTally::Name(Category cat)
+  {
+    switch(cat){
+    case kSpectra:       return "Spectra";
+    case k2DTemplates:   return "2D templates";
+    case kSplineCoeffs:  return "Spline coefficients";
+    case kCaches:        return "Caches";
+    case kCalculators:   return "Calculator copies";
+    default:             return "Unknown";
+    }
+  }
+
+  //----------------------------------------------------------------------
+  long MemoryTally::HistBytes(const TH1* h)
+  {
+    if(!h) return 0;
+    // Contents, plus the sum of weights squared if we're keeping errors. Axes
+    // and other overheads are small in comparison.
+    return long(h->GetNcells())*sizeof(double) + long(h->GetSumw2N())*sizeof(double);
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::PrintStats()
+  {
+    std::cout << "Memory tally:" << std::endl;
+    for(int i = 0; i < kNumCategories; ++i){
+      const Category cat = Category(i);
+      std::cout << "  " << std::setw(20) << std::left << Name(cat) << std::right
+                << std::setw(10) << Count(cat) << " objects "
+                << std::setw(8) << Bytes(cat)/(1024*1024) << " MB "
+                << "(peak " << PeakBytes(cat)/(1024*1024) << " MB)" << std::endl;
+    }
+    std::cout << "  Total " << TotalBytes()/(1024*1024) << " MB" << std::endl;
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::DumpAtExit()
+  {
+    static bool once = true;
+    if(once){
+      once = false;
+      std::atexit(PrintStats);
+    }
+  }
+
+  namespace
+  {
+    /// \brief Builds up the text in a fixed buffer and writes it in one go,
+    /// using only functions that are safe to call from a signal handler
+    class SignalSafeWriter
+    {
+    public:
+      SignalSafeWriter() : fLen(0) {}
+
+      void Append(const char* str)
+      {
+        while(*str && fLen < sizeof(fBuf)) fBuf[fLen++] = *str++;
+      }
+
+      /// \a x right-aligned in at least \a width characters
+      void Append(long x, unsigned int width = 0)
+      {
+        char digits[24];
+        unsigned int n = 0;
+        const bool neg = x < 0;
+        unsigned long u = neg ? -(unsigned long)x : x;
+        do{digits[n++] = '0' + u%10; u /= 10;} while(u);
+        if(neg) digits[n++] = '-';
+
+        for(unsigned int i = n; i < width; ++i) Append(" ");
+        while(n && fLen < sizeof(fBuf)) fBuf[fLen++] = digits[--n];
+      }
+
+      /// \a str left-aligned in \a width characters
+      void AppendPadded(const char* str, unsigned int width)
+      {
+        const unsigned int start = fLen;
+        Append(str);
+        while(fLen-start < width && fLen < sizeof(fBuf)) fBuf[fLen++] = ' ';
+      }
+
+      void Flush()
+      {
+        unsigned int done = 0;
+        while(done < fLen){
+          const ssize_t n = write(STDOUT_FILENO, fBuf+done, fLen-done);
+          if(n <= 0) break;
+          done += n;
+        }
+        fLen = 0;
+      }
+
+    protected:
+      char fBuf[2048];
+      unsigned int fLen;
+    };
+
+    /// \brief The same table as MemoryTally::PrintStats, without iostreams or
+    /// locks. The counters are lock-free atomics, so safe to read here
+    void PrintStatsFromSignal()
+    {
+      SignalSafeWriter w;
+      w.Append("Memory tally:\n");
+      for(int i = 0; i < MemoryTally::kNumCategories; ++i){
+        const MemoryTally::Category cat = MemoryTally::Category(i);
+        w.Append("  ");
+        w.AppendPadded(MemoryTally::Name(cat), 20);
+        w.Append(MemoryTally::Count(cat), 10);
+        w.Append(" objects ");
+        w.Append(MemoryTally::Bytes(cat)/(1024*1024), 8);
+        w.Append(" MB (peak ");
+        w.Append(MemoryTally::PeakBytes(cat)/(1024*1024));
+        w.Append(" MB)\n");
+      }
+      w.Append("  Total ");
+      w.Append(MemoryTally::TotalBytes()/(1024*1024));
+      w.Append(" MB\n");
+      w.Flush();
+    }
+
+    //----------------------------------------------------------------------
+    void HandleSignal(int sig)
+    {
+      PrintStatsFromSignal();
+
+      // SIGUSR1 and friends are just requests for a printout. Anything else
+      // was on its way to killing us, so let it finish the job.
+      if(sig != SIGUSR1 && sig != SIGUSR2){
+        signal(sig, SIG_DFL);
+        raise(sig);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void MemoryTally::DumpOnSignal(int sig)
+  {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = HandleSignal;
+    sigaction(sig, &sa, NULL);
+  }
+
+  //----------------------------------------------------------------------
+  class InstallMemoryTallyDumps
+  {
+  public:
+    InstallMemoryTallyDumps()
+    {
+      if(!getenv("CAFANA_MEMORY_TALLY")) return;
+
+      MemoryTally::DumpAtExit();
+      MemoryTally::DumpOnSignal(SIGUSR1);
+      // Batch systems generally send this before the hard kill when a job
+      // exceeds its memory request
+      MemoryTally::DumpOnSignal(SIGTERM);
+    }
+  };
+
+  static InstallMemoryTallyDumps gMemoryTallyInstaller;
+}
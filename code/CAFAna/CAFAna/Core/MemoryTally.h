@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+
+class TH1;
+
+namespace ana
+{
+  /// \brief Process-wide accounting of live memory, broken down by category
+  ///
+  /// \ref HistCache only knows about the histograms that pass through it. This
+  /// class keeps a running total of the bytes and objects held by the big
+  /// consumers (spectra, 2D templates, spline coefficients, caches, oscillation
+  /// calculator copies) so we can tell which one is to blame when a job grows
+  /// out of its memory allowance.
+  ///
+  /// Owners hold a \ref Handle and tell it how much they currently have. The
+  /// totals are updated with relaxed atomics, so this is cheap enough to leave
+  /// on all the time.
+  ///
+  /// Query from a macro with \ref Bytes / \ref Count, or print everything with
+  /// \ref PrintStats. Setting the environment variable CAFANA_MEMORY_TALLY
+  /// prints the table at exit, on receipt of SIGUSR1, and on SIGTERM (which
+  /// batch systems tend to send to jobs over their memory request) before
+  /// letting that terminate the process as usual.
+  class MemoryTally
+  {
+  public:
+    enum Category
+    {
+      kSpectra,
+      k2DTemplates,
+      kSplineCoeffs,
+      kCaches,
+      kCalculators, ///< Only counted, we don't know how big they are
+      kNumCategories
+    };
+
+    /// \brief Registers a contribution to one category for its lifetime
+    ///
+    /// Copies start out with the same contribution as the original, moves
+    /// transfer it.
+    class Handle
+    {
+    public:
+      explicit Handle(Category cat) : fCat(cat), fBytes(0), fItems(0) {}
+      Handle(const Handle& rhs);
+      Handle(Handle&& rhs);
+      Handle& operator=(const Handle& rhs);
+      Handle& operator=(Handle&& rhs);
+      ~Handle();
+
+      /// Replace this handle's contribution
+      void Set(long bytes, long items = 1);
+      /// Contribution of a single histogram (zero if \a h is null)
+      void Set(const TH1* h);
+      void Clear() {Set(0, 0);}
+
+      /// Move our contribution over to a different category
+      void SetCategory(Category cat);
+
+      long Bytes() const {return fBytes;}
+      long Items() const {return fItems;}
+    protected:
+      Category fCat;
+      long fBytes;
+      long fItems;
+    };
+
+    /// Live bytes in category \a cat
+    static long Bytes(Category cat);
+    /// Live objects in category \a cat
+    static long Count(Category cat);
+    /// Highest number of live bytes ever seen in category \a cat
+    static long PeakBytes(Category cat);
+    static long TotalBytes();
+
+    static const char* Name(Category cat);
+
+    /// Estimated size of the contents of \a h, including errors
+    static long HistBytes(const TH1* h);
+
+    static void PrintStats();
+
+    /// Call \ref PrintStats when the process exits normally
+    static void DumpAtExit();
+    /// \brief Print the same table as \ref PrintStats whenever signal \a sig
+    /// is received
+    ///
+    /// The handler only uses async-signal-safe calls. Signals other than
+    /// SIGUSR1 and SIGUSR2 then go on to have their default effect.
+    static void DumpOnSignal(int sig);
+
+  protected:
+    static void Adjust(Category cat, long dbytes, long ditems);
+
+    static std::atomic<long> fgBytes[kNumCategories];
+    static std::atomic<long> fgItems[kNumCategories];
+    static std::atomic<long> fgPeak[kNumCategories];
+  };
+}
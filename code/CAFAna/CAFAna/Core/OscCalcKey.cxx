@@ -0,0 +1,89 @@
+#include "CAFAna/Core/OscCalcKey.h"
+
+#include "OscLib/func/OscCalculator.h"
+#include "OscLib/func/OscCalculatorGeneral.h"
+#include "OscLib/func/OscCalculatorPMNS.h"
+#include "OscLib/func/OscCalculatorPMNSOpt.h"
+#include "OscLib/func/OscCalculatorSterile.h"
+#include "OscLib/func/OscCalculatorPMNS_NSI.h"
+
+#include "TMD5.h"
+
+#include <memory>
+#include <typeinfo>
+#include <vector>
+
+namespace ana
+{
+  namespace
+  {
+    /// The type, so that different calculators never share a key, followed
+    /// by the raw bytes of \a xs
+    void MakeKey(const std::type_info& type, const double* xs, unsigned int n,
+                 std::string& key)
+    {
+      key = type.name();
+      key += ':';
+      key.append((const char*)xs, n*sizeof(double));
+    }
+
+    //----------------------------------------------------------------------
+    void StandardKey(const osc::IOscCalculatorAdjustable& calc,
+                     std::string& key)
+    {
+      const double params[8] = {calc.GetL(), calc.GetRho(),
+                                calc.GetDmsq21(), calc.GetDmsq32(),
+                                calc.GetTh12(), calc.GetTh13(),
+                                calc.GetTh23(), calc.GetdCP()};
+      MakeKey(typeid(calc), params, 8, key);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  bool GetOscCalcKey(const osc::IOscCalculator* calc, std::string& key)
+  {
+    key.clear();
+    if(!calc) return false;
+
+    const IOscCalcKeyed* keyed = dynamic_cast<const IOscCalcKeyed*>(calc);
+    if(keyed) return keyed->CalcKey(key);
+
+    const std::type_info& type = typeid(*calc);
+
+    if(type == typeid(osc::NoOscillations)){
+      key = type.name();
+      return true;
+    }
+
+    // Entirely described by the standard parameters
+    if(type == typeid(osc::OscCalculator) ||
+       type == typeid(osc::OscCalculatorGeneral) ||
+       type == typeid(osc::OscCalculatorPMNS) ||
+       type == typeid(osc::OscCalculatorPMNSOpt)){
+      StandardKey(*static_cast<const osc::IOscCalculatorAdjustable*>(calc), key);
+      return true;
+    }
+
+    std::vector<double> state;
+    if(const osc::OscCalculatorSterile* s = dynamic_cast<const osc::OscCalculatorSterile*>(calc)){
+      state = s->GetState();
+    }
+    if(const osc::OscCalculatorPMNS_NSI* s = dynamic_cast<const osc::OscCalculatorPMNS_NSI*>(calc)){
+      state = s->GetState();
+    }
+    if(!state.empty()){
+      MakeKey(type, state.data(), state.size(), key);
+      return true;
+    }
+
+    std::unique_ptr<TMD5> hash(calc->GetParamsHash());
+    if(hash){
+      key = hash->AsString();
+      return true;
+    }
+
+    // Unknown calculators may depend on more than the standard parameters,
+    // so there's no way to tell when their results are stale
+    return false;
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+namespace osc{class IOscCalculator;}
+
+namespace ana
+{
+  /// \brief Calculators defined in CAFAna can supply their own cache key,
+  /// see \ref GetOscCalcKey
+  class IOscCalcKeyed
+  {
+  public:
+    virtual ~IOscCalcKeyed() {}
+
+    /// \return false if the current parameters can't be keyed
+    virtual bool CalcKey(std::string& key) const = 0;
+  };
+
+  /// \brief Identify the parameters of \a calc, for use as a cache key
+  ///
+  /// Calculators with the same key give the same probabilities. For the
+  /// standard three-flavour calculators the key is a snapshot of their
+  /// parameters, and for the sterile and NSI calculators of their full
+  /// state, so comparing keys costs a few comparisons rather than the MD5
+  /// digest of IOscCalculator::GetParamsHash. Calculators deriving from \ref
+  /// IOscCalcKeyed supply their own key. Anything else uses its hash if it
+  /// has one, and otherwise isn't cached at all.
+  ///
+  /// \return false if \a calc can't be keyed, and so shouldn't be cached
+  bool GetOscCalcKey(const osc::IOscCalculator* calc, std::string& key);
+}
@@ -1,12 +1,15 @@
 #include "CAFAna/Core/OscCurve.h"
 
 #include "CAFAna/Core/Binning.h"
+#include "CAFAna/Core/BoundedCache.h"
 #include "CAFAna/Core/HistCache.h"
+#include "CAFAna/Core/OscCalcKey.h"
 #include "CAFAna/Core/Utilities.h"
 
 #include "OscLib/func/IOscCalculator.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
 #include <map>
 
@@ -14,17 +17,130 @@
 
 namespace ana
 {
+  namespace
+  {
+    /// Keyed by the binning ID and the calculator's \ref GetOscCalcKey
+    BoundedCache<std::string, std::shared_ptr<const OscCurveSet>>& CurveCache()
+    {
+      static BoundedCache<std::string, std::shared_ptr<const OscCurveSet>> cache(64);
+      return cache;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  OscCurveSet::OscCurveSet(osc::IOscCalculator* calc, const Binning& bins)
+    : fBins(bins), fNBins(bins.NBins()+2), fP(kNChannels*fNBins, 0)
+  {
+    const std::vector<double> Es = BinCenters(bins);
+    const int pdgs[3] = {12, 14, 16};
+
+    // Energy outermost, so that each solution is reused for all the channels
+    for(unsigned int bin = 0; bin < fNBins; ++bin){
+      const double E = Es[bin];
+      if(E <= 0) continue;
+
+      for(int sign: {+1, -1}){
+        for(int from: pdgs){
+          for(int to: pdgs){
+            fP[Index(sign*from, sign*to)*fNBins+bin] = calc->P(sign*from, sign*to, E);
+          }
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  std::shared_ptr<const OscCurveSet> OscCurveSet::Get(osc::IOscCalculator* calc,
+                                                      const Binning& bins)
+  {
+    std::string calcKey;
+    if(!GetOscCalcKey(calc, calcKey)) return 0;
+
+    const std::string key = std::to_string(bins.ID())+":"+calcKey;
+
+    std::shared_ptr<const OscCurveSet> ret;
+    if(CurveCache().Visit(key, [&ret](const std::shared_ptr<const OscCurveSet>& c){ret = c;}))
+      return ret;
+
+    ret = std::make_shared<const OscCurveSet>(calc, bins);
+    CurveCache().Insert(key, ret);
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  void OscCurveSet::ClearCache()
+  {
+    CurveCache().Clear();
+  }
+
+  //----------------------------------------------------------------------
+  int OscCurveSet::Index(int from, int to)
+  {
+    if((from > 0) != (to > 0)) return -1;
+
+    auto flav = [](int pdg)
+      {
+        switch(abs(pdg)){
+        case 12: return 0;
+        case 14: return 1;
+        case 16: return 2;
+        default: return -1;
+        }
+      };
+
+    const int i = flav(from);
+    const int j = flav(to);
+    if(i < 0 || j < 0) return -1;
+
+    return (from > 0 ? 0 : 9) + 3*i + j;
+  }
+
   //----------------------------------------------------------------------
-  OscCurve::OscCurve(osc::IOscCalculator* calc, int from, int to)
+  const double* OscCurveSet::P(int from, int to) const
+  {
+    const int idx = Index(from, to);
+    assert(idx >= 0);
+    return &fP[idx*fNBins];
+  }
+
+  //----------------------------------------------------------------------
+  std::vector<double> OscCurveSet::BinCenters(const Binning& bins)
+  {
+    const std::vector<double>& edges = bins.Edges();
+    const int N = bins.NBins();
+
+    std::vector<double> ret(N+2);
+    for(int i = 1; i <= N; ++i) ret[i] = (edges[i-1]+edges[i])/2;
+
+    // TAxis uses the average bin width outside the range
+    const double avgWidth = (edges[N]-edges[0])/N;
+    ret[0] = edges[0]-avgWidth/2;
+    ret[N+1] = edges[N]+avgWidth/2;
+
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  OscCurve::OscCurve(osc::IOscCalculator* calc, int from, int to,
+                     const Binning& bins)
     : fFrom(from), fTo(to)
   {
     DontAddDirectory guard;
 
-    fHist = HistCache::New(";True Energy (GeV);Probability", kTrueEnergyBins);
+    fHist = HistCache::New(";True Energy (GeV);Probability", bins);
+
+    // Use the shared curves where we can, it saves recomputing the other
+    // channels at each energy later
+    std::shared_ptr<const OscCurveSet> curves;
+    if(OscCurveSet::HasChannel(from, to)) curves = OscCurveSet::Get(calc, bins);
+    const double* P = curves ? curves->P(from, to) : 0;
 
     for(int i = 0; i < fHist->GetNbinsX()+2; ++i){
       const double E = fHist->GetBinCenter(i);
-      if(E > 0){
+      if(P){
+        fHist->SetBinContent(i, P[i]);
+      }
+      else if(E > 0){
         fHist->SetBinContent(i, calc->P(from, to, E));
       }
       else{
@@ -34,6 +150,21 @@ namespace ana
     }
   }
 
+  //----------------------------------------------------------------------
+  OscCurve::OscCurve(const OscCurveSet& curves, int from, int to)
+    : fFrom(from), fTo(to)
+  {
+    DontAddDirectory guard;
+
+    fHist = HistCache::New(";True Energy (GeV);Probability", curves.GetBinning());
+
+    const double* P = curves.P(from, to);
+    for(int i = 0; i < fHist->GetNbinsX()+2; ++i){
+      fHist->SetBinContent(i, P[i]);
+      fHist->SetBinError(i, 0);
+    }
+  }
+
   //----------------------------------------------------------------------
   OscCurve::OscCurve(TH1* h)
   {
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "CAFAna/Core/Binning.h"
+
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 class TH1;
 class TH1D;
@@ -10,11 +14,61 @@ namespace osc{class IOscCalculator;}
 
 namespace ana
 {
+  /// \brief Transition probabilities between all three active flavours, for
+  /// neutrinos and antineutrinos, as a function of energy
+  ///
+  /// Evaluated in a single sweep over the energies, with every channel at one
+  /// energy computed together, so that calculators which keep the solution
+  /// for the last energy only have to find it twice (once per sign) per bin.
+  class OscCurveSet
+  {
+  public:
+    OscCurveSet(osc::IOscCalculator* calc,
+                const Binning& bins = kTrueEnergyBins);
+
+    /// \brief The curves for \a calc, shared with every other caller asking
+    /// for the same parameters and binning
+    ///
+    /// Returns null for calculators \ref GetOscCalcKey can't identify
+    static std::shared_ptr<const OscCurveSet> Get(osc::IOscCalculator* calc,
+                                                  const Binning& bins = kTrueEnergyBins);
+
+    /// Drop all the sets kept by \ref Get
+    static void ClearCache();
+
+    /// \brief Probabilities in the layout of TH1::GetArray(), including under
+    /// and overflow, evaluated at the bin centres
+    ///
+    /// Only for channels with \ref HasChannel
+    const double* P(int from, int to) const;
+
+    /// Is this a transition between two active flavours of the same sign?
+    static bool HasChannel(int from, int to) {return Index(from, to) >= 0;}
+
+    static const int kNChannels = 18;
+    /// 0-8 for neutrinos, 9-17 antineutrinos, -1 if not represented
+    static int Index(int from, int to);
+
+    const Binning& GetBinning() const {return fBins;}
+
+    /// Centres of all the bins of \a bins, with TH1's under and overflow
+    /// convention
+    static std::vector<double> BinCenters(const Binning& bins);
+
+  protected:
+    Binning fBins;
+    unsigned int fNBins; ///< Including under and overflow
+    std::vector<double> fP; ///< Indexed [channel*fNBins+bin]
+  };
+
   /// Transition probability for any one channel as a function of energy
   class OscCurve
   {
   public:
-    OscCurve(osc::IOscCalculator* calc, int from, int to);
+    /// Taken from the shared \ref OscCurveSet where possible
+    OscCurve(osc::IOscCalculator* calc, int from, int to,
+             const Binning& bins = kTrueEnergyBins);
+    OscCurve(const OscCurveSet& curves, int from, int to);
     OscCurve(TH1* h);
     virtual ~OscCurve();
 
@@ -1,7 +1,9 @@
 #include "CAFAna/Core/OscillatableSpectrum.h"
 
+#include "CAFAna/Core/BandedMatrix.h"
 #include "CAFAna/Core/Binning.h"
 #include "CAFAna/Core/HistCache.h"
+#include "CAFAna/Core/OscCalcKey.h"
 #include "CAFAna/Core/OscCurve.h"
 #include "CAFAna/Core/Ratio.h"
 #include "CAFAna/Core/Utilities.h"
@@ -12,10 +14,12 @@
 
 #include "TDirectory.h"
 #include "TH2.h"
-#include "TMD5.h"
 #include "TObjString.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <iostream>
 #include <memory>
 
 namespace ana
@@ -36,16 +40,18 @@ namespace ana
                        const Var& var,
                        const Cut& cut,
                        const SystShifts& shift,
-                       const Var& wei)
+                       const Var& wei,
+                       const Binning& trueBins)
     : ReweightableSpectrum(label, bins, kTrueE),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(trueBins),
+      fTrimTrueBins(false)
   {
     fTrueLabel = "True Energy (GeV)";
 
     DontAddDirectory guard;
 
-    fHist = HistCache::NewTH2D("", bins);
+    fHist = HistCache::NewTH2D("", bins, fTrueBins);
+    fTally.Set(fHist);
 
     loader.AddReweightableSpectrum(*this, var, cut, shift, wei);
   }
@@ -55,10 +61,11 @@ namespace ana
                                              const HistAxis& axis,
                                              const Cut& cut,
                                              const SystShifts& shift,
-                                             const Var& wei)
+                                             const Var& wei,
+                                             const Binning& trueBins)
     : ReweightableSpectrum(axis.GetLabels(), axis.GetBinnings(), kTrueE),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(trueBins),
+      fTrimTrueBins(false)
   {
     fTrueLabel = "True Energy (GeV)";
 
@@ -75,7 +82,8 @@ namespace ana
 
     DontAddDirectory guard;
 
-    fHist = HistCache::NewTH2D("", bins1D);
+    fHist = HistCache::NewTH2D("", bins1D, fTrueBins);
+    fTally.Set(fHist);
 
     Var multiDVar = axis.GetVars()[0];
     if(axis.NDimensions() == 2)
@@ -91,10 +99,11 @@ namespace ana
 
   //----------------------------------------------------------------------
   OscillatableSpectrum::OscillatableSpectrum(const std::string& label,
-                                             const Binning& bins)
+                                             const Binning& bins,
+                                             const Binning& trueBins)
     : ReweightableSpectrum(label, bins, kTrueE),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(trueBins),
+      fTrimTrueBins(false)
   {
     fTrueLabel = "True Energy (GeV)";
 
@@ -103,15 +112,17 @@ namespace ana
     fPOT = 0;
     fLivetime = 0;
 
-    fHist = HistCache::NewTH2D("", bins);
+    fHist = HistCache::NewTH2D("", bins, fTrueBins);
+    fTally.Set(fHist);
   }
 
   //----------------------------------------------------------------------
   OscillatableSpectrum::OscillatableSpectrum(const std::string& label, double pot, double livetime,
-                                             const Binning& bins)
+                                             const Binning& bins,
+                                             const Binning& trueBins)
     : ReweightableSpectrum(label, bins, kTrueE),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(trueBins),
+      fTrimTrueBins(false)
   {
     fTrueLabel = "True Energy (GeV)";
 
@@ -120,7 +131,8 @@ namespace ana
     fPOT = pot;
     fLivetime = livetime;
 
-    fHist = HistCache::NewTH2D("", bins);
+    fHist = HistCache::NewTH2D("", bins, fTrueBins);
+    fTally.Set(fHist);
   }
 
   //----------------------------------------------------------------------
@@ -129,8 +141,8 @@ namespace ana
                                              const std::vector<Binning>& bins,
                                              double pot, double livetime)
     : ReweightableSpectrum(kTrueE, h, labels, bins, pot, livetime),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(h ? Binning::FromTAxis(h->GetYaxis()) : kTrueEnergyBins),
+      fTrimTrueBins(false)
   {
     fTrueLabel = "True Energy (GeV)";
   }
@@ -141,8 +153,8 @@ namespace ana
                                              const std::vector<Binning>& bins,
                                              double pot, double livetime)
     : ReweightableSpectrum(kTrueE, std::move(h), labels, bins, pot, livetime),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(Binning::FromTAxis(fHist->GetYaxis())),
+      fTrimTrueBins(false)
   {
     fTrueLabel = "True Energy (GeV)";
   }
@@ -151,55 +163,49 @@ namespace ana
   OscillatableSpectrum::~OscillatableSpectrum()
   {
     // Nulls fHist out, so it's safe that ~ReweightableSpectrum tries too
-    HistCache::Delete(fHist, Bins1DX().ID(), kTrueEnergyBins.ID());
+    HistCache::Delete(fHist, Bins1DX().ID(), fTrueBins.ID());
 
     for (SpectrumLoaderBase* loader : fLoaderCount)
     { loader->RemoveReweightableSpectrum(this); }
-
-    delete fCachedHash;
   }
 
   //----------------------------------------------------------------------
   OscillatableSpectrum::OscillatableSpectrum(const OscillatableSpectrum& rhs)
     : ReweightableSpectrum(rhs.fLabels, rhs.fBins, kTrueE),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(rhs.fTrueBins),
+      fTrimTrueBins(rhs.fTrimTrueBins)
   {
     DontAddDirectory guard;
 
-    fHist = HistCache::Copy(rhs.fHist, rhs.Bins1DX(), kTrueEnergyBins);
+    fHist = rhs.fHist ? HistCache::Copy(rhs.fHist, rhs.Bins1DX(), fTrueBins) : 0;
+    fBanded = rhs.fBanded;
+    fTrueAxis = rhs.fTrueAxis;
+    if(fBanded) fTally.Set(fBanded->Bytes()); else fTally.Set(fHist);
 
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
 
-    if(rhs.fCachedHash){
-      fCachedOsc = rhs.fCachedOsc;
-      fCachedHash = new TMD5(*rhs.fCachedHash);
-    }
-
     assert( rhs.fLoaderCount.empty() ); // Copying with pending loads is unexpected
   }
 
   //----------------------------------------------------------------------
   OscillatableSpectrum::OscillatableSpectrum(OscillatableSpectrum&& rhs)
     : ReweightableSpectrum(rhs.fLabels, rhs.fBins, kTrueE),
-      fCachedOsc(0, {}, {}, 0, 0),
-      fCachedHash(0)
+      fTrueBins(rhs.fTrueBins),
+      fTrimTrueBins(rhs.fTrimTrueBins)
   {
     DontAddDirectory guard;
 
     fHist = rhs.fHist;
     rhs.fHist = 0;
+    fBanded = std::move(rhs.fBanded);
+    fTrueAxis = std::move(rhs.fTrueAxis);
+    if(fBanded) fTally.Set(fBanded->Bytes()); else fTally.Set(fHist);
+    rhs.fTally.Clear();
 
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
 
-    if(rhs.fCachedHash){
-      fCachedOsc = std::move(rhs.fCachedOsc);
-      fCachedHash = rhs.fCachedHash;
-      rhs.fCachedHash = 0;
-    }
-
     assert( rhs.fLoaderCount.empty() ); // Copying with pending loads is unexpected
   }
 
@@ -210,18 +216,19 @@ namespace ana
 
     DontAddDirectory guard;
 
-    if(fHist) HistCache::Delete(fHist, Bins1DX().ID());
-    fHist = HistCache::Copy(rhs.fHist, rhs.Bins1DX(), kTrueEnergyBins);
+    if(fHist) HistCache::Delete(fHist, Bins1DX().ID(), fTrueBins.ID());
+    fHist = rhs.fHist ? HistCache::Copy(rhs.fHist, rhs.Bins1DX(), rhs.fTrueBins) : 0;
+    fBanded = rhs.fBanded;
+    fTrueAxis = rhs.fTrueAxis;
+    if(fBanded) fTally.Set(fBanded->Bytes()); else fTally.Set(fHist);
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
     fLabels = rhs.fLabels;
     fBins = rhs.fBins;
+    fTrueBins = rhs.fTrueBins;
+    fTrimTrueBins = rhs.fTrimTrueBins;
 
-    if(rhs.fCachedHash){
-      fCachedOsc = rhs.fCachedOsc;
-      delete fCachedHash;
-      fCachedHash = new TMD5(*rhs.fCachedHash);
-    }
+    fOscCache.Clear(); // Invalidate
 
     assert( rhs.fLoaderCount.empty() ); // Copying with pending loads is unexpected
     assert( fLoaderCount.empty() ); // Copying with pending loads is unexpected
@@ -236,20 +243,21 @@ namespace ana
 
     DontAddDirectory guard;
 
-    if(fHist) HistCache::Delete(fHist, Bins1DX().ID());
+    if(fHist) HistCache::Delete(fHist, Bins1DX().ID(), fTrueBins.ID());
     fHist = rhs.fHist;
     rhs.fHist = 0;
+    fBanded = std::move(rhs.fBanded);
+    fTrueAxis = std::move(rhs.fTrueAxis);
+    if(fBanded) fTally.Set(fBanded->Bytes()); else fTally.Set(fHist);
+    rhs.fTally.Clear();
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
     fLabels = rhs.fLabels;
     fBins = rhs.fBins;
+    fTrueBins = rhs.fTrueBins;
+    fTrimTrueBins = rhs.fTrimTrueBins;
 
-    if(rhs.fCachedHash){
-      fCachedOsc = rhs.fCachedOsc;
-      delete fCachedHash;
-      fCachedHash = rhs.fCachedHash;
-      rhs.fCachedHash = 0;
-    }
+    fOscCache.Clear(); // Invalidate
 
     assert( rhs.fLoaderCount.empty() ); // Copying with pending loads is unexpected
     assert( fLoaderCount.empty() ); // Copying with pending loads is unexpected
@@ -257,42 +265,189 @@ namespace ana
     return *this;
   }
 
+  //----------------------------------------------------------------------
+  unsigned int OscillatableSpectrum::OscCacheSize()
+  {
+    const char* env = getenv("CAFANA_OSC_CACHE_SIZE");
+    return env ? std::max(atoi(env), 1) : 4;
+  }
+
   //----------------------------------------------------------------------
   Spectrum OscillatableSpectrum::Oscillated(osc::IOscCalculator* calc,
                                             int from, int to) const
   {
-    TMD5* hash = calc->GetParamsHash();
-    if(hash && fCachedHash && *hash == *fCachedHash){
-      delete hash;
-      return fCachedOsc;
+    OscKey_t key = {"", from, to};
+    const bool canCache = GetOscCalcKey(calc, key.calcKey);
+
+    if(canCache){
+      // The copy has to be made under the cache's lock, but is then handed
+      // straight back rather than copied again
+      std::unique_ptr<Spectrum> cached;
+      fOscCache.Visit(key, [&cached](const Spectrum& s){cached = std::make_unique<Spectrum>(s);});
+      if(cached) return std::move(*cached);
     }
 
-    const OscCurve curve(calc, from, to);
+    const OscCurve curve(calc, from, to, fTrueBins);
     TH1D* Ps = curve.ToTH1();
 
     const Spectrum ret = WeightedBy(Ps);
-    if(hash){
-      fCachedOsc = ret;
-      delete fCachedHash;
-      fCachedHash = hash;
+    HistCache::Delete(Ps, fTrueBins.ID());
+
+    if(canCache){
+      Spectrum cached = ret;
+      cached.SetMemoryCategory(MemoryTally::kCaches);
+      fOscCache.Insert(key, std::move(cached));
     }
-    HistCache::Delete(Ps, kTrueEnergyBins.ID());
+
     return ret;
   }
 
+  //----------------------------------------------------------------------
+  void OscillatableSpectrum::AddOscillatedTo(osc::IOscCalculator* calc,
+                                             int from, int to,
+                                             double pot, double* arr) const
+  {
+    OscKey_t key = {"", from, to};
+    const bool canCache = GetOscCalcKey(calc, key.calcKey);
+
+    if(canCache && fOscCache.Visit(key, [pot, arr](const Spectrum& s){s.AddTo(pot, arr);}))
+      return;
+
+    const OscCurve curve(calc, from, to, fTrueBins);
+    TH1D* Ps = curve.ToTH1();
+
+    if(canCache){
+      // Keep the cache up to date, and take our answer from there
+      Spectrum osc = WeightedBy(Ps);
+      osc.AddTo(pot, arr);
+      osc.SetMemoryCategory(MemoryTally::kCaches);
+      fOscCache.Insert(key, std::move(osc));
+    }
+    else{
+      AddWeightedTo(Ps, pot, arr);
+    }
+
+    HistCache::Delete(Ps, fTrueBins.ID());
+  }
+
+  //----------------------------------------------------------------------
+  void OscillatableSpectrum::TrimTrueBins()
+  {
+    if(!fHist) return; // Includes if we're compressed
+
+    const int X = fHist->GetNbinsX();
+    const int Y = fHist->GetNbinsY();
+
+    const double* histArr = fHist->GetArray();
+
+    auto rowEmpty = [X, histArr](int y)
+      {
+        for(int x = 0; x < X+2; ++x) if(histArr[y*(X+2)+x] != 0) return false;
+        return true;
+      };
+
+    // The under/overflow weights depend on the whole axis range, so we can
+    // only rebin exactly if there's nothing in them
+    if(!rowEmpty(0) || !rowEmpty(Y+1)) return;
+
+    const std::vector<double>& edges = fTrueBins.Edges();
+
+    std::vector<double> newEdges;
+    // Which row of the new histogram each old row goes to (0 = dropped)
+    std::vector<int> newRow(Y+2, 0);
+    for(int y = 1; y <= Y; ++y){
+      if(rowEmpty(y)) continue;
+      // Collapse any run of empty rows since the last filled one into a
+      // single bin
+      if(newEdges.empty() || newEdges.back() != edges[y-1])
+        newEdges.push_back(edges[y-1]);
+      newEdges.push_back(edges[y]);
+      newRow[y] = newEdges.size()-1;
+    }
+
+    // Completely empty, or nothing to gain
+    if(newEdges.size() < 2 || int(newEdges.size()) == Y+1) return;
+
+    DontAddDirectory guard;
+
+    const Binning newBins = Binning::Custom(newEdges);
+    TH2D* newHist = HistCache::NewTH2D(fHist->GetTitle(), Bins1DX(), newBins);
+
+    double* newArr = newHist->GetArray();
+    const bool sumw2 = fHist->GetSumw2N() > 0 && newHist->GetSumw2N() > 0;
+    const double* errArr = sumw2 ? fHist->GetSumw2()->GetArray() : 0;
+    double* newErrArr = sumw2 ? newHist->GetSumw2()->GetArray() : 0;
+
+    for(int y = 1; y <= Y; ++y){
+      if(!newRow[y]) continue;
+      for(int x = 0; x < X+2; ++x){
+        newArr[newRow[y]*(X+2)+x] = histArr[y*(X+2)+x];
+        if(sumw2) newErrArr[newRow[y]*(X+2)+x] = errArr[y*(X+2)+x];
+      }
+    }
+
+    HistCache::Delete(fHist, Bins1DX().ID(), fTrueBins.ID());
+    fHist = newHist;
+    fTally.Set(fHist);
+    fTrueBins = newBins;
+
+    fOscCache.Clear(); // Invalidate
+  }
+
+  //----------------------------------------------------------------------
+  void OscillatableSpectrum::RemoveLoader(SpectrumLoaderBase* p)
+  {
+    ReweightableSpectrum::RemoveLoader(p);
+
+    // That was the last loader, so we're completely filled now
+    if(fLoaderCount.empty()){
+      if(fTrimTrueBins) TrimTrueBins();
+      AutoCompress();
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void OscillatableSpectrum::AutoCompress()
+  {
+    const char* env = getenv("CAFANA_COMPRESS_TEMPLATES");
+    if(!env || !fHist) return;
+
+    const double denseBytes = double(fHist->GetNcells())*sizeof(double);
+
+    const double err = Compress(atof(env));
+    fOscCache.Clear(); // Invalidate
+
+    if(!IsCompressed()) return;
+
+    std::cout << "Compressed template '" << fLabels[0]
+              << (fLabels.size() > 1 ? "..." : "") << "' to "
+              << int(100*fBanded->Bytes()/denseBytes) << "% of its size."
+              << " Dropped " << fBanded->DroppedFraction()
+              << " of the events. Oscillated bins are off by at most " << err
+              << " of their unoscillated content" << std::endl;
+  }
+
   //----------------------------------------------------------------------
   OscillatableSpectrum& OscillatableSpectrum::operator+=(const OscillatableSpectrum& rhs)
   {
+    // Trimming can leave the two with different true binnings, in which case
+    // adding the bins would silently mix up energies
+    assert(fTrueBins.ID() == rhs.fTrueBins.ID() && "True binnings must match");
+
+    Decompress();
+
+    std::unique_ptr<TH2D> rhsTmp;
+    const TH2D* rhsHist = rhs.DenseHist(rhsTmp);
+
     if(rhs.fPOT){
-      fHist->Add(rhs.fHist, fPOT/rhs.fPOT);
+      fHist->Add(rhsHist, fPOT/rhs.fPOT);
     }
     else{
       // How can it have events but no POT?
-      assert(rhs.fHist->Integral() == 0);
+      assert(rhsHist->Integral() == 0);
     }
 
-    delete fCachedHash;
-    fCachedHash = 0; // Invalidate
+    fOscCache.Clear(); // Invalidate
 
     return *this;
   }
@@ -308,16 +463,23 @@ namespace ana
   //----------------------------------------------------------------------
   OscillatableSpectrum& OscillatableSpectrum::operator-=(const OscillatableSpectrum& rhs)
   {
+    // See operator+=
+    assert(fTrueBins.ID() == rhs.fTrueBins.ID() && "True binnings must match");
+
+    Decompress();
+
+    std::unique_ptr<TH2D> rhsTmp;
+    const TH2D* rhsHist = rhs.DenseHist(rhsTmp);
+
     if(rhs.fPOT){
-      fHist->Add(rhs.fHist, -fPOT/rhs.fPOT);
+      fHist->Add(rhsHist, -fPOT/rhs.fPOT);
     }
     else{
       // How can it have events but no POT?
-      assert(rhs.fHist->Integral() == 0);
+      assert(rhsHist->Integral() == 0);
     }
 
-    delete fCachedHash;
-    fCachedHash = 0; // Invalidate
+    fOscCache.Clear(); // Invalidate
 
     return *this;
   }
@@ -338,7 +500,8 @@ namespace ana
 
     TObjString("OscillatableSpectrum").Write("type");
 
-    fHist->Write("hist");
+    std::unique_ptr<TH2D> tmpHist;
+    DenseHist(tmpHist)->Write("hist");
     TH1D hPot("", "", 1, 0, 1);
     hPot.Fill(.5, fPOT);
     hPot.Write("pot");
@@ -397,6 +560,9 @@ namespace ana
 
     delete hPot;
     delete hLivetime;
+
+    ret->AutoCompress();
+
     return ret;
   }
 }
@@ -3,6 +3,7 @@
 #include "CAFAna/Core/ReweightableSpectrum.h"
 
 #include "CAFAna/Core/Binning.h"
+#include "CAFAna/Core/BoundedCache.h"
 #include "CAFAna/Core/Spectrum.h"
 #include "CAFAna/Core/SpectrumLoaderBase.h"
 
@@ -10,7 +11,6 @@
 
 class TH2;
 class TH2D;
-class TMD5;
 
 namespace osc{class IOscCalculator;}
 
@@ -23,6 +23,7 @@ namespace ana
     friend class SpectrumLoaderBase;
     friend class SpectrumLoader;
     friend class NullLoader;
+    friend class OscillatableStack;
 
     OscillatableSpectrum(const std::string& label,
                          const Binning& bins,
@@ -30,17 +31,21 @@ namespace ana
                          const Var& var,
                          const Cut& cut,
                          const SystShifts& shift = kNoShift,
-                         const Var& wei = kUnweighted);
+                         const Var& wei = kUnweighted,
+                         const Binning& trueBins = kTrueEnergyBins);
 
     OscillatableSpectrum(SpectrumLoaderBase& loader,
                          const HistAxis& axis,
                          const Cut& cut,
                          const SystShifts& shift = kNoShift,
-                         const Var& wei = kUnweighted);
+                         const Var& wei = kUnweighted,
+                         const Binning& trueBins = kTrueEnergyBins);
 
-    OscillatableSpectrum(const std::string& label, const Binning& bins);
+    OscillatableSpectrum(const std::string& label, const Binning& bins,
+                         const Binning& trueBins = kTrueEnergyBins);
     OscillatableSpectrum(const std::string& label, double pot, double livetime,
-                         const Binning& bins);
+                         const Binning& bins,
+                         const Binning& trueBins = kTrueEnergyBins);
     OscillatableSpectrum(TH2* h,
                          const std::vector<std::string>& labels,
                          const std::vector<Binning>& bins,
@@ -76,6 +81,37 @@ namespace ana
 
     Spectrum Oscillated(osc::IOscCalculator* calc, int from, int to) const;
 
+    /// \brief Add the result of \ref Oscillated, scaled to \a pot, into \a arr
+    ///
+    /// \a arr has the layout of TH1::GetArray() for the reco binning. Saves
+    /// constructing an intermediate Spectrum when summing many components.
+    void AddOscillatedTo(osc::IOscCalculator* calc, int from, int to,
+                         double pot, double* arr) const;
+
+    /// The binning of the true energy (y) axis
+    const Binning& TrueBins() const {return fTrueBins;}
+
+    /// \brief Shrink the true energy axis to the rows that have any content
+    ///
+    /// Empty rows at either end are dropped, and runs of empty rows in the
+    /// middle are merged into a single bin. Oscillated() results are
+    /// unchanged, but the template and the OscCurve evaluated for it get
+    /// smaller. Does nothing if there are events in the under/overflow rows,
+    /// or if we're compressed.
+    void TrimTrueBins();
+    /// Call \ref TrimTrueBins automatically once all loaders have filled us
+    void SetTrimTrueBins(bool trim) {fTrimTrueBins = trim;}
+
+    /// \brief If CAFANA_COMPRESS_TEMPLATES is set, \ref Compress with that
+    /// tolerance and report the result
+    ///
+    /// Done automatically once all loaders have filled us, and on \ref
+    /// LoadFrom. e.g. CAFANA_COMPRESS_TEMPLATES=1e-3 allows each reco bin to
+    /// lose up to 0.1% of its unoscillated content, and 0 only drops the empty
+    /// entries. The error on a bin after oscillation is bounded by the same
+    /// absolute amount, see \ref CompressionError.
+    void AutoCompress();
+
     OscillatableSpectrum& operator+=(const OscillatableSpectrum& rhs);
     OscillatableSpectrum operator+(const OscillatableSpectrum& rhs) const;
 
@@ -85,14 +121,21 @@ namespace ana
     void SaveTo(TDirectory* dir) const;
     static std::unique_ptr<OscillatableSpectrum> LoadFrom(TDirectory* dir);
 
+    /// \brief Number of oscillated results to keep, from
+    /// CAFANA_OSC_CACHE_SIZE (default 4)
+    ///
+    /// Each template is normally only oscillated in one channel, so this is
+    /// effectively the number of recent oscillation parameters remembered.
+    static unsigned int OscCacheSize();
+
   protected:
     // Derived classes can be trusted take care of their own construction
     OscillatableSpectrum(const std::vector<std::string>& labels,
                          const std::vector<Binning>& bins,
                          const Var& rwVar)
       : ReweightableSpectrum(labels, bins, rwVar),
-        fCachedOsc(0, {}, {}, 0, 0),
-        fCachedHash(0)
+        fTrueBins(kTrueEnergyBins),
+        fTrimTrueBins(false)
     {
     }
 
@@ -100,12 +143,37 @@ namespace ana
                          const Binning& bins,
                          const Var& rwVar)
       : ReweightableSpectrum(label, bins, rwVar),
-        fCachedOsc(0, {}, {}, 0, 0),
-        fCachedHash(0)
+        fTrueBins(kTrueEnergyBins),
+        fTrimTrueBins(false)
     {
     }
 
-    mutable Spectrum fCachedOsc;
-    mutable TMD5* fCachedHash;
+    virtual void RemoveLoader(SpectrumLoaderBase* p) override;
+
+    Binning fTrueBins;
+    bool fTrimTrueBins;
+
+    /// Oscillated results are cached per channel and oscillation parameters
+    struct OscKey_t
+    {
+      std::string calcKey; ///< From \ref GetOscCalcKey
+      int from, to;
+      bool operator==(const OscKey_t& rhs) const
+      {
+        return calcKey == rhs.calcKey && from == rhs.from && to == rhs.to;
+      }
+    };
+    struct OscKeyHash
+    {
+      size_t operator()(const OscKey_t& k) const
+      {
+        return std::hash<std::string>()(k.calcKey) ^ (size_t(k.from+100) << 8) ^
+          (size_t(k.to+100) << 16);
+      }
+    };
+    /// \brief Safe to use from multiple threads at once. Copies start empty
+    ///
+    /// The size is set by \ref OscCacheSize
+    mutable BoundedCache<OscKey_t, Spectrum, OscKeyHash> fOscCache{OscCacheSize(), 1};
   };
 }
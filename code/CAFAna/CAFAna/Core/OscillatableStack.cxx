@@ -0,0 +1,282 @@
+#include "CAFAna/Core/OscillatableStack.h"
+
+#include "CAFAna/Core/BandedMatrix.h"
+#include "CAFAna/Core/OscCalcKey.h"
+#include "CAFAna/Core/OscCurve.h"
+#include "CAFAna/Core/OscillatableSpectrum.h"
+
+#include "TH2.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <memory>
+
+namespace ana
+{
+  namespace
+  {
+    /// \brief Whether the true binning \a all, a refinement of \a own, gives
+    /// the same probabilities for every row of \a own in \a filled
+    bool CanRefine(const std::vector<double>& own,
+                   const std::vector<char>& filled,
+                   const std::vector<double>& all)
+    {
+      // The energy used for the under and overflow depends on the whole axis
+      if((filled.front() || filled.back()) && all != own) return false;
+
+      for(unsigned int y = 1; y+1 < filled.size(); ++y){
+        if(!filled[y]) continue;
+        // Any edge strictly inside would split it
+        auto it = std::upper_bound(all.begin(), all.end(), own[y-1]);
+        if(it != all.end() && *it < own[y]) return false;
+      }
+      return true;
+    }
+
+    //----------------------------------------------------------------------
+    /// For each row of \a own, the row of \a all that it starts in
+    std::vector<unsigned int> MapRows(const std::vector<double>& own,
+                                      const std::vector<double>& all)
+    {
+      std::vector<unsigned int> rows(own.size()+1, 0);
+      for(unsigned int y = 1; y < rows.size(); ++y){
+        rows[y] = std::lower_bound(all.begin(), all.end(), own[y-1]) - all.begin() + 1;
+      }
+      return rows;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  OscillatableStack::OscillatableStack()
+    : fNReco(0),
+      fOscCache(OscillatableSpectrum::OscCacheSize(), 1),
+      fMem(MemoryTally::k2DTemplates)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  unsigned int OscillatableStack::NewComponent(const OscillatableSpectrum& s,
+                                               unsigned int nReco,
+                                               unsigned int nTrue,
+                                               int from, int to)
+  {
+    assert(fComps.size() < 8*sizeof(unsigned int) && "Too many components for the mask");
+    assert(OscCurveSet::HasChannel(from, to));
+
+    if(fComps.empty()) fNReco = nReco;
+    assert(nReco == fNReco && "Components must share a reco binning");
+
+    Component comp;
+    comp.from = from;
+    comp.to = to;
+    comp.nTrue = nTrue;
+    comp.scale = 1;
+    comp.ref = 0;
+    comp.edges = s.TrueBins().Edges();
+    assert(comp.edges.size()+1 == nTrue);
+
+    comp.filled.resize(nTrue);
+    if(s.fBanded){
+      std::vector<double> proj(nTrue);
+      s.fBanded->ProjectY(proj.data());
+      for(unsigned int y = 0; y < nTrue; ++y) comp.filled[y] = (proj[y] != 0);
+    }
+    else{
+      const double* arr = s.fHist->GetArray();
+      for(unsigned int i = 0; i < nTrue*nReco; ++i) if(arr[i]) comp.filled[i/nReco] = true;
+    }
+
+    // Trimmed templates each have their own true binning, but are usually
+    // all cut down from the same one. Evaluate them all on the union of
+    // their edges wherever that doesn't change the energy of any filled bin,
+    // so they can still share one set of probabilities.
+    std::vector<double> edges;
+    unsigned int blockIdx = 0;
+    for(; blockIdx < fBlocks.size(); ++blockIdx){
+      const Block& block = fBlocks[blockIdx];
+      const std::vector<double>& blockEdges = block.trueBins.Edges();
+      edges.clear();
+      std::set_union(blockEdges.begin(), blockEdges.end(),
+                     comp.edges.begin(), comp.edges.end(),
+                     std::back_inserter(edges));
+
+      bool ok = CanRefine(comp.edges, comp.filled, edges);
+      for(unsigned int c: block.comps){
+        if(ok) ok = CanRefine(fComps[c].edges, fComps[c].filled, edges);
+      }
+      if(ok) break;
+    }
+
+    if(blockIdx == fBlocks.size()){
+      fBlocks.emplace_back(s.TrueBins());
+      edges = comp.edges;
+    }
+
+    Block& block = fBlocks[blockIdx];
+    if(edges.size() != block.trueBins.Edges().size()){
+      block.trueBins = Binning::Custom(edges);
+      for(unsigned int c: block.comps) fComps[c].rows = MapRows(fComps[c].edges, edges);
+    }
+
+    comp.block = blockIdx;
+    comp.offset = block.data.size();
+    comp.rows = MapRows(comp.edges, edges);
+
+    const unsigned int idx = fComps.size();
+    fComps.push_back(std::move(comp));
+    block.comps.push_back(idx);
+
+    fOscCache.Clear();
+
+    return idx;
+  }
+
+  //----------------------------------------------------------------------
+  unsigned int OscillatableStack::Add(const OscillatableSpectrum& s,
+                                      int from, int to)
+  {
+    if(s.fBanded){
+      // Compressed templates are never modified, so can be shared rather
+      // than copied
+      const unsigned int idx = NewComponent(s, s.fBanded->NX(), s.fBanded->NY(), from, to);
+      fComps[idx].banded = s.fBanded;
+      fComps[idx].scale = s.fPOT ? 1/s.fPOT : 0;
+      UpdateTally();
+      return idx;
+    }
+
+    // Scaled to unit POT, so the contraction only needs the target POT
+    std::unique_ptr<TH2D> h(s.ToTH2(1));
+
+    const unsigned int nReco = h->GetNbinsX()+2;
+    const unsigned int nTrue = h->GetNbinsY()+2;
+
+    const unsigned int idx = NewComponent(s, nReco, nTrue, from, to);
+
+    // TH2's internal layout is already [true][reco], including the under and
+    // overflows
+    const double* arr = h->GetArray();
+    std::vector<double>& data = fBlocks[fComps[idx].block].data;
+    data.insert(data.end(), arr, arr+nTrue*nReco);
+
+    UpdateTally();
+
+    return idx;
+  }
+
+  //----------------------------------------------------------------------
+  unsigned int OscillatableStack::AddRef(const OscillatableSpectrum& s,
+                                         int from, int to)
+  {
+    const unsigned int nReco = s.fBanded ? s.fBanded->NX() : s.fHist->GetNbinsX()+2;
+    const unsigned int nTrue = s.fBanded ? s.fBanded->NY() : s.fHist->GetNbinsY()+2;
+
+    const unsigned int idx = NewComponent(s, nReco, nTrue, from, to);
+    fComps[idx].ref = &s;
+    return idx;
+  }
+
+  //----------------------------------------------------------------------
+  void OscillatableStack::UpdateTally()
+  {
+    // Only what we hold that the spectra we were made from don't
+    long bytes = 0;
+    for(const Block& b: fBlocks) bytes += b.data.capacity()*sizeof(double);
+    fMem.Set(bytes, fComps.size());
+  }
+
+  //----------------------------------------------------------------------
+  void OscillatableStack::Contract(osc::IOscCalculator* calc,
+                                   unsigned int mask,
+                                   std::vector<double>& out) const
+  {
+    out.assign(fComps.size()*fNReco, 0);
+
+    // Probabilities in the binning of one component
+    std::vector<double> P;
+
+    for(const Block& block: fBlocks){
+      bool any = false;
+      for(unsigned int c: block.comps) if(mask & (1u << c)) any = true;
+      if(!any) continue;
+
+      // One evaluation of the probabilities for all channels, shared with
+      // everyone else using these parameters
+      std::shared_ptr<const OscCurveSet> curves = OscCurveSet::Get(calc, block.trueBins);
+      if(!curves) curves = std::make_shared<const OscCurveSet>(calc, block.trueBins);
+
+      for(unsigned int c: block.comps){
+        if(!(mask & (1u << c))) continue;
+
+        const Component& comp = fComps[c];
+        const double* blockP = curves->P(comp.from, comp.to);
+        P.resize(comp.nTrue);
+        for(unsigned int y = 0; y < comp.nTrue; ++y) P[y] = blockP[comp.rows[y]];
+
+        double* ret = &out[c*fNReco];
+
+        const BandedMatrix* banded = comp.banded.get();
+        const double* mx = 0;
+        double scale = comp.scale;
+        if(comp.ref){
+          banded = comp.ref->fBanded.get();
+          if(!banded){
+            assert(comp.ref->fHist->GetNcells() == int(comp.nTrue*fNReco));
+            mx = comp.ref->fHist->GetArray();
+          }
+          scale = comp.ref->fPOT ? 1/comp.ref->fPOT : 0;
+        }
+        else if(!banded){
+          mx = &block.data[comp.offset];
+        }
+
+        if(banded){
+          assert(banded->NX() == fNReco && banded->NY() == comp.nTrue);
+          banded->AddWeightedTo(P.data(), scale, ret);
+          continue;
+        }
+
+        for(unsigned int y = 0; y < comp.nTrue; ++y){
+          const double w = scale*P[y];
+          if(w == 0) continue;
+          const double* row = mx + y*fNReco;
+          for(unsigned int x = 0; x < fNReco; ++x) ret[x] += row[x]*w;
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void OscillatableStack::AddOscillatedTo(osc::IOscCalculator* calc,
+                                          unsigned int mask,
+                                          double pot, double* arr) const
+  {
+    auto addMasked = [this, mask, pot, arr](const std::vector<double>& osc)
+      {
+        for(unsigned int c = 0; c < fComps.size(); ++c){
+          if(!(mask & (1u << c))) continue;
+          const double* src = &osc[c*fNReco];
+          for(unsigned int x = 0; x < fNReco; ++x) arr[x] += pot*src[x];
+        }
+      };
+
+    std::string key;
+    if(!GetOscCalcKey(calc, key)){
+      std::vector<double> osc;
+      Contract(calc, mask, osc);
+      addMasked(osc);
+      return;
+    }
+
+    if(fOscCache.Visit(key, addMasked)) return;
+
+    // Do every component, on the assumption the rest will be asked for with
+    // the same parameters shortly
+    const unsigned int all = (fComps.size() == 8*sizeof(unsigned int)) ? ~0u : (1u << fComps.size())-1;
+    std::vector<double> osc;
+    Contract(calc, all, osc);
+    addMasked(osc);
+    fOscCache.Insert(key, std::move(osc));
+  }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CAFAna/Core/Binning.h"
+#include "CAFAna/Core/BoundedCache.h"
+#include "CAFAna/Core/MemoryTally.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace osc{class IOscCalculator;}
+
+namespace ana
+{
+  class BandedMatrix;
+  class OscillatableSpectrum;
+
+  /// \brief Several \ref OscillatableSpectrum components stored together, so
+  /// that they can all be oscillated in one pass
+  ///
+  /// Components are either used in place (\ref AddRef), or copied (\ref Add)
+  /// into a contiguous block, indexed [component][true][reco] and already
+  /// divided by their POT. Either way oscillating is a single pass over all
+  /// the templates with the probabilities of one \ref OscCurveSet, rather
+  /// than a separate Oscillated() call and intermediate Spectrum per
+  /// component. Copies are counted in MemoryTally::k2DTemplates, since they
+  /// duplicate the originals.
+  ///
+  /// Components with different true binnings, such as those left by
+  /// OscillatableSpectrum::TrimTrueBins, share a block and its probabilities
+  /// evaluated on the union of their edges, so long as that leaves every bin
+  /// with content unchanged. Otherwise they get a block of their own.
+  ///
+  /// The oscillated result of every component is kept for the most recent
+  /// oscillation parameters (see \ref GetOscCalcKey), so asking for the
+  /// components one at a time with the same calculator only does the work
+  /// once.
+  ///
+  /// Components that have been compressed (see
+  /// ReweightableSpectrum::Compress) are kept in that form instead, and
+  /// contracted with the same probabilities.
+  ///
+  /// All the components must share a reco binning. Safe to use from multiple
+  /// threads at once once filled.
+  class OscillatableStack
+  {
+  public:
+    OscillatableStack();
+
+    /// \brief Copy \a s into the stack as channel \a from -> \a to
+    ///
+    /// \return The index of the component, for use in the masks below
+    unsigned int Add(const OscillatableSpectrum& s, int from, int to);
+
+    /// \brief As \ref Add, but use \a s in place rather than copying it
+    ///
+    /// \a s must outlive the stack, and not be modified in the meantime
+    unsigned int AddRef(const OscillatableSpectrum& s, int from, int to);
+
+    unsigned int NComponents() const {return fComps.size();}
+
+    /// \brief Add the components with their bit set in \a mask, oscillated
+    /// and scaled to \a pot, into \a arr
+    ///
+    /// \a arr has the layout of TH1::GetArray() for the reco binning
+    void AddOscillatedTo(osc::IOscCalculator* calc, unsigned int mask,
+                         double pot, double* arr) const;
+
+  protected:
+    /// All the components sharing one set of probabilities
+    struct Block
+    {
+      Block(const Binning& bins) : trueBins(bins) {}
+
+      /// Every edge of every component's true binning
+      Binning trueBins;
+      std::vector<unsigned int> comps;
+      /// The copied components, each indexed [true bin*fNReco+reco bin]
+      std::vector<double> data;
+    };
+
+    struct Component
+    {
+      int from, to;
+      unsigned int block;
+      unsigned int nTrue; ///< Including under and overflow
+      std::vector<double> edges; ///< Of its own true binning
+      std::vector<char> filled; ///< Whether each true row has any content
+      /// The row of the block's binning that each true row starts in
+      std::vector<unsigned int> rows;
+      unsigned int offset; ///< Start of this component within its block
+      /// Set instead of a place in the block for compressed components
+      std::shared_ptr<const BandedMatrix> banded;
+      double scale; ///< To unit POT, for \ref banded
+      /// Set instead of a place in the block by \ref AddRef
+      const OscillatableSpectrum* ref;
+    };
+
+    /// Register a component with no contents yet, returning its index
+    unsigned int NewComponent(const OscillatableSpectrum& s,
+                              unsigned int nReco, unsigned int nTrue,
+                              int from, int to);
+    void UpdateTally();
+
+    /// \brief Oscillate the components in \a mask into \a out, indexed
+    /// [component*fNReco+reco bin], for unit POT
+    void Contract(osc::IOscCalculator* calc, unsigned int mask,
+                  std::vector<double>& out) const;
+
+    std::vector<Block> fBlocks;
+    std::vector<Component> fComps;
+    unsigned int fNReco; ///< Including under and overflow
+
+    /// All the oscillated components, by the key of the calculator
+    mutable BoundedCache<std::string, std::vector<double>> fOscCache;
+
+    MemoryTally::Handle fMem;
+  };
+}
@@ -1,5 +1,6 @@
 #include "CAFAna/Core/ReweightableSpectrum.h"
 
+#include "CAFAna/Core/BandedMatrix.h"
 #include "CAFAna/Core/Binning.h"
 #include "CAFAna/Core/HistCache.h"
 #include "CAFAna/Core/Ratio.h"
@@ -14,6 +15,7 @@
 #include <cassert>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 namespace ana
 {
@@ -63,6 +65,8 @@ namespace ana
                         xbins.NBins(), &xbins.Edges()[0],
                         ybins.NBins(), &ybins.Edges()[0]);
 
+    fTally.Set(fHist);
+
     loader.AddReweightableSpectrum(*this, recoAxis.GetMultiDVar(), cut, shift, wei);
   }
 
@@ -85,6 +89,8 @@ namespace ana
 
     // Ensure errors get accumulated properly
     fHist->Sumw2();
+
+    fTally.Set(fHist);
   }
 
   //----------------------------------------------------------------------
@@ -130,6 +136,8 @@ namespace ana
       fHist->Add(h);
     }
 
+    fTally.Set(fHist);
+
     fTrueLabel = h->GetYaxis()->GetTitle();
   }
 
@@ -142,6 +150,7 @@ namespace ana
     : ReweightableSpectrum(labels, bins, rwVar)
   {
     fHist = h.release();
+    fTally.Set(fHist);
     fPOT = pot;
     fLivetime = livetime;
 
@@ -172,7 +181,10 @@ namespace ana
   {
     DontAddDirectory guard;
 
-    fHist = new TH2D(*rhs.fHist);
+    fHist = rhs.fHist ? new TH2D(*rhs.fHist) : 0;
+    fBanded = rhs.fBanded;
+    fTrueAxis = rhs.fTrueAxis;
+    if(fBanded) fTally.Set(fBanded->Bytes()); else fTally.Set(fHist);
 
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
@@ -192,7 +204,10 @@ namespace ana
     fBins = rhs.fBins;
 
     delete fHist;
-    fHist = new TH2D(*rhs.fHist);
+    fHist = rhs.fHist ? new TH2D(*rhs.fHist) : 0;
+    fBanded = rhs.fBanded;
+    fTrueAxis = rhs.fTrueAxis;
+    if(fBanded) fTally.Set(fBanded->Bytes()); else fTally.Set(fHist);
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
 
@@ -207,7 +222,7 @@ namespace ana
     // Could have a file temporarily open
     DontAddDirectory guard;
 
-    TH2D* ret = new TH2D(*fHist);
+    TH2D* ret = fHist ? new TH2D(*fHist) : ExpandBanded();
     if(fPOT){
       ret->Scale(pot/fPOT);
     }
@@ -228,13 +243,14 @@ namespace ana
 
   //----------------------------------------------------------------------
   TAxis const *ReweightableSpectrum::GetReweightTAxis() const {
-    return fHist->GetYaxis();
+    return fHist ? fHist->GetYaxis() : fTrueAxis.get();
   }
 
 
   //----------------------------------------------------------------------
   void ReweightableSpectrum::Fill(double x, double y, double w)
   {
+    Decompress();
     fHist->Fill(x, y, w);
   }
 
@@ -272,7 +288,7 @@ namespace ana
     // Create a suitably-sized space for the result
     std::unique_ptr<TH1D> h(HistCache::New("", Bins1DX()));
 
-    ProjectionX(fHist, h.get());
+    if(fBanded) fBanded->ProjectX(h->GetArray()); else ProjectionX(fHist, h.get());
 
     return Spectrum(std::move(h), fLabels, fBins, fPOT, fLivetime);
   }
@@ -309,51 +325,94 @@ namespace ana
     DontAddDirectory guard;
 
     // Create a suitably-sized space for the result
-    std::unique_ptr<TH1D> h(HistCache::New("", fHist->GetYaxis()));
+    std::unique_ptr<TH1D> h(HistCache::New("", GetReweightTAxis()));
 
-    ProjectionY(fHist, h.get());
+    if(fBanded) fBanded->ProjectY(h->GetArray()); else ProjectionY(fHist, h.get());
 
     return Spectrum(std::move(h), fLabels, fBins, fPOT, fLivetime);
   }
 
-  //----------------------------------------------------------------------
-  Spectrum ReweightableSpectrum::WeightedBy(const TH1* ws) const
+  /// Helper for \ref WeightedBy and \ref AddWeightedTo
+  static void WeightedByHelper(TH2D* from, const TH1* ws, double scale, double* retArr)
   {
-    // This function is in the inner loop of oscillation fits, so some
-    // optimization has been done.
-
-    DontAddDirectory guard;
+    assert(ws->GetNbinsX() == from->GetNbinsY());
 
-    assert(ws->GetNbinsX() == fHist->GetNbinsY());
-
-    TH1D* hRet = HistCache::New("", Bins1DX());
-
-    const int X = fHist->GetNbinsX();
-    const int Y = fHist->GetNbinsY();
+    const int X = from->GetNbinsX();
+    const int Y = from->GetNbinsY();
 
     // Direct access to the bins is faster
-    double* retArr = hRet->GetArray();
-    double* histArr = fHist->GetArray();
+    double* histArr = from->GetArray();
 
     int bin = 0;
     for(int y = 0; y < Y+2; ++y){
-      const double w = ws->GetBinContent(y);
+      const double w = scale*ws->GetBinContent(y);
       for(int x = 0; x < X+2; ++x){
         // Our loops go over the bins in the order they are internally in
-        // fHist, and we do overflows, so we keep up exactly. If you get
+        // 'from', and we do overflows, so we keep up exactly. If you get
         // paranoid, reenable this briefly.
 
-        // assert(bin == fHist->GetBin(x, y));
+        // assert(bin == from->GetBin(x, y));
 
         retArr[x] += histArr[bin]*w;
         ++bin;
       }
     }
+  }
+
+  /// Helper for \ref WeightedBy and \ref AddWeightedTo when compressed
+  static void WeightedByHelper(const BandedMatrix& from, const TH1* ws,
+                               double scale, double* retArr)
+  {
+    assert(ws->GetNbinsX()+2 == int(from.NY()));
+
+    // The weights are practically always a TH1D (from OscCurve), whose
+    // contents we can use directly
+    const TH1D* wsD = dynamic_cast<const TH1D*>(ws);
+    if(wsD){
+      from.AddWeightedTo(wsD->GetArray(), scale, retArr);
+      return;
+    }
+
+    std::vector<double> w(from.NY());
+    for(unsigned int y = 0; y < from.NY(); ++y) w[y] = ws->GetBinContent(y);
+
+    from.AddWeightedTo(w.data(), scale, retArr);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum ReweightableSpectrum::WeightedBy(const TH1* ws) const
+  {
+    // This function is in the inner loop of oscillation fits, so some
+    // optimization has been done.
+
+    DontAddDirectory guard;
+
+    TH1D* hRet = HistCache::New("", Bins1DX());
+
+    if(fBanded)
+      WeightedByHelper(*fBanded, ws, 1, hRet->GetArray());
+    else
+      WeightedByHelper(fHist, ws, 1, hRet->GetArray());
 
-    // TODO: can this all be more efficient?
     return Spectrum(std::unique_ptr<TH1D>(hRet), fLabels, fBins, fPOT, fLivetime);
   }
 
+  //----------------------------------------------------------------------
+  void ReweightableSpectrum::AddWeightedTo(const TH1* ws, double pot,
+                                           double* arr) const
+  {
+    if(!fPOT){
+      // How can it have events but no POT?
+      assert(!fHist || fHist->Integral(0, -1, 0, -1) == 0);
+      return;
+    }
+
+    if(fBanded)
+      WeightedByHelper(*fBanded, ws, pot/fPOT, arr);
+    else
+      WeightedByHelper(fHist, ws, pot/fPOT, arr);
+  }
+
 
   //----------------------------------------------------------------------
   void ReweightableSpectrum::ReweightToTrueSpectrum(const Spectrum& target)
@@ -361,6 +420,8 @@ namespace ana
     // This is a big component of what extrapolations do, so it has been
     // optimized for speed
 
+    Decompress();
+
     Ratio corr(target, WeightingVariable());
     std::unique_ptr<TH1D> hcorr(corr.ToTH1());
 
@@ -398,6 +459,8 @@ namespace ana
     // This is a big component of what extrapolations do, so it has been
     // optimized for speed
 
+    Decompress();
+
     Ratio corr(target, UnWeighted());
     std::unique_ptr<TH1D> hcorr(corr.ToTH1());
 
@@ -430,8 +493,13 @@ namespace ana
 
   ReweightableSpectrum& ReweightableSpectrum::PlusEqualsHelper(const ReweightableSpectrum& rhs, int sign)
   {
+    Decompress();
+
+    std::unique_ptr<TH2D> rhsTmp;
+    const TH2D* rhsHist = rhs.DenseHist(rhsTmp);
+
     // In this case it would be OK to have no POT/livetime
-    if(rhs.fHist && rhs.fHist->Integral(0, -1) == 0) return *this;
+    if(rhsHist && rhsHist->Integral(0, -1) == 0) return *this;
 
 
     if((!fPOT && !fLivetime) || (!rhs.fPOT && !rhs.fLivetime)){
@@ -460,7 +528,7 @@ namespace ana
 
     if(fPOT && rhs.fPOT){
       // Scale by POT when possible
-      if(rhs.fHist) fHist->Add(rhs.fHist, sign*fPOT/rhs.fPOT);
+      if(rhsHist) fHist->Add(rhsHist, sign*fPOT/rhs.fPOT);
 
       if(fLivetime && rhs.fLivetime){
         // If POT/livetime ratios match, keep regular lifetime, otherwise zero
@@ -479,7 +547,7 @@ namespace ana
 
     if(fLivetime && rhs.fLivetime){
       // Scale by livetime, the only thing in common
-      if(rhs.fHist) fHist->Add(rhs.fHist, sign*fLivetime/rhs.fLivetime);
+      if(rhsHist) fHist->Add(rhsHist, sign*fLivetime/rhs.fLivetime);
 
       if(!fPOT && rhs.fPOT){
         // If the RHS has a POT and we don't, copy it in (suitably scaled)
@@ -529,9 +597,76 @@ namespace ana
   //----------------------------------------------------------------------
   void ReweightableSpectrum::Clear()
   {
+    Decompress();
     fHist->Reset();
   }
 
+  //----------------------------------------------------------------------
+  double ReweightableSpectrum::Compress(double tolerance)
+  {
+    if(!fHist) return CompressionError();
+
+    assert(fLoaderCount.empty()); // Compressing something still being filled
+
+    const unsigned int nx = fHist->GetNbinsX()+2;
+    const unsigned int ny = fHist->GetNbinsY()+2;
+
+    auto banded = std::make_shared<const BandedMatrix>(fHist->GetArray(), nx, ny, tolerance);
+
+    // Not worth it
+    if(banded->Bytes() >= long(nx*ny*sizeof(double))) return 0;
+
+    fTrueAxis = std::make_shared<const TAxis>(*fHist->GetYaxis());
+    fBanded = banded;
+    delete fHist;
+    fHist = 0;
+    fTally.Set(fBanded->Bytes());
+
+    return CompressionError();
+  }
+
+  //----------------------------------------------------------------------
+  double ReweightableSpectrum::CompressionError() const
+  {
+    return fBanded ? fBanded->MaxError() : 0;
+  }
+
+  //----------------------------------------------------------------------
+  void ReweightableSpectrum::Decompress()
+  {
+    if(!fBanded) return;
+
+    fHist = ExpandBanded();
+    fBanded.reset();
+    fTrueAxis.reset();
+    fTally.Set(fHist);
+  }
+
+  //----------------------------------------------------------------------
+  const TH2D* ReweightableSpectrum::DenseHist(std::unique_ptr<TH2D>& tmp) const
+  {
+    if(!fBanded) return fHist;
+
+    tmp.reset(ExpandBanded());
+    return tmp.get();
+  }
+
+  //----------------------------------------------------------------------
+  TH2D* ReweightableSpectrum::ExpandBanded() const
+  {
+    assert(fBanded && fTrueAxis);
+
+    DontAddDirectory guard;
+
+    TH2D* ret = HistCache::NewTH2D("", Bins1DX(), Binning::FromTAxis(fTrueAxis.get()));
+    assert(ret->GetNcells() == int(fBanded->NX()*fBanded->NY()));
+
+    fBanded->Expand(ret->GetArray());
+    ret->GetYaxis()->SetTitle(fTrueAxis->GetTitle());
+
+    return ret;
+  }
+
   //----------------------------------------------------------------------
   void ReweightableSpectrum::RemoveLoader(SpectrumLoaderBase* p)
   { fLoaderCount.erase(p); }
@@ -548,8 +683,10 @@ namespace ana
 
     TObjString("ReweightableSpectrum").Write("type");
 
-    fHist->GetYaxis()->SetTitle(fTrueLabel.c_str());
-    fHist->Write("hist");
+    std::unique_ptr<TH2D> tmpHist;
+    TH2D* h = const_cast<TH2D*>(DenseHist(tmpHist));
+    h->GetYaxis()->SetTitle(fTrueLabel.c_str());
+    h->Write("hist");
     TH1D hPot("", "", 1, 0, 1);
     hPot.Fill(.5, fPOT);
     hPot.Write("pot");
@@ -603,7 +740,7 @@ namespace ana
                                                   hLivetime->GetBinContent(1));
   }
 
-void ReweightableSpectrum::Scale(double scale) { fHist->Scale(scale); }
+void ReweightableSpectrum::Scale(double scale) { Decompress(); fHist->Scale(scale); }
 
   //----------------------------------------------------------------------
   Binning ReweightableSpectrum::Bins1DX() const
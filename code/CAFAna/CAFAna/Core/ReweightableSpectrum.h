@@ -1,15 +1,20 @@
 #pragma once
 
+#include "CAFAna/Core/MemoryTally.h"
 #include "CAFAna/Core/Spectrum.h"
 
+#include <memory>
 #include <string>
 
+class TAxis;
 class TDirectory;
 class TH2;
 class TH2D;
 
 namespace ana
 {
+  class BandedMatrix;
+
   /// %Spectrum with the value of a second variable, allowing for reweighting
   class ReweightableSpectrum
   {
@@ -67,6 +72,11 @@ namespace ana
 
     Spectrum WeightedBy(const TH1* weights) const;
 
+    /// \brief Add the result of \ref WeightedBy, scaled to \a pot, into \a arr
+    ///
+    /// \a arr has the layout of TH1::GetArray() for the x-axis binning.
+    void AddWeightedTo(const TH1* weights, double pot, double* arr) const;
+
     /// Rescale bins so that \ref WeightingVariable will return \a target
     void ReweightToTrueSpectrum(const Spectrum& target);
     /// Recale bins so that \ref Unweighted will return \a target
@@ -84,6 +94,28 @@ namespace ana
 
     void Clear();
 
+    /// \brief Replace the dense template with a \ref BandedMatrix
+    /// approximation, to save memory and time in \ref WeightedBy
+    ///
+    /// \ref WeightedBy, \ref AddWeightedTo and the projections work from the
+    /// compressed form directly. Anything that modifies the template first
+    /// restores a dense one, holding the approximated contents. Statistical
+    /// errors are not kept. Does nothing if it wouldn't save any memory.
+    ///
+    /// \param tolerance Fraction of each reco bin's unweighted content that
+    ///                  may be lost
+    /// \return \ref CompressionError
+    double Compress(double tolerance);
+    bool IsCompressed() const {return bool(fBanded);}
+    /// \brief Largest fraction of any reco bin's unweighted content dropped by
+    /// \ref Compress, zero if not compressed
+    ///
+    /// For weights in [0, 1] this bounds the absolute error of each bin of
+    /// \ref WeightedBy, in units of that bin's unweighted content. Relative to
+    /// the weighted result the error can be larger by up to the inverse of
+    /// the typical weight, e.g. ~20x for an appearance channel with P~0.05.
+    double CompressionError() const;
+
     /// Function to save a ReweightableSpectrum to file
     /// the fRWVar member is not written to file, so when
     /// the spectrum is loaded back from file, ReweightVar
@@ -144,16 +176,30 @@ namespace ana
 
     ReweightableSpectrum& PlusEqualsHelper(const ReweightableSpectrum& rhs, int sign);
 
-    void RemoveLoader(SpectrumLoaderBase*);
+    virtual void RemoveLoader(SpectrumLoaderBase*);
     void AddLoader(SpectrumLoaderBase*);
 
     void Scale(double);
 
     Binning Bins1DX() const;
 
+    /// Go back to a dense \ref fHist, if we were compressed
+    void Decompress();
+    /// \ref fHist, or if we're compressed a dense copy owned by \a tmp
+    const TH2D* DenseHist(std::unique_ptr<TH2D>& tmp) const;
+    /// A new histogram holding the expanded \ref fBanded
+    TH2D* ExpandBanded() const;
+
     Var fRWVar; ///< What goes on the y axis?
 
     TH2D* fHist;
+    /// Accounts for fHist. Update whenever it's replaced
+    MemoryTally::Handle fTally{MemoryTally::k2DTemplates};
+    /// \brief Replaces fHist (which is then null) once compressed. Never
+    /// modified, so copies share it
+    std::shared_ptr<const BandedMatrix> fBanded;
+    /// The y axis of fHist, kept while compressed
+    std::shared_ptr<const TAxis> fTrueAxis;
     double fPOT;
     double fLivetime;
 
@@ -108,6 +108,8 @@ namespace ana
       fHist = HistCache::New("", h->GetXaxis());
       fHist->Add(h);
     }
+
+    fTally.Set(fHist);
   }
 
   //----------------------------------------------------------------------
@@ -117,6 +119,7 @@ namespace ana
                      double pot, double livetime)
     : fHist(h.release()), fHistSparse(0), fPOT(pot), fLivetime(livetime), fLabels(labels), fBins(bins)
   {
+    fTally.Set(fHist);
   }
 
   //----------------------------------------------------------------------
@@ -250,8 +253,10 @@ namespace ana
     DontAddDirectory guard;
 
     assert(rhs.fHist || rhs.fHistSparse);
-    if(rhs.fHist)
+    if(rhs.fHist){
       fHist = HistCache::Copy(rhs.fHist, rhs.Bins1D());
+      fTally.Set(fHist);
+    }
     if(rhs.fHistSparse){
       // Doesn't exist?
       // fHistSparse = new THnSparseD(*rhs.fHistSparse);
@@ -275,6 +280,7 @@ namespace ana
     if(rhs.fHist){
       fHist = rhs.fHist;
       rhs.fHist = 0;
+      fTally = std::move(rhs.fTally);
     }
     if(rhs.fHistSparse){
       fHistSparse = rhs.fHistSparse;
@@ -306,6 +312,8 @@ namespace ana
       fHist = 0;
     }
 
+    fTally.Set(fHist);
+
     fPOT = rhs.fPOT;
     fLivetime = rhs.fLivetime;
     fLabels = rhs.fLabels;
@@ -337,6 +345,8 @@ namespace ana
     rhs.fHist = 0;
     rhs.fHistSparse = 0;
 
+    fTally = std::move(rhs.fTally);
+
     assert( fLoaderCount.empty() ); // Copying with pending loads is unexpected
 
     return *this;
@@ -367,6 +377,8 @@ namespace ana
 
       // Ensure errors get accumulated properly
       fHist->Sumw2();
+
+      fTally.Set(fHist);
     }
   }
 
@@ -438,6 +450,28 @@ namespace ana
 
   }
 
+  //----------------------------------------------------------------------
+  void Spectrum::AddTo(double pot, double* arr) const
+  {
+    assert(fHist && "Spectrum::AddTo() doesn't support sparse spectra");
+
+    if(!fPOT){
+      // Allow zero POT if there are also zero events
+      if(fHist->Integral(0, -1) != 0){
+        std::cout << "Error: Spectrum with " << fHist->Integral(0, -1)
+                  << " entries has zero POT, no way to scale to "
+                  << pot << " POT." << std::endl;
+        abort();
+      }
+      return;
+    }
+
+    const double scale = pot/fPOT;
+    const double* src = fHist->GetArray();
+    const int N = fHist->GetNbinsX()+2;
+    for(int i = 0; i < N; ++i) arr[i] += scale*src[i];
+  }
+
   TH1D* Spectrum::ToTH1(double exposure, Color_t col, Style_t style,
 			EExposureType expotype,
 			EBinType bintype) const
@@ -4,6 +4,7 @@
 #include "CAFAna/Core/Var.h"
 #include "CAFAna/Core/Cut.h"
 #include "CAFAna/Core/HistAxis.h"
+#include "CAFAna/Core/MemoryTally.h"
 #include "CAFAna/Core/SpectrumLoaderBase.h"
 #include "CAFAna/Core/Utilities.h"
 
@@ -173,6 +174,12 @@ namespace ana
 
     TH1* ToTH1ProjectX(double exposure, EExposureType expotype = kPOT) const;
 
+    /// \brief Add the contents, scaled to \a pot, into \a arr
+    ///
+    /// \a arr has the layout of TH1::GetArray() for \ref Bins1D, ie
+    /// including underflow and overflow. Avoids the copy ToTH1() makes.
+    void AddTo(double pot, double* arr) const;
+
     /// \brief Return total number of events scaled to \a pot
     ///
     /// \param exposure POT/livetime to scale to
@@ -207,6 +214,11 @@ namespace ana
 
     void Clear();
 
+    /// \brief Report this spectrum's memory under \a cat in \ref MemoryTally
+    ///
+    /// eg because it's being held in a cache. Copies revert to kSpectra.
+    void SetMemoryCategory(MemoryTally::Category cat) {fTally.SetCategory(cat);}
+
     /// Multiply this spectrum by a constant c
     void Scale(double c);
 
@@ -232,6 +244,9 @@ namespace ana
     std::vector<std::string> GetLabels() const {return fLabels;}
     std::vector<Binning> GetBinnings() const {return fBins;}
 
+    /// The binning of the underlying 1D histogram
+    Binning Bins1D() const;
+
   protected:
     Spectrum(const std::vector<std::string>& labels,
              const std::vector<Binning>& bins,
@@ -242,13 +257,13 @@ namespace ana
     void RemoveLoader(SpectrumLoaderBase*);
     void AddLoader(SpectrumLoaderBase*);
 
-    Binning Bins1D() const;
-
     /// Helper for operator+= and operator-=
     Spectrum& PlusEqualsHelper(const Spectrum& rhs, int sign);
 
     TH1D* fHist;
     THnSparseD* fHistSparse;
+    /// Accounts for fHist. Update whenever it's replaced
+    MemoryTally::Handle fTally{MemoryTally::kSpectra};
     double fPOT;
     double fLivetime;
 
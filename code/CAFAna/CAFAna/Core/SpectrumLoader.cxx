@@ -1,5 +1,7 @@
 #include "CAFAna/Core/SpectrumLoader.h"
 
+#include "CAFAna/Core/EnsembleSpectrum.h"
+#include "CAFAna/Core/EventList.h"
 #include "CAFAna/Core/Progress.h"
 #include "CAFAna/Core/ReweightableSpectrum.h"
 #ifndef DONT_USE_SAM
@@ -18,6 +20,7 @@
 #include <iostream>
 #include <cmath>
 
+#include "TBranch.h"
 #include "TFile.h"
 #include "TH2.h"
 #include "TTree.h"
@@ -93,16 +96,14 @@ namespace ana
 
     Progress* prog = 0;
 
-    int fileIdx = -1;
     while(TFile* f = GetNextFile()){
-      ++fileIdx;
-
       if(Nfiles >= 0 && !prog) prog = new Progress(TString::Format("Filling %lu spectra from %d files matching '%s'", fHistDefs.TotalSize(), Nfiles, fWildcard.c_str()).Data());
 
       HandleFile(f, Nfiles == 1 ? prog : 0);
 
-      if(Nfiles > 1 && prog) prog->SetProgress((fileIdx+1.)/Nfiles);
-    } // end for fileIdx
+      // Count the files the subsample skipped too
+      if(Nfiles > 1 && prog) prog->SetProgress(double(fNFilesSeen)/Nfiles);
+    } // end while GetNextFile
 
     StoreExposures();
 
@@ -145,12 +146,9 @@ namespace ana
     }
     assert(tr);
 
-    // Surely no-one will generate 1000 universes?
-    std::vector<std::array<double, 1000>> genie_tmp;
     const std::vector<std::string> genie_names = GetGenieWeightNames();
-    genie_tmp.resize(genie_names.size());
-    std::vector<int> genie_size_tmp;
-    genie_size_tmp.resize(genie_names.size());
+    fGenieTmp.resize(genie_names.size());
+    fGenieSizeTmp.resize(genie_names.size());
 
     FloatingExceptionOnNaN fpnan(false);
 
@@ -255,17 +253,40 @@ namespace ana
     sr.dune.genie_cv_wgt .resize(genie_names.size());
 
     for(unsigned int i = 0; i < genie_names.size(); ++i){
-      SetBranchChecked(tr, "wgt_"+genie_names[i], &genie_tmp[i]);
-      SetBranchChecked(tr, genie_names[i]+"_nshifts", &genie_size_tmp[i]);
+      SetBranchChecked(tr, "wgt_"+genie_names[i], &fGenieTmp[i]);
+      SetBranchChecked(tr, genie_names[i]+"_nshifts", &fGenieSizeTmp[i]);
       SetBranchChecked(tr, genie_names[i]+"_cvwgt", &sr.dune.genie_cv_wgt[i]);
     }
 
+    // The universe weights are most of the bytes in each entry, but only
+    // systematic shifts look at them. Take them out of the bulk read, and
+    // let LoadColdFields() fetch them for the entries that need them.
+    fColdBranches.clear();
+    for(const std::string& name: genie_names){
+      for(const std::string& bname: {"wgt_"+name, name+"_nshifts"}){
+        TBranch* br = tr->GetBranch(bname.c_str());
+        if(!br) continue;
+        br->SetStatus(false);
+        fColdBranches.push_back(br);
+      }
+    }
+
     int Nentries = tr->GetEntries();
     if (max_entries != 0 && max_entries < Nentries) Nentries = max_entries;
 
+    long nKept = 0;
     for(int n = 0; n < Nentries; ++n){
+      // Decide before reading, so that a subsample also saves the I/O
+      if(!KeepEvent(n)) continue;
+      ++nKept;
+
       tr->GetEntry(n);
 
+      // Cold fields are stale until someone asks for them
+      fColdEntry = n;
+      fColdLoaded = false;
+      for(std::vector<double>& w: sr.dune.genie_wgt) w.clear();
+
       //Set GENIE_ScatteringMode and eRec_FromDep
       if (sr.dune.isFD) {
         sr.dune.eRec_FromDep = sr.dune.eDepP + sr.dune.eDepN + sr.dune.eDepPip +
@@ -331,10 +352,6 @@ namespace ana
       sr.dune.total_cv_wgt = 1;
 
       for(unsigned int i = 0; i < genie_names.size(); ++i){
-        const int Nuniv = genie_size_tmp[i];
-        assert(Nuniv >= 0 && Nuniv <= int(genie_tmp[i].size()));
-        sr.dune.genie_wgt[i].resize(Nuniv);
-
 	// Do some error checking here
 	if (std::isnan(sr.dune.genie_cv_wgt[i]) ||
 	    std::isinf(sr.dune.genie_cv_wgt[i]) ||
@@ -343,16 +360,34 @@ namespace ana
 		    << sr.dune.genie_cv_wgt[i] << std::endl;
 	else
 	  sr.dune.total_cv_wgt *= sr.dune.genie_cv_wgt[i];
-
-        for(int j = 0; j < Nuniv; ++j){
-          sr.dune.genie_wgt[i][j] = genie_tmp[i][j];
-        }
       }
 
       HandleRecord(&sr);
 
       if(prog && n%10000 == 0) prog->SetProgress(double(n)/Nentries);
     } // end for n
+
+    ScaleFileExposure(nKept, Nentries);
+
+    // These belong to the tree, which is about to go away
+    fColdBranches.clear();
+    fColdLoaded = true;
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoader::LoadColdFields(caf::StandardRecord* sr)
+  {
+    if(fColdLoaded) return;
+    fColdLoaded = true;
+
+    for(TBranch* br: fColdBranches) br->GetEntry(fColdEntry, 1);
+
+    for(unsigned int i = 0; i < fGenieTmp.size(); ++i){
+      const int Nuniv = fGenieSizeTmp[i];
+      assert(Nuniv >= 0 && Nuniv <= int(fGenieTmp[i].size()));
+      sr->dune.genie_wgt[i].assign(fGenieTmp[i].begin(),
+                                   fGenieTmp[i].begin()+Nuniv);
+    }
   }
 
   //----------------------------------------------------------------------
@@ -416,6 +451,7 @@ namespace ana
       bool shifted = false;
       // Can special-case nominal to not pay cost of Shift() or Restorer
       if(!shift.IsNominal()){
+        LoadColdFields(sr);
         restore = new Restorer;
         shift.Shift(*restore, sr, systWeight);
         // Did the Shift actually modify the event at all?
@@ -461,6 +497,13 @@ namespace ana
 
             for(Spectrum* s: vardef.second.spects) s->Fill(val, wei);
 
+            // All the universes from this one evaluation of cut, var and wei
+            for(EnsembleSpectrum* es: vardef.second.ensembles) es->Fill(val, wei, sr);
+
+            // Evaluating the syst responses needs the whole record
+            if(!vardef.second.eventLists.empty()) LoadColdFields(sr);
+            for(EventList* el: vardef.second.eventLists) el->Fill(val, wei, sr);
+
             for(ReweightableSpectrum* rw: vardef.second.rwSpects){
               const double yval = rw->ReweightVar()(sr);
 
@@ -500,6 +543,12 @@ namespace ana
     // printout remains relevant...
 
     std::cout << fPOT << " POT" << std::endl;
+
+    if(fSubsampleFrac < 1){
+      std::cout << "Subsample processed " << fPOT << " of " << fTotalPOT
+                << " POT. Statistical errors are inflated by a factor "
+                << StatInflation() << std::endl;
+    }
   }
 
   //----------------------------------------------------------------------
@@ -516,6 +565,11 @@ namespace ana
           for(auto& vardef: weidef.second){
             for(Spectrum* s: vardef.second.spects) s->fPOT += fPOT;
             for(ReweightableSpectrum* rw: vardef.second.rwSpects) rw->fPOT += fPOT;
+            for(EnsembleSpectrum* es: vardef.second.ensembles) es->fPOT += fPOT;
+            for(EventList* el: vardef.second.eventLists){
+              el->fPOT += fPOT;
+              el->UpdateTally();
+            }
           }
         }
       }
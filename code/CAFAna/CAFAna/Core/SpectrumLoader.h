@@ -2,6 +2,9 @@
 
 #include "CAFAna/Core/SpectrumLoaderBase.h"
 
+#include <array>
+
+class TBranch;
 class TFile;
 
 namespace ana
@@ -50,6 +53,12 @@ namespace ana
 
     virtual void HandleRecord(caf::StandardRecord* sr);
 
+    /// \brief Read the cold parts of the record (GENIE universe weights) for
+    /// the current entry, if that hasn't been done already
+    ///
+    /// Only systematic shifts need these, so most entries never pay for them
+    void LoadColdFields(caf::StandardRecord* sr);
+
     /// Save results of AccumulateExposures into the individual spectra
     virtual void StoreExposures();
 
@@ -81,5 +90,14 @@ namespace ana
     std::vector<double> fLivetimeByCut; ///< Indexing matches fAllCuts
     std::vector<double> fPOTByCut;      ///< Indexing matches fAllCuts
     int max_entries;
+
+    /// Branches skipped by the bulk read in \ref HandleFile, for \ref LoadColdFields
+    std::vector<TBranch*> fColdBranches;
+    long fColdEntry = -1;
+    bool fColdLoaded = true;
+
+    // Surely no-one will generate 1000 universes?
+    std::vector<std::array<double, 1000>> fGenieTmp;
+    std::vector<int> fGenieSizeTmp;
   };
 }
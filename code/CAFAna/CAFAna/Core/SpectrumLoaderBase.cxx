@@ -1,5 +1,7 @@
 #include "CAFAna/Core/SpectrumLoaderBase.h"
 
+#include "CAFAna/Core/EnsembleSpectrum.h"
+#include "CAFAna/Core/EventList.h"
 #include "CAFAna/Core/Progress.h"
 #include "CAFAna/Core/ReweightableSpectrum.h"
 #ifndef DONT_USE_SAM
@@ -22,6 +24,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include "boost/algorithm/string.hpp"
 
@@ -45,17 +49,33 @@ namespace ana
     if(it != rwSpects.end()) rwSpects.erase(it);
   }
 
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::SpectList::Erase(EnsembleSpectrum* es)
+  {
+    auto it = std::find(ensembles.begin(), ensembles.end(), es);
+    if(it != ensembles.end()) ensembles.erase(it);
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::SpectList::Erase(EventList* el)
+  {
+    auto it = std::find(eventLists.begin(), eventLists.end(), el);
+    if(it != eventLists.end()) eventLists.erase(it);
+  }
+
   //----------------------------------------------------------------------
   void SpectrumLoaderBase::SpectList::RemoveLoader(SpectrumLoaderBase* l)
   {
     for(Spectrum* s: spects) s->RemoveLoader(l);
     for(ReweightableSpectrum* rs: rwSpects) rs->RemoveLoader(l);
+    for(EnsembleSpectrum* es: ensembles) es->RemoveLoader(l);
+    for(EventList* el: eventLists) el->RemoveLoader(l);
   }
 
   //----------------------------------------------------------------------
   size_t SpectrumLoaderBase::SpectList::TotalSize() const
   {
-    return spects.size() + rwSpects.size();
+    return spects.size() + rwSpects.size() + ensembles.size() + eventLists.size();
   }
 
   //----------------------------------------------------------------------
@@ -128,8 +148,26 @@ namespace ana
 
   //----------------------------------------------------------------------
   SpectrumLoaderBase::SpectrumLoaderBase(DataSource src)
-    : fSource(src), fGone(false), fPOT(0)
+    : fSource(src), fGone(false), fPOT(0),
+      fSubsampleFrac(1), fSubsampleMode(kSubsampleEvents), fSubsampleSeed(0),
+      fFileHash(0), fFilePOT(0), fTotalPOT(0), fNFilesSeen(0)
   {
+    // Format is frac[,files][,seed]
+    if(getenv("CAFANA_SUBSAMPLE")){
+      std::vector<std::string> toks;
+      const std::string opt = getenv("CAFANA_SUBSAMPLE");
+      boost::split(toks, opt, boost::is_any_of(","));
+
+      SubsampleMode mode = kSubsampleEvents;
+      unsigned int seed = 0;
+      for(unsigned int i = 1; i < toks.size(); ++i){
+        if(toks[i] == "files") mode = kSubsampleFiles;
+        else if(toks[i] == "events") mode = kSubsampleEvents;
+        else seed = std::stoul(toks[i]);
+      }
+
+      SetSubsample(std::stod(toks[0]), mode, seed);
+    }
   }
 
   //----------------------------------------------------------------------
@@ -270,6 +308,112 @@ namespace ana
     fHistDefs.Erase(spect);
   }
 
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::AddEnsembleSpectrum(EnsembleSpectrum& spect,
+                                               const Var& var,
+                                               const Cut& cut,
+                                               const SystShifts& shift,
+                                               const Var& wei)
+  {
+    if(fGone){
+      std::cerr << "Error: can't add Spectra after the call to Go()" << std::endl;
+      abort();
+    }
+
+    fHistDefs[shift][cut][wei][var].ensembles.push_back(&spect);
+
+    spect.AddLoader(this); // Remember we have a Go() pending
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::RemoveEnsembleSpectrum(EnsembleSpectrum* spect)
+  {
+    fHistDefs.Erase(spect);
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::AddEventList(EventList& list,
+                                        const Var& var,
+                                        const Cut& cut,
+                                        const SystShifts& shift,
+                                        const Var& wei)
+  {
+    if(fGone){
+      std::cerr << "Error: can't add EventLists after the call to Go()" << std::endl;
+      abort();
+    }
+
+    fHistDefs[shift][cut][wei][var].eventLists.push_back(&list);
+
+    list.AddLoader(this); // Remember we have a Go() pending
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::RemoveEventList(EventList* list)
+  {
+    fHistDefs.Erase(list);
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::SetSubsample(double frac,
+                                        SubsampleMode mode,
+                                        unsigned int seed)
+  {
+    if(fGone){
+      std::cerr << "Error: can't change the subsample after Go()" << std::endl;
+      abort();
+    }
+
+    if(frac <= 0 || frac > 1){
+      std::cerr << "Error: subsample fraction must be in (0, 1], not "
+                << frac << std::endl;
+      abort();
+    }
+
+    fSubsampleFrac = frac;
+    fSubsampleMode = mode;
+    fSubsampleSeed = seed;
+
+    if(frac < 1){
+      std::cout << "Processing a " << 100*frac << "% subsample of "
+                << (mode == kSubsampleFiles ? "files" : "events")
+                << " (seed " << seed << ")" << std::endl;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  double SpectrumLoaderBase::StatInflation() const
+  {
+    if(fSubsampleFrac >= 1) return 1;
+    if(fPOT <= 0) return 0; // Nothing processed
+    return sqrt(fTotalPOT/fPOT);
+  }
+
+  //----------------------------------------------------------------------
+  double SpectrumLoaderBase::SubsampleHash(unsigned long key, long n) const
+  {
+    // splitmix64 finalizer. Good enough mixing that consecutive entry numbers
+    // give independent decisions
+    uint64_t z = key + 0x9e3779b97f4a7c15ull*(uint64_t(n)+1) + fSubsampleSeed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z = z ^ (z >> 31);
+    // Top 53 bits as a double in [0, 1)
+    return (z >> 11) * (1./9007199254740992.);
+  }
+
+  //----------------------------------------------------------------------
+  void SpectrumLoaderBase::ScaleFileExposure(long kept, long total)
+  {
+    if(fSubsampleMode != kSubsampleEvents || fSubsampleFrac >= 1) return;
+    if(total <= 0) return;
+
+    // Entries in a file are equivalent, so this is the exposure we actually
+    // processed. Using the realized fraction rather than fSubsampleFrac keeps
+    // the spectra unbiased file by file.
+    fPOT -= fFilePOT*(1-double(kept)/total);
+  }
+
   //----------------------------------------------------------------------
   int SpectrumLoaderBase::NFiles() const
   {
@@ -279,9 +423,35 @@ namespace ana
   //----------------------------------------------------------------------
   TFile* SpectrumLoaderBase::GetNextFile()
   {
-    TFile* f = fFileSource->GetNextFile();
-    if(!f) return 0; // out of files
+    while(true){
+      TFile* f = fFileSource->GetNextFile();
+      if(!f) return 0; // out of files
+
+      ++fNFilesSeen;
+
+      // Key on the file name, not the full path, so that the same files are
+      // chosen whether they're read locally or over xrootd
+      std::string fname = f->GetName();
+      fname = fname.substr(fname.rfind('/')+1);
+      // FNV-1a
+      fFileHash = 14695981039346656037ull;
+      for(char c: fname) fFileHash = (fFileHash ^ (unsigned char)c) * 1099511628211ull;
 
+      fFilePOT = FilePOT(f);
+      fTotalPOT += fFilePOT;
+
+      if(fSubsampleMode == kSubsampleFiles && fSubsampleFrac < 1 &&
+         SubsampleHash(fFileHash, -1) >= fSubsampleFrac) continue;
+
+      fPOT += fFilePOT;
+
+      return f;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  double SpectrumLoaderBase::FilePOT(TFile* f) const
+  {
     TTree* trPot;
     //    if(f->GetListOfKeys()->Contains("cafmaker"))
     //      trPot = (TTree*)f->Get("mvaselectnumu/pottree");
@@ -297,13 +467,14 @@ namespace ana
     double pot;
     trPot->SetBranchAddress("pot", &pot);
 
+    double ret = 0;
     for(int n = 0; n < trPot->GetEntries(); ++n){
       trPot->GetEntry(n);
 
-      fPOT += pot;
+      ret += pot;
     }
 
-    return f;
+    return ret;
   }
 
   //----------------------------------------------------------------------
@@ -23,6 +23,8 @@ namespace ana
 {
   class Spectrum;
   class ReweightableSpectrum;
+  class EnsembleSpectrum;
+  class EventList;
 
   /// Is this data-file representing beam spills or cosmic spills?
   enum DataSource{
@@ -32,12 +34,20 @@ namespace ana
     kCosmic
   };
 
+  /// What \ref SpectrumLoaderBase::SetSubsample should select from
+  enum SubsampleMode{
+    kSubsampleEvents, ///< A fraction of the entries in every file
+    kSubsampleFiles   ///< A fraction of the files, all of their entries
+  };
+
   /// Base class for the various types of spectrum loader
   class SpectrumLoaderBase
   {
   public:
 
     friend class ReweightableSpectrum;
+    friend class EnsembleSpectrum;
+    friend class EventList;
     friend class NDOscillatableSpectrum;
     friend class OscillatableSpectrum;
     friend class Spectrum;
@@ -65,12 +75,48 @@ namespace ana
                                          const SystShifts& shift,
                                          const Var& wei);
 
+    /// For use by the \ref EnsembleSpectrum constructor
+    virtual void AddEnsembleSpectrum(EnsembleSpectrum& spect,
+                                     const Var& var,
+                                     const Cut& cut,
+                                     const SystShifts& shift,
+                                     const Var& wei);
+
+    /// For use by the \ref EventList constructor
+    virtual void AddEventList(EventList& list,
+                              const Var& var,
+                              const Cut& cut,
+                              const SystShifts& shift,
+                              const Var& wei);
+
     /// Load all the registered spectra
     virtual void Go() = 0;
 
     /// Indicate whether or not \ref Go has been called
     virtual bool Gone() const {return fGone;}
 
+    /// \brief Only process a deterministic, seeded fraction of the input
+    ///
+    /// Intended for quick sanity checks of binnings and selections before
+    /// running over everything. The selection depends only on the seed, the
+    /// file names, and the entry numbers, so it's reproducible. The POT
+    /// given to the spectra is that of what was actually processed, so they
+    /// remain unbiased, with statistical errors larger by \ref StatInflation.
+    ///
+    /// Can also be enabled for any job with the environment variable
+    /// CAFANA_SUBSAMPLE=frac[,files][,seed]
+    void SetSubsample(double frac,
+                      SubsampleMode mode = kSubsampleEvents,
+                      unsigned int seed = 0);
+
+    double SubsampleFraction() const {return fSubsampleFrac;}
+
+    /// \brief Factor by which statistical errors exceed those of the full
+    /// sample, based on the fraction of the POT actually processed
+    ///
+    /// Only meaningful once \ref Go has been called
+    double StatInflation() const;
+
   protected:
     /// Component of other constructors
     SpectrumLoaderBase(DataSource src = kBeam);
@@ -93,15 +139,39 @@ namespace ana
     friend class SpectrumLoaderMockData;
     virtual void RemoveSpectrum(Spectrum*);
     virtual void RemoveReweightableSpectrum(ReweightableSpectrum*);
+    virtual void RemoveEnsembleSpectrum(EnsembleSpectrum*);
+    virtual void RemoveEventList(EventList*);
 
     virtual void AccumulateExposures(const caf::SRSpill* spill) = 0;
 
     /// Forwards to \ref fFileSource
     int NFiles() const;
 
-    /// Forwards to \ref fFileSource but also accumulates POT and livetime
+    /// \brief Forwards to \ref fFileSource but also accumulates POT and
+    /// livetime
+    ///
+    /// Files not chosen by the subsample are skipped over here
     TFile* GetNextFile();
 
+    /// Total POT recorded in the metadata of \a f
+    double FilePOT(TFile* f) const;
+
+    /// Should entry \a n of the current file be processed?
+    bool KeepEvent(long n) const
+    {
+      return fSubsampleMode != kSubsampleEvents || fSubsampleFrac >= 1 ||
+        SubsampleHash(fFileHash, n) < fSubsampleFrac;
+    }
+
+    /// \brief Correct the POT of the current file for event subsampling
+    ///
+    /// \param kept  Number of entries that passed \ref KeepEvent
+    /// \param total Number of entries that were offered to it
+    void ScaleFileExposure(long kept, long total);
+
+    /// Uniform in [0, 1), determined only by the seed, \a key, and \a n
+    double SubsampleHash(unsigned long key, long n) const;
+
     std::string fWildcard;
     std::unique_ptr<IFileSource> fFileSource;
 
@@ -111,13 +181,25 @@ namespace ana
 
     double fPOT; ///< Accumulated by calls to \ref GetNextFile
 
+    double fSubsampleFrac; ///< 1 means no subsampling
+    SubsampleMode fSubsampleMode;
+    unsigned int fSubsampleSeed;
+
+    unsigned long fFileHash; ///< Of the current file's name, for \ref KeepEvent
+    double fFilePOT;         ///< POT in the current file
+    double fTotalPOT;        ///< Including what the subsample skipped
+    int fNFilesSeen;         ///< Including files the subsample skipped
+
     /// \brief Helper class for \ref SpectrumLoaderBase
     ///
-    /// List of Spectrum and OscillatableSpectrum, some utility functions
+    /// List of Spectrum, OscillatableSpectrum, EnsembleSpectrum and
+    /// EventList, some utility functions
     struct SpectList
     {
       void Erase(Spectrum* s);
       void Erase(ReweightableSpectrum* os);
+      void Erase(EnsembleSpectrum* es);
+      void Erase(EventList* el);
       void RemoveLoader(SpectrumLoaderBase* l);
       size_t TotalSize() const;
       void GetSpectra(std::vector<Spectrum*>& ss);
@@ -125,6 +207,8 @@ namespace ana
 
       std::vector<Spectrum*> spects;
       std::vector<ReweightableSpectrum*> rwSpects;
+      std::vector<EnsembleSpectrum*> ensembles;
+      std::vector<EventList*> eventLists;
     };
 
     /// \brief Helper class for \ref SpectrumLoaderBase
@@ -218,6 +302,18 @@ namespace ana
                                  const SystShifts& shift,
                                  const Var& wei) override {}
 
+    void AddEnsembleSpectrum(EnsembleSpectrum& spect,
+                             const Var& var,
+                             const Cut& cut,
+                             const SystShifts& shift,
+                             const Var& wei) override {}
+
+    void AddEventList(EventList& list,
+                      const Var& var,
+                      const Cut& cut,
+                      const SystShifts& shift,
+                      const Var& wei) override {}
+
     void AccumulateExposures(const caf::SRSpill* spill) override {};
   };
   /// \brief Dummy loader that doesn't load any files
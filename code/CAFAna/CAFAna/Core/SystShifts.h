@@ -39,6 +39,13 @@ namespace ana
     int ID() const {return fID;}
 
     std::vector<const ISyst*> ActiveSysts() const;
+
+    /// \brief Iterate over the (syst, shift) pairs
+    ///
+    /// For hot loops that can't afford the copy \ref ActiveSysts makes
+    typedef std::unordered_map<const ISyst*, double>::const_iterator const_iterator;
+    const_iterator begin() const {return fSysts.begin();}
+    const_iterator end() const {return fSysts.end();}
   protected:
     std::unordered_map<const ISyst*, double> fSysts;
 
@@ -17,6 +17,7 @@
 #include "TVector3.h"
 #include "TVectorD.h"
 
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <fstream>
@@ -30,7 +31,7 @@ namespace ana
   //----------------------------------------------------------------------
   std::string UniqueName()
   {
-    static int N = 0;
+    static std::atomic<int> N(0);
     return TString::Format("cafanauniq%d", N++).Data();
   }
 
@@ -191,6 +192,14 @@ namespace ana
     return 2-2*o/e;
   }
 
+  //----------------------------------------------------------------------
+  // d2LL/de2
+  double LogLikelihoodSecondDerivative(double e, double o)
+  {
+    if(e <= 0) return 0;
+    return 2*o/(e*e);
+  }
+
   //----------------------------------------------------------------------
   // dLL/dx
   double LogLikelihoodDerivative(const TH1D* eh, const TH1D* oh,
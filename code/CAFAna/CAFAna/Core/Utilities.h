@@ -7,6 +7,7 @@
 #include <vector>
 #include <iostream>
 #include <memory>
+#include <new>
 
 // these are templated types.
 // can't forward-declare them here
@@ -128,6 +129,10 @@ namespace ana
   double LogLikelihoodDerivative(const TH1D* eh, const TH1D* oh,
                                  const std::vector<double>& dedx);
 
+  /// \f$ d^2\chi^2/de^2 \f$ for \ref LogLikelihood. Zero for no expected
+  /// events, where it's undefined
+  double LogLikelihoodSecondDerivative(double e, double o);
+
   /**  \brief Chi-squared calculation using a covariance matrix.
 
        \param exp   Expected bin counts
@@ -286,4 +291,28 @@ namespace ana
   TH1* GetMaskHist(const Spectrum& s,
 		   double xmin=0, double xmax=-1,
 		   double ymin=0, double ymax=-1);
+
+  /// \brief Allocator for std::vector giving cache-line aligned storage
+  ///
+  /// For arrays we want the compiler to vectorise loops over
+  template<class T> struct AlignedAllocator
+  {
+    typedef T value_type;
+    static constexpr std::size_t kAlign = 64;
+
+    AlignedAllocator() {}
+    template<class U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n)
+    {
+      return (T*)::operator new(n*sizeof(T), std::align_val_t(kAlign));
+    }
+    void deallocate(T* p, std::size_t)
+    {
+      ::operator delete(p, std::align_val_t(kAlign));
+    }
+
+    template<class U> bool operator==(const AlignedAllocator<U>&) const {return true;}
+    template<class U> bool operator!=(const AlignedAllocator<U>&) const {return false;}
+  };
 }
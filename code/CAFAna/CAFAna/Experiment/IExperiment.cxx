@@ -2,6 +2,8 @@
 
 #include "CAFAna/Core/Utilities.h"
 
+#include "OscLib/func/IOscCalculator.h"
+
 #include "TFile.h"
 #include "TObjString.h"
 
@@ -17,6 +19,17 @@
 
 namespace ana
 {
+  //----------------------------------------------------------------------
+  double IExperiment::
+  ChiSqAndDerivative(osc::IOscCalculatorAdjustable* calc,
+                     const SystShifts& shift,
+                     std::unordered_map<const ISyst*, double>& dchi) const
+  {
+    // Default implementation: two separate evaluations
+    Derivative(calc, shift, dchi);
+    return ChiSq(calc, shift);
+  }
+
   //----------------------------------------------------------------------
   // Definition to satisfy declaration in Core/LoadFromFile.h
   template<> std::unique_ptr<IExperiment> LoadFrom<IExperiment>(TDirectory* dir)
@@ -32,6 +32,29 @@ namespace ana
       dchi.clear();
     }
 
+    /// \brief \ref ChiSq and \ref Derivative from one call
+    ///
+    /// Returns the chisq and adds to \a dchi with the same conventions as
+    /// \ref Derivative. Gradient-based fits need both at every step, and
+    /// implementations can share the prediction between them. By default
+    /// this just calls the two in turn.
+    virtual double ChiSqAndDerivative(osc::IOscCalculatorAdjustable* calc,
+                                      const SystShifts& shift,
+                                      std::unordered_map<const ISyst*, double>& dchi) const;
+
+    /// \brief Second derivatives of the chisq with respect to \a systs
+    ///
+    /// \a hess is a row-major systs.size() x systs.size() matrix. As with
+    /// \ref Derivative, *add* your contribution to it. Unimplemented, or
+    /// unable to provide a result, clear it to signal that to the caller.
+    virtual void Hessian(osc::IOscCalculator* calc,
+                         const SystShifts& shift,
+                         const std::vector<const ISyst*>& systs,
+                         std::vector<double>& hess) const
+    {
+      hess.clear();
+    }
+
     virtual void SaveTo(TDirectory* dir) const;
   };
 }
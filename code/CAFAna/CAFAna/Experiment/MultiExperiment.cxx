@@ -5,6 +5,7 @@
 #include "TDirectory.h"
 #include "TObjString.h"
 
+#include <algorithm>
 #include <cassert>
 
 namespace ana
@@ -98,6 +99,154 @@ namespace ana
     }
   }
 
+  //----------------------------------------------------------------------
+  double MultiExperiment::
+  ChiSqAndDerivative(osc::IOscCalculatorAdjustable* calc,
+                     const SystShifts& shift,
+                     std::unordered_map<const ISyst*, double>& dchi) const
+  {
+    // Once one of the components turns out not to support derivatives, just
+    // collect the chisq from the rest
+    bool derivs = !dchi.empty();
+
+    double ret = 0;
+    for(unsigned int n = 0; n < fExpts.size(); ++n){
+      if(fSystCorrelations[n].empty()){
+        // If there are no adjustments needed it's easy
+        if(derivs){
+          ret += fExpts[n]->ChiSqAndDerivative(calc, shift, dchi);
+          derivs = !dchi.empty();
+        }
+        else{
+          ret += fExpts[n]->ChiSq(calc, shift);
+        }
+        continue;
+      }
+
+      // Rewrite the shifts into the terms this sub-experiment will accept,
+      // the same way as ChiSq() does
+      SystShifts localShifts = shift;
+      auto dchiLocal = dchi;
+      for(auto& it: dchiLocal) it.second = 0;
+      std::unordered_map<const ISyst*, const ISyst*> reverseMap;
+      for(auto it: fSystCorrelations[n]){
+        // We're mapping prim -> sec
+        const ISyst* prim = it.first;
+        const ISyst* sec = it.second;
+        if(dchi.count(prim)){
+          dchiLocal.erase(dchiLocal.find(prim));
+          if(sec){
+            dchiLocal.emplace(sec, 0);
+            reverseMap[sec] = prim;
+          }
+        }
+        if(shift.GetShift(prim) != 0){
+          // sec can be unset, which means there's no representation needed
+          // of prim in the sub-experiment.
+          if(sec) localShifts.SetShift(sec, shift.GetShift(prim));
+          // We've either translated or discarded prim, so drop it here.
+          localShifts.SetShift(prim, 0);
+        }
+      }
+
+      if(!derivs){
+        ret += fExpts[n]->ChiSq(calc, localShifts);
+        continue;
+      }
+
+      ret += fExpts[n]->ChiSqAndDerivative(calc, localShifts, dchiLocal);
+
+      // One of the components doesn't support derivatives
+      if(dchiLocal.empty()){
+        dchi.clear();
+        derivs = false;
+        continue;
+      }
+
+      // And translate back
+      for(auto it: dchiLocal){
+        if(reverseMap.count(it.first) > 0){
+          dchi[reverseMap[it.first]] += it.second;
+        }
+        else{
+          dchi[it.first] += it.second;
+        }
+      }
+    }
+
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  void MultiExperiment::
+  Hessian(osc::IOscCalculator* calc,
+          const SystShifts& shift,
+          const std::vector<const ISyst*>& systs,
+          std::vector<double>& hess) const
+  {
+    const unsigned int S = systs.size();
+    if(hess.empty()) hess.assign(S*S, 0);
+
+    // Each one should sum into the total so far
+    for(unsigned int n = 0; n < fExpts.size(); ++n){
+      if(fSystCorrelations[n].empty()){
+        // If there are no adjustments needed it's easy
+        fExpts[n]->Hessian(calc, shift, systs, hess);
+        if(hess.empty()) return;
+        continue;
+      }
+
+      // Translate the shifts the same way as Derivative(), and each of our
+      // systs to its index in the sub-experiment's list, or -1 if it has no
+      // effect there
+      SystShifts localShifts = shift;
+      std::unordered_map<const ISyst*, const ISyst*> fwdMap;
+      for(auto it: fSystCorrelations[n]){
+        // We're mapping prim -> sec
+        const ISyst* prim = it.first;
+        const ISyst* sec = it.second;
+        fwdMap[prim] = sec;
+        if(sec) localShifts.SetShift(sec, shift.GetShift(prim));
+        // We've either translated or discarded prim, so drop it here.
+        localShifts.SetShift(prim, 0);
+      }
+
+      std::vector<const ISyst*> localSysts;
+      std::vector<int> localIdx(S, -1);
+      for(unsigned int i = 0; i < S; ++i){
+        auto it = fwdMap.find(systs[i]);
+        const ISyst* s = (it == fwdMap.end()) ? systs[i] : it->second;
+        if(!s) continue;
+        auto found = std::find(localSysts.begin(), localSysts.end(), s);
+        localIdx[i] = found-localSysts.begin();
+        if(found == localSysts.end()) localSysts.push_back(s);
+      }
+
+      // None of our systs affect this one
+      if(localSysts.empty()) continue;
+
+      std::vector<double> hessLocal;
+      fExpts[n]->Hessian(calc, localShifts, localSysts, hessLocal);
+
+      // One of the components doesn't support second derivatives, don't
+      // bother asking the rest.
+      if(hessLocal.empty()){
+        hess.clear();
+        return;
+      }
+
+      // And translate back
+      const unsigned int L = localSysts.size();
+      for(unsigned int i = 0; i < S; ++i){
+        if(localIdx[i] < 0) continue;
+        for(unsigned int j = 0; j < S; ++j){
+          if(localIdx[j] < 0) continue;
+          hess[i*S+j] += hessLocal[localIdx[i]*L+localIdx[j]];
+        }
+      }
+    }
+  }
+
   //----------------------------------------------------------------------
   void MultiExperiment::
   SetSystCorrelations(int idx,
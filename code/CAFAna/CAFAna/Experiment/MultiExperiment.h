@@ -28,6 +28,15 @@ namespace ana
                             const SystShifts& shift,
                             std::unordered_map<const ISyst*, double>& dchi) const override;
 
+    virtual double ChiSqAndDerivative(osc::IOscCalculatorAdjustable* calc,
+                                      const SystShifts& shift,
+                                      std::unordered_map<const ISyst*, double>& dchi) const override;
+
+    virtual void Hessian(osc::IOscCalculator* calc,
+                         const SystShifts& shift,
+                         const std::vector<const ISyst*>& systs,
+                         std::vector<double>& hess) const override;
+
     /// For the subexperiment \a idx, set up a mapping between systematics
     ///
     /// Each element in the vector is a pair from a "primary" systematic to a
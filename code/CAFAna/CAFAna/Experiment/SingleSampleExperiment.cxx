@@ -118,6 +118,15 @@ namespace ana
 
     TH1D* hpred = pred.ToTH1(fData.POT());
 
+    AddCosmics(hpred, syst);
+
+    return hpred;
+  }
+
+  //----------------------------------------------------------------------
+  void SingleSampleExperiment::AddCosmics(TH1D* hpred,
+                                          const SystShifts& syst) const
+  {
     if(fCosmic){
       if(fCosmicScaleError != 0){
         const double scale = 1 + syst.GetShift(&kCosmicBkgScaleSyst) * fCosmicScaleError;
@@ -127,8 +136,6 @@ namespace ana
         hpred->Add(fCosmic);
       }
     }
-
-    return hpred;
   }
 
   //----------------------------------------------------------------------
@@ -138,6 +145,17 @@ namespace ana
     TH1D* hpred = PredHistIncCosmics(calc, syst);
     TH1D* hdata = fData.ToTH1(fData.POT());
 
+    const double ll = ChiSqFromHists(hpred, hdata);
+
+    HistCache::Delete(hpred);
+    HistCache::Delete(hdata);
+
+    return ll;
+  }
+
+  //----------------------------------------------------------------------
+  double SingleSampleExperiment::ChiSqFromHists(TH1D* hpred, TH1D* hdata) const
+  {
     double ll;
 
     // if there is a covariance matrix, use it
@@ -191,9 +209,6 @@ namespace ana
       ll = LogLikelihood(hpred, hdata);
     }
 
-    HistCache::Delete(hpred);
-    HistCache::Delete(hdata);
-
     return ll;
   }
 
@@ -234,6 +249,18 @@ namespace ana
     TH1D* hpred = PredHistIncCosmics(calc, shift);
     TH1D* hdata = fData.ToTH1(pot);
 
+    AddDerivative(hpred, hdata, dp, dchi);
+
+    HistCache::Delete(hpred);
+    HistCache::Delete(hdata);
+  }
+
+  //----------------------------------------------------------------------
+  void SingleSampleExperiment::
+  AddDerivative(const TH1D* hpred, const TH1D* hdata,
+                std::unordered_map<const ISyst*, std::vector<double>>& dp,
+                std::unordered_map<const ISyst*, double>& dchi) const
+  {
     for(auto& it: dchi){
       if(it.first != &kCosmicBkgScaleSyst){
         it.second += LogLikelihoodDerivative(hpred, hdata, dp[it.first]);
@@ -246,6 +273,141 @@ namespace ana
         it.second += LogLikelihoodDerivative(hpred, hdata, cosErr);
       }
     }
+  }
+
+  //----------------------------------------------------------------------
+  double SingleSampleExperiment::
+  ChiSqAndDerivative(osc::IOscCalculatorAdjustable* calc,
+                     const SystShifts& shift,
+                     std::unordered_map<const ISyst*, double>& dchi) const
+  {
+    const double pot = fData.POT();
+
+    SystShifts systNoCosmic = shift;
+    systNoCosmic.SetShift(&kCosmicBkgScaleSyst, 0);
+
+    // The cosmic derivative is ours to calculate, not the prediction's
+    std::unordered_map<const ISyst*, std::vector<double>> dp;
+    for(auto it: dchi) if(it.first != &kCosmicBkgScaleSyst) dp[it.first] = {};
+    const bool wantDerivs = !dp.empty();
+
+    // One pass for the prediction and its derivatives
+    const Spectrum pred = fMC->PredictSystAndDerivative(calc, systNoCosmic, pot, dp);
+
+    TH1D* hpred = pred.ToTH1(pot);
+    AddCosmics(hpred, shift);
+    TH1D* hdata = fData.ToTH1(pot);
+
+    if(wantDerivs && dp.empty()){ // prediction doesn't implement derivatives
+      dchi.clear(); // pass on that info to our caller
+    }
+    else{
+      // Before ChiSqFromHists() applies the mask
+      AddDerivative(hpred, hdata, dp, dchi);
+    }
+
+    const double ll = ChiSqFromHists(hpred, hdata);
+
+    HistCache::Delete(hpred);
+    HistCache::Delete(hdata);
+
+    return ll;
+  }
+
+  //----------------------------------------------------------------------
+  void SingleSampleExperiment::
+  Hessian(osc::IOscCalculator* calc,
+          const SystShifts& shift,
+          const std::vector<const ISyst*>& systs,
+          std::vector<double>& hess) const
+  {
+    // Only the Poisson likelihood is implemented
+    if(fCovMx){
+      hess.clear();
+      return;
+    }
+
+    const double pot = fData.POT();
+    const unsigned int S = systs.size();
+    if(hess.empty()) hess.assign(S*S, 0);
+    assert(hess.size() == S*S);
+
+    SystShifts systNoCosmic = shift;
+    systNoCosmic.SetShift(&kCosmicBkgScaleSyst, 0);
+
+    // The cosmic terms are ours to calculate, not the prediction's
+    std::vector<const ISyst*> predSysts;
+    std::unordered_map<const ISyst*, std::vector<double>> dp;
+    for(const ISyst* s: systs){
+      if(s == &kCosmicBkgScaleSyst) continue;
+      predSysts.push_back(s);
+      dp[s] = {};
+    }
+
+    const Spectrum pred = fMC->PredictSystAndDerivative(calc, systNoCosmic, pot, dp);
+
+    if(!predSysts.empty() && dp.empty()){ // prediction doesn't implement derivatives
+      hess.clear(); // pass on that info to our caller
+      return;
+    }
+
+    // Without second derivatives of the prediction we still have the
+    // Gauss-Newton approximation
+    std::vector<std::vector<double>> d2p;
+    if(!predSysts.empty()) fMC->SecondDerivative(calc, systNoCosmic, pot, predSysts, d2p);
+    const bool gaussNewton = d2p.empty();
+
+    TH1D* hpred = pred.ToTH1(pot);
+    AddCosmics(hpred, shift);
+    TH1D* hdata = fData.ToTH1(pot);
+
+    const unsigned int N = hpred->GetNbinsX()+2;
+    const double* ea = hpred->GetArray();
+    const double* oa = hdata->GetArray();
+
+    // First derivatives, in the order of systs, and where to find each
+    // syst's second derivatives in d2p
+    std::vector<const std::vector<double>*> dps(S);
+    std::vector<int> predIdx(S, -1);
+    std::vector<double> cosErr;
+    for(unsigned int i = 0, k = 0; i < S; ++i){
+      if(systs[i] == &kCosmicBkgScaleSyst){
+        if(cosErr.empty()){
+          cosErr.resize(N);
+          for(unsigned int n = 0; n < N; ++n){
+            cosErr[n] = fCosmic ? fCosmic->GetArray()[n]*fCosmicScaleError : 0;
+          }
+        }
+        dps[i] = &cosErr;
+      }
+      else{
+        dps[i] = &dp[systs[i]];
+        predIdx[i] = k++;
+      }
+    }
+
+    const unsigned int P = predSysts.size();
+
+    for(unsigned int n = 0; n < N; ++n){
+      if(fMask && fMask->GetBinContent(n) == 0) continue;
+
+      const double w1 = LogLikelihoodDerivative(ea[n], oa[n]);
+      const double w2 = LogLikelihoodSecondDerivative(ea[n], oa[n]);
+
+      for(unsigned int i = 0; i < S; ++i){
+        const double dpi = (*dps[i])[n];
+        for(unsigned int j = i; j < S; ++j){
+          double h = w2*dpi*(*dps[j])[n];
+          // The cosmic normalization is linear, so only the prediction's
+          // systs have curvature
+          if(!gaussNewton && predIdx[i] >= 0 && predIdx[j] >= 0){
+            h += w1*d2p[predIdx[i]*P+predIdx[j]][n];
+          }
+          hess[i*S+j] += h;
+          if(j != i) hess[j*S+i] += h;
+        }
+      }
+    } // end for n
 
     HistCache::Delete(hpred);
     HistCache::Delete(hdata);
@@ -69,6 +69,20 @@ namespace ana
                             const SystShifts& shift,
                             std::unordered_map<const ISyst*, double>& dch) const override;
 
+    /// Makes one call to \ref IPrediction::PredictSystAndDerivative
+    virtual double ChiSqAndDerivative(osc::IOscCalculatorAdjustable* calc,
+                                      const SystShifts& shift,
+                                      std::unordered_map<const ISyst*, double>& dchi) const override;
+
+    /// \brief Exact when the prediction implements \ref
+    /// IPrediction::SecondDerivative, Gauss-Newton otherwise
+    ///
+    /// Not implemented for fits with a covariance matrix
+    virtual void Hessian(osc::IOscCalculator* calc,
+                         const SystShifts& shift,
+                         const std::vector<const ISyst*>& systs,
+                         std::vector<double>& hess) const override;
+
     virtual void SaveTo(TDirectory* dir) const override;
     static std::unique_ptr<SingleSampleExperiment> LoadFrom(TDirectory* dir);
 
@@ -96,6 +110,17 @@ namespace ana
     TH1D* PredHistIncCosmics(osc::IOscCalculator* calc,
                              const SystShifts& syst) const;
 
+    void AddCosmics(TH1D* hpred, const SystShifts& syst) const;
+
+    /// Applies the mask to \a hpred and \a hdata, if there is one
+    double ChiSqFromHists(TH1D* hpred, TH1D* hdata) const;
+
+    /// Convert the derivatives of the prediction \a dp into the derivatives
+    /// of the chisq, adding them into \a dchi
+    void AddDerivative(const TH1D* hpred, const TH1D* hdata,
+                       std::unordered_map<const ISyst*, std::vector<double>>& dp,
+                       std::unordered_map<const ISyst*, double>& dchi) const;
+
     const IPrediction* fMC;
     Spectrum fData;
     TH1D* fCosmic;
@@ -27,6 +27,36 @@ namespace ana
     abort();
   }
 
+  //----------------------------------------------------------------------
+  void IExtrap::AddOscillatedCCTo(osc::IOscCalculator* calc,
+                                  int from, int to,
+                                  double pot, double* arr)
+  {
+    if(from == +12 && to == +12) NueSurvComponent()      .AddOscillatedTo(calc, from, to, pot, arr);
+    if(from == -12 && to == -12) AntiNueSurvComponent()  .AddOscillatedTo(calc, from, to, pot, arr);
+
+    if(from == +12 && to == +14) NumuAppComponent()      .AddOscillatedTo(calc, from, to, pot, arr);
+    if(from == -12 && to == -14) AntiNumuAppComponent()  .AddOscillatedTo(calc, from, to, pot, arr);
+
+    if(from == +12 && to == +16) TauFromEComponent()     .AddOscillatedTo(calc, from, to, pot, arr);
+    if(from == -12 && to == -16) AntiTauFromEComponent() .AddOscillatedTo(calc, from, to, pot, arr);
+
+    if(from == +14 && to == +12) NueAppComponent()       .AddOscillatedTo(calc, from, to, pot, arr);
+    if(from == -14 && to == -12) AntiNueAppComponent()   .AddOscillatedTo(calc, from, to, pot, arr);
+
+    if(from == +14 && to == +14) NumuSurvComponent()     .AddOscillatedTo(calc, from, to, pot, arr);
+    if(from == -14 && to == -14) AntiNumuSurvComponent() .AddOscillatedTo(calc, from, to, pot, arr);
+
+    if(from == +14 && to == +16) TauFromMuComponent()    .AddOscillatedTo(calc, from, to, pot, arr);
+    if(from == -14 && to == -16) AntiTauFromMuComponent().AddOscillatedTo(calc, from, to, pot, arr);
+  }
+
+  //----------------------------------------------------------------------
+  void IExtrap::AddNCTo(double pot, double* arr)
+  {
+    NCComponent().AddTo(pot, arr);
+  }
+
   //----------------------------------------------------------------------
   void IExtrap::SaveTo(TDirectory* dir) const
   {
@@ -2,6 +2,8 @@
 
 #include "CAFAna/Core/OscillatableSpectrum.h"
 
+namespace osc{class IOscCalculator;}
+
 namespace ana
 {
   /// Interface to extrapolation procedures
@@ -43,6 +45,28 @@ namespace ana
     /// Neutral currents
     virtual Spectrum NCComponent() = 0;
 
+    /// \brief Add the charged current component \a from -> \a to,
+    /// oscillated and scaled to \a pot, into \a arr
+    ///
+    /// \a arr has the layout of TH1::GetArray() for the reco binning. The
+    /// default implementation goes via the accessors above, which return
+    /// copies. Override to work from the stored components directly.
+    virtual void AddOscillatedCCTo(osc::IOscCalculator* calc,
+                                   int from, int to,
+                                   double pot, double* arr);
+
+    /// \brief The charged current component \a from -> \a to as stored, so
+    /// that it can be used in place rather than copied
+    ///
+    /// Null if the components aren't stored as such, which is the default
+    virtual const OscillatableSpectrum* StoredCCComponent(int from, int to)
+    {
+      return 0;
+    }
+
+    /// Add the neutral current component, scaled to \a pot, into \a arr
+    virtual void AddNCTo(double pot, double* arr);
+
     virtual void SaveTo(TDirectory* dir) const;
   };
 }
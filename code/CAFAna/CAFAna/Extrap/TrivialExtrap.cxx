@@ -16,28 +16,41 @@ namespace ana
                                const HistAxis& axis,
                                const Cut& cut,
                                const SystShifts& shift,
-                               const Var& wei)
+                               const Var& wei,
+                               const Binning& trueBins,
+                               bool trimTrueBins)
     :
-    fNueApp       (loaderNue,     axis, cut && kIsSig       && !kIsAntiNu, shift, wei),
-    fNueAppAnti   (loaderNue,     axis, cut && kIsSig       &&  kIsAntiNu, shift, wei),
+    fNueApp       (loaderNue,     axis, cut && kIsSig       && !kIsAntiNu, shift, wei, trueBins),
+    fNueAppAnti   (loaderNue,     axis, cut && kIsSig       &&  kIsAntiNu, shift, wei, trueBins),
 
-    fNumuSurv     (loaderNonswap, axis, cut && kIsNumuCC    && !kIsAntiNu, shift, wei),
-    fNumuSurvAnti (loaderNonswap, axis, cut && kIsNumuCC    &&  kIsAntiNu, shift, wei),
+    fNumuSurv     (loaderNonswap, axis, cut && kIsNumuCC    && !kIsAntiNu, shift, wei, trueBins),
+    fNumuSurvAnti (loaderNonswap, axis, cut && kIsNumuCC    &&  kIsAntiNu, shift, wei, trueBins),
 
-    fNumuApp      (loaderNuTau,   axis, cut && kIsNumuApp   && !kIsAntiNu, shift, wei),
-    fNumuAppAnti  (loaderNuTau,   axis, cut && kIsNumuApp   &&  kIsAntiNu, shift, wei),
+    fNumuApp      (loaderNuTau,   axis, cut && kIsNumuApp   && !kIsAntiNu, shift, wei, trueBins),
+    fNumuAppAnti  (loaderNuTau,   axis, cut && kIsNumuApp   &&  kIsAntiNu, shift, wei, trueBins),
 
-    fNueSurv      (loaderNonswap, axis, cut && kIsBeamNue   && !kIsAntiNu, shift, wei),
-    fNueSurvAnti  (loaderNonswap, axis, cut && kIsBeamNue   &&  kIsAntiNu, shift, wei),
+    fNueSurv      (loaderNonswap, axis, cut && kIsBeamNue   && !kIsAntiNu, shift, wei, trueBins),
+    fNueSurvAnti  (loaderNonswap, axis, cut && kIsBeamNue   &&  kIsAntiNu, shift, wei, trueBins),
 
-    fTauFromE     (loaderNue,     axis, cut && kIsTauFromE  && !kIsAntiNu, shift, wei),
-    fTauFromEAnti (loaderNue,     axis, cut && kIsTauFromE  &&  kIsAntiNu, shift, wei),
+    fTauFromE     (loaderNue,     axis, cut && kIsTauFromE  && !kIsAntiNu, shift, wei, trueBins),
+    fTauFromEAnti (loaderNue,     axis, cut && kIsTauFromE  &&  kIsAntiNu, shift, wei, trueBins),
 
-    fTauFromMu    (loaderNuTau,   axis, cut && kIsTauFromMu && !kIsAntiNu, shift, wei),
-    fTauFromMuAnti(loaderNuTau,   axis, cut && kIsTauFromMu &&  kIsAntiNu, shift, wei),
+    fTauFromMu    (loaderNuTau,   axis, cut && kIsTauFromMu && !kIsAntiNu, shift, wei, trueBins),
+    fTauFromMuAnti(loaderNuTau,   axis, cut && kIsTauFromMu &&  kIsAntiNu, shift, wei, trueBins),
 
     fNC           (loaderNonswap, axis, cut && kIsNC,                      shift, wei)
   {
+    if(trimTrueBins){
+      for(OscillatableSpectrum* s: {&fNueApp,    &fNueAppAnti,
+                                    &fNumuSurv,  &fNumuSurvAnti,
+                                    &fNumuApp,   &fNumuAppAnti,
+                                    &fNueSurv,   &fNueSurvAnti,
+                                    &fTauFromE,  &fTauFromEAnti,
+                                    &fTauFromMu, &fTauFromMuAnti}){
+        s->SetTrimTrueBins(true);
+      }
+    }
+
     // All swapped files are equally valid as a source of NCs. This
     // approximately doubles/triples our statistics. SpectrumLoader just adds
     // events and POT for both cases, which is the right thing to do.
@@ -80,12 +93,50 @@ namespace ana
                                const HistAxis& axis,
                                const Cut& cut,
                                const SystShifts& shift,
-                               const Var& wei)
+                               const Var& wei,
+                               const Binning& trueBins,
+                               bool trimTrueBins)
     : TrivialExtrap(loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNonSwap),
                     loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNueSwap),
                     loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNuTauSwap),
-                    axis, cut, shift, wei)
+                    axis, cut, shift, wei, trueBins, trimTrueBins)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  const OscillatableSpectrum* TrivialExtrap::StoredCCComponent(int from, int to)
   {
+    if(from == +12 && to == +12) return &fNueSurv;
+    if(from == -12 && to == -12) return &fNueSurvAnti;
+
+    if(from == +12 && to == +14) return &fNumuApp;
+    if(from == -12 && to == -14) return &fNumuAppAnti;
+
+    if(from == +12 && to == +16) return &fTauFromE;
+    if(from == -12 && to == -16) return &fTauFromEAnti;
+
+    if(from == +14 && to == +12) return &fNueApp;
+    if(from == -14 && to == -12) return &fNueAppAnti;
+
+    if(from == +14 && to == +14) return &fNumuSurv;
+    if(from == -14 && to == -14) return &fNumuSurvAnti;
+
+    if(from == +14 && to == +16) return &fTauFromMu;
+    if(from == -14 && to == -16) return &fTauFromMuAnti;
+
+    return 0;
+  }
+
+  //----------------------------------------------------------------------
+  void TrivialExtrap::AddOscillatedCCTo(osc::IOscCalculator* calc,
+                                        int from, int to,
+                                        double pot, double* arr)
+  {
+    const OscillatableSpectrum* s = StoredCCComponent(from, to);
+
+    assert(s && "Unknown oscillation channel");
+
+    s->AddOscillatedTo(calc, from, to, pot, arr);
   }
 
   //----------------------------------------------------------------------
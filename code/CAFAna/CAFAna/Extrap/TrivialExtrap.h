@@ -11,13 +11,19 @@ namespace ana
   {
   public:
     // This is the DUNE constructor
+    /// \a trueBins sets the true energy axis of the oscillatable
+    /// components. If \a trimTrueBins is set, empty true energy rows are
+    /// dropped once the loaders have run (see
+    /// OscillatableSpectrum::TrimTrueBins).
     TrivialExtrap(SpectrumLoaderBase& loaderNonswap,
                   SpectrumLoaderBase& loaderNue,
                   SpectrumLoaderBase& loaderNuTau,
                   const HistAxis& axis,
                   const Cut& cut,
                   const SystShifts& shift,
-                  const Var& wei);
+                  const Var& wei,
+                  const Binning& trueBins = kTrueEnergyBins,
+                  bool trimTrueBins = false);
 
     TrivialExtrap(SpectrumLoaderBase& loaderNonswap,
                   SpectrumLoaderBase& loaderNue,
@@ -41,7 +47,9 @@ namespace ana
                   const HistAxis& axis,
                   const Cut& cut,
                   const SystShifts& shift = kNoShift,
-                  const Var& wei = kUnweighted);
+                  const Var& wei = kUnweighted,
+                  const Binning& trueBins = kTrueEnergyBins,
+                  bool trimTrueBins = false);
 
     virtual OscillatableSpectrum NueSurvComponent()       {return fNueSurv;}
     virtual OscillatableSpectrum AntiNueSurvComponent()   {return fNueSurvAnti;}
@@ -63,6 +71,15 @@ namespace ana
 
     virtual Spectrum NCComponent() {return fNC;}
 
+    virtual void AddOscillatedCCTo(osc::IOscCalculator* calc,
+                                   int from, int to,
+                                   double pot, double* arr) override;
+    virtual const OscillatableSpectrum* StoredCCComponent(int from, int to) override;
+    virtual void AddNCTo(double pot, double* arr) override
+    {
+      fNC.AddTo(pot, arr);
+    }
+
     virtual void SaveTo(TDirectory* dir) const;
     static std::unique_ptr<TrivialExtrap> LoadFrom(TDirectory* dir);
 
@@ -1,6 +1,7 @@
 #include "CAFAna/Prediction/IPrediction.h"
 
 #include "CAFAna/Core/LoadFromFile.h"
+#include "CAFAna/Core/SystShifts.h"
 
 #include "OscLib/func/IOscCalculator.h"
 
@@ -11,8 +12,10 @@
 #include "TObjString.h"
 
 // To implement LoadFrom()
+#include "CAFAna/Prediction/PredictionEventList.h"
 #include "CAFAna/Prediction/PredictionNoExtrap.h"
 #include "CAFAna/Prediction/PredictionInterp.h"
+#include "CAFAna/Prediction/PredictionMigration.h"
 #include "CAFAna/Prediction/PredictionNoOsc.h"
 #include "CAFAna/Prediction/PredictionScaleComp.h"
 #include "CAFAna/Prediction/PredictionNuOnE.h"
@@ -40,6 +43,9 @@ namespace ana
 
     if(tag == "PredictionNuOnE") return PredictionNuOnE::LoadFrom(dir);
 
+    if(tag == "PredictionEventList") return PredictionEventList::LoadFrom(dir);
+    if(tag == "PredictionMigration") return PredictionMigration::LoadFrom(dir);
+
     std::cerr << "Unknown Prediction type '" << tag << "'" << std::endl;
     abort();
   }
@@ -62,6 +68,31 @@ namespace ana
     return Predict(calc);
   }
 
+  //----------------------------------------------------------------------
+  std::vector<Spectrum> IPrediction::
+  PredictSystBatch(const std::vector<PredictionPoint>& points) const
+  {
+    // Default implementation: one at a time
+    std::vector<Spectrum> ret;
+    ret.reserve(points.size());
+    for(const PredictionPoint& p: points){
+      ret.push_back(PredictSyst(p.calc, p.shift ? *p.shift : kNoShift));
+    }
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum IPrediction::
+  PredictSystAndDerivative(osc::IOscCalculator* calc,
+                           const SystShifts& shift,
+                           double pot,
+                           std::unordered_map<const ISyst*, std::vector<double>>& dp) const
+  {
+    // Default implementation: two separate passes
+    Derivative(calc, shift, pot, dp);
+    return PredictSyst(calc, shift);
+  }
+
   //----------------------------------------------------------------------
   Spectrum IPrediction::PredictComponentSyst(osc::IOscCalculator* calc,
                                              const SystShifts& syst,
@@ -75,6 +106,35 @@ namespace ana
     return PredictComponent(calc, flav, curr, sign);
   }
 
+  //----------------------------------------------------------------------
+  void IPrediction::AddComponentTo(osc::IOscCalculator* calc,
+                                   Flavors::Flavors_t flav,
+                                   Current::Current_t curr,
+                                   Sign::Sign_t sign,
+                                   double pot,
+                                   double* arr) const
+  {
+    // Default implementation
+    PredictComponent(calc, flav, curr, sign).AddTo(pot, arr);
+  }
+
+  //----------------------------------------------------------------------
+  void IPrediction::AddComponentSystTo(osc::IOscCalculator* calc,
+                                       const SystShifts& syst,
+                                       Flavors::Flavors_t flav,
+                                       Current::Current_t curr,
+                                       Sign::Sign_t sign,
+                                       double pot,
+                                       double* arr) const
+  {
+    // Default implementation. Predictions that only know how to accumulate
+    // nominal components still get to do so.
+    if(syst.IsNominal())
+      AddComponentTo(calc, flav, curr, sign, pot, arr);
+    else
+      PredictComponentSyst(calc, syst, flav, curr, sign).AddTo(pot, arr);
+  }
+
   //----------------------------------------------------------------------
   void IPrediction::SaveTo(TDirectory* dir) const
   {
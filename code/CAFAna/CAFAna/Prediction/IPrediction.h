@@ -56,6 +56,13 @@ namespace ana
 
   class SystShifts;
 
+  /// One point in parameter space for \ref IPrediction::PredictSystBatch
+  struct PredictionPoint
+  {
+    osc::IOscCalculator* calc;
+    const SystShifts* shift; ///< Null for no shifts
+  };
+
   /// Standard interface to all prediction techniques
   class IPrediction
   {
@@ -66,6 +73,14 @@ namespace ana
     virtual Spectrum PredictSyst(osc::IOscCalculator* calc,
                                  const SystShifts& syst) const;
 
+    /// \brief Predict many points at once
+    ///
+    /// Equivalent to calling \ref PredictSyst for each of \a points in turn,
+    /// but implementations may share work between the points, eg when
+    /// several of them have the same oscillation parameters.
+    virtual std::vector<Spectrum>
+    PredictSystBatch(const std::vector<PredictionPoint>& points) const;
+
     virtual Spectrum PredictComponent(osc::IOscCalculator* calc,
                                       Flavors::Flavors_t flav,
                                       Current::Current_t curr,
@@ -76,6 +91,27 @@ namespace ana
                                           Current::Current_t curr,
                                           Sign::Sign_t sign) const;
 
+    /// \brief Add a component of the prediction, scaled to \a pot, into \a arr
+    ///
+    /// \a arr has the layout of TH1::GetArray() for the binning of this
+    /// prediction, ie NBins+2 entries including underflow and overflow. This
+    /// saves constructing and summing intermediate Spectrum objects. The
+    /// default implementation falls back to \ref PredictComponent.
+    virtual void AddComponentTo(osc::IOscCalculator* calc,
+                                Flavors::Flavors_t flav,
+                                Current::Current_t curr,
+                                Sign::Sign_t sign,
+                                double pot,
+                                double* arr) const;
+    /// As \ref AddComponentTo, but with systematic shifts applied
+    virtual void AddComponentSystTo(osc::IOscCalculator* calc,
+                                    const SystShifts& syst,
+                                    Flavors::Flavors_t flav,
+                                    Current::Current_t curr,
+                                    Sign::Sign_t sign,
+                                    double pot,
+                                    double* arr) const;
+
     virtual void Derivative(osc::IOscCalculator* calc,
                             const SystShifts& shift,
                             double pot,
@@ -87,6 +123,31 @@ namespace ana
       dchi.clear();
     }
 
+    /// \brief The prediction and its derivatives, from one call
+    ///
+    /// Returns the same as \ref PredictSyst and fills \a dp as \ref
+    /// Derivative does. Implementations can share the work between the two,
+    /// which is worthwhile for gradient-based fits that always need both. The
+    /// default implementation simply calls them one after the other.
+    virtual Spectrum PredictSystAndDerivative(osc::IOscCalculator* calc,
+                                              const SystShifts& shift,
+                                              double pot,
+                                              std::unordered_map<const ISyst*, std::vector<double>>& dp) const;
+
+    /// \brief Second derivatives of the prediction with respect to \a systs
+    ///
+    /// Fills \a d2p with one vector of bin contents per pair of systematics,
+    /// the entry for (i, j) being at index i*systs.size()+j. Optional to
+    /// implement, the default leaves \a d2p empty to signal no result.
+    virtual void SecondDerivative(osc::IOscCalculator* calc,
+                                  const SystShifts& shift,
+                                  double pot,
+                                  const std::vector<const ISyst*>& systs,
+                                  std::vector<std::vector<double>>& d2p) const
+    {
+      d2p.clear();
+    }
+
     virtual OscillatableSpectrum ComponentCC(int from, int to) const
     {std::cout << "OscillatableSpectrum::ComponentCC() unimplemented" << std::endl; abort();}
     virtual Spectrum ComponentNC() const
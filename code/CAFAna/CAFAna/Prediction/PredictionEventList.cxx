@@ -0,0 +1,274 @@
+#include "CAFAna/Prediction/PredictionEventList.h"
+
+#include "CAFAna/Core/HistCache.h"
+#include "CAFAna/Core/ISyst.h"
+#include "CAFAna/Core/Loaders.h"
+#include "CAFAna/Core/Utilities.h"
+#include "CAFAna/Cuts/TruthCuts.h"
+
+#include "OscLib/func/IOscCalculator.h"
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TObjString.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace ana
+{
+  //----------------------------------------------------------------------
+  PredictionEventList::PredictionEventList(SpectrumLoaderBase& loaderNonswap,
+                                           SpectrumLoaderBase& loaderNue,
+                                           SpectrumLoaderBase& loaderNuTau,
+                                           const HistAxis& axis,
+                                           const Cut& cut,
+                                           const std::vector<const ISyst*>& systs,
+                                           const SystShifts& shift,
+                                           const Var& wei,
+                                           const Binning& trueBins)
+  {
+    // Take the same channels from each file as TrivialExtrap. All of them are
+    // valid sources of NCs.
+    fNonswap = std::make_unique<EventList>(loaderNonswap, axis,
+                                           cut && (kIsNumuCC || kIsBeamNue || kIsNC),
+                                           systs, shift, wei, trueBins);
+    fNue = std::make_unique<EventList>(loaderNue, axis,
+                                       cut && (kIsSig || kIsTauFromE || kIsNC),
+                                       systs, shift, wei, trueBins);
+    fNuTau = std::make_unique<EventList>(loaderNuTau, axis,
+                                         cut && (kIsNumuApp || kIsTauFromMu || kIsNC),
+                                         systs, shift, wei, trueBins);
+  }
+
+  //----------------------------------------------------------------------
+  PredictionEventList::PredictionEventList(Loaders& loaders,
+                                           const HistAxis& axis,
+                                           const Cut& cut,
+                                           const std::vector<const ISyst*>& systs,
+                                           const SystShifts& shift,
+                                           const Var& wei,
+                                           const Binning& trueBins)
+    : PredictionEventList(loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNonSwap),
+                          loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNueSwap),
+                          loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNuTauSwap),
+                          axis, cut, systs, shift, wei, trueBins)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  PredictionEventList::PredictionEventList(std::unique_ptr<EventList> nonswap,
+                                           std::unique_ptr<EventList> nue,
+                                           std::unique_ptr<EventList> nutau)
+    : fNonswap(std::move(nonswap)), fNue(std::move(nue)), fNuTau(std::move(nutau))
+  {
+  }
+
+  //----------------------------------------------------------------------
+  PredictionEventList::~PredictionEventList()
+  {
+  }
+
+  //----------------------------------------------------------------------
+  double PredictionEventList::RefPOT() const
+  {
+    return fNonswap->POT() > 0 ? fNonswap->POT() : 1e24;
+  }
+
+  //----------------------------------------------------------------------
+  std::shared_ptr<const OscCurveSet> PredictionEventList::
+  OscProbs(osc::IOscCalculator* calc) const
+  {
+    const Binning& bins = fNonswap->TrueBinning();
+    std::shared_ptr<const OscCurveSet> ret = OscCurveSet::Get(calc, bins);
+    if(!ret) ret = std::make_shared<const OscCurveSet>(calc, bins);
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionEventList::Predict(osc::IOscCalculator* calc) const
+  {
+    return PredictComponentSyst(calc, kNoShift,
+                                Flavors::kAll, Current::kBoth, Sign::kBoth);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionEventList::PredictSyst(osc::IOscCalculator* calc,
+                                            const SystShifts& shift) const
+  {
+    return PredictComponentSyst(calc, shift,
+                                Flavors::kAll, Current::kBoth, Sign::kBoth);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionEventList::PredictComponent(osc::IOscCalculator* calc,
+                                                 Flavors::Flavors_t flav,
+                                                 Current::Current_t curr,
+                                                 Sign::Sign_t sign) const
+  {
+    return PredictComponentSyst(calc, kNoShift, flav, curr, sign);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionEventList::PredictComponentSyst(osc::IOscCalculator* calc,
+                                                     const SystShifts& shift,
+                                                     Flavors::Flavors_t flav,
+                                                     Current::Current_t curr,
+                                                     Sign::Sign_t sign) const
+  {
+    DontAddDirectory guard;
+
+    const double pot = RefPOT();
+
+    TH1D* h = HistCache::New("", fNonswap->GetBinning());
+    AddComponentSystTo(calc, shift, flav, curr, sign, pot, h->GetArray());
+
+    return Spectrum(std::unique_ptr<TH1D>(h),
+                    {fNonswap->GetLabel()}, {fNonswap->GetBinning()},
+                    pot, 0);
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionEventList::AddComponentTo(osc::IOscCalculator* calc,
+                                           Flavors::Flavors_t flav,
+                                           Current::Current_t curr,
+                                           Sign::Sign_t sign,
+                                           double pot,
+                                           double* arr) const
+  {
+    AddComponentSystTo(calc, kNoShift, flav, curr, sign, pot, arr);
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionEventList::AddComponentSystTo(osc::IOscCalculator* calc,
+                                               const SystShifts& shift,
+                                               Flavors::Flavors_t flav,
+                                               Current::Current_t curr,
+                                               Sign::Sign_t sign,
+                                               double pot,
+                                               double* arr) const
+  {
+    if(curr & Current::kNC){
+      assert(flav == Flavors::kAll); // Don't know how to calculate anything else
+      assert(sign == Sign::kBoth);   // Why would you want to split NCs out by sign?
+    }
+
+    std::shared_ptr<const OscCurveSet> probs;
+    if(curr & Current::kCC) probs = OscProbs(calc);
+
+    std::vector<double> chanWeights;
+
+    for(const EventList* el: {fNonswap.get(), fNue.get(), fNuTau.get()}){
+      // eg from NullLoader
+      if(el->POT() <= 0) continue;
+
+      ChannelWeights(*el, probs.get(), flav, curr, sign, pot, chanWeights);
+      el->AddTo(chanWeights.data(), shift, arr);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionEventList::ChannelWeights(const EventList& el,
+                                           const OscCurveSet* probs,
+                                           Flavors::Flavors_t flav,
+                                           Current::Current_t curr,
+                                           Sign::Sign_t sign,
+                                           double pot,
+                                           std::vector<double>& chanWeights) const
+  {
+    const unsigned int nTrue = el.TrueBinning().NBins()+2;
+
+    chanWeights.assign(EventList::kNChannels*nTrue, 0);
+
+    if(curr & Current::kCC){
+      for(int chan = 0; chan < EventList::kNCChannels; ++chan){
+        // Channels are numbered in the same order as Flavors_t
+        if(!(flav & (1 << (chan%6)))) continue;
+        if(!(sign & (EventList::ChannelFrom(chan) > 0 ? Sign::kNu : Sign::kAntiNu))) continue;
+
+        const double* P = probs->P(EventList::ChannelFrom(chan),
+                                   EventList::ChannelTo(chan));
+        for(unsigned int i = 0; i < nTrue; ++i)
+          chanWeights[chan*nTrue+i] = P[i]*pot/el.POT();
+      }
+    }
+
+    if(curr & Current::kNC){
+      // As for TrivialExtrap, NCs are normalised to the POT of all three files
+      const double potNC = fNonswap->POT() + fNue->POT() + fNuTau->POT();
+      for(unsigned int i = 0; i < nTrue; ++i)
+        chanWeights[EventList::kNCChannel*nTrue+i] = pot/potNC;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  std::vector<double> PredictionEventList::Migrations(osc::IOscCalculator* calc,
+                                                      const ISyst* syst,
+                                                      const int* chanComps,
+                                                      unsigned int nComps,
+                                                      int& x0,
+                                                      unsigned int& nKnots) const
+  {
+    if(!fNonswap->SystKnots(syst, x0, nKnots)){
+      std::cout << "PredictionEventList: syst " << syst->ShortName()
+                << " wasn't evaluated when the events were loaded" << std::endl;
+      abort();
+    }
+
+    const unsigned int N = fNonswap->GetBinning().NBins()+2;
+    std::vector<double> ret(nComps*nKnots*N*N);
+
+    const std::shared_ptr<const OscCurveSet> probs = OscProbs(calc);
+    const double pot = RefPOT();
+
+    std::vector<double> chanWeights;
+
+    for(const EventList* el: {fNonswap.get(), fNue.get(), fNuTau.get()}){
+      if(el->POT() <= 0) continue;
+
+      ChannelWeights(*el, probs.get(), Flavors::kAll, Current::kBoth, Sign::kBoth,
+                     pot, chanWeights);
+      el->AddMigrationsTo(syst, chanWeights.data(), chanComps, ret.data());
+    }
+
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionEventList::SaveTo(TDirectory* dir) const
+  {
+    TDirectory* tmp = gDirectory;
+
+    dir->cd();
+    TObjString("PredictionEventList").Write("type");
+
+    fNonswap->SaveTo(dir->mkdir("nonswap"));
+    fNue->SaveTo(dir->mkdir("nue"));
+    fNuTau->SaveTo(dir->mkdir("nutau"));
+
+    tmp->cd();
+  }
+
+  //----------------------------------------------------------------------
+  std::unique_ptr<PredictionEventList> PredictionEventList::LoadFrom(TDirectory* dir)
+  {
+    TObjString* tag = (TObjString*)dir->Get("type");
+    assert(tag);
+    assert(tag->GetString() == "PredictionEventList");
+    delete tag;
+
+    std::unique_ptr<EventList> lists[3];
+    const char* names[3] = {"nonswap", "nue", "nutau"};
+    for(int i = 0; i < 3; ++i){
+      TDirectory* subdir = dir->GetDirectory(names[i]);
+      assert(subdir);
+      lists[i] = EventList::LoadFrom(subdir);
+      delete subdir;
+    }
+
+    return std::unique_ptr<PredictionEventList>(new PredictionEventList(std::move(lists[0]),
+                                                                        std::move(lists[1]),
+                                                                        std::move(lists[2])));
+  }
+}
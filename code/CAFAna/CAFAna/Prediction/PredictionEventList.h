@@ -0,0 +1,157 @@
+#pragma once
+
+#include "CAFAna/Prediction/IPrediction.h"
+#include "CAFAna/Prediction/PredictionGenerator.h"
+
+#include "CAFAna/Core/EventList.h"
+#include "CAFAna/Core/OscCurve.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ana
+{
+  class Loaders;
+
+  /// \brief Prediction that reweights the selected FD MC events directly
+  ///
+  /// Instead of histogram templates per systematic shift, keeps the events
+  /// themselves, in an \ref EventList for each of the three swap files, with
+  /// their responses to all the \a systs. Oscillation weights are looked up
+  /// per channel and true energy bin, and systematic weights interpolated
+  /// per event, so there's no binning of the systematic response in the
+  /// reconstructed variable. Normalisation follows \ref TrivialExtrap: CC
+  /// channels come from their own swap file, NCs from all three.
+  ///
+  /// Costs time proportional to the number of events, rather than bins,
+  /// for each prediction, so best suited to studies where the templates'
+  /// approximations are in question, and not to large fits.
+  class PredictionEventList: public IPrediction
+  {
+  public:
+    PredictionEventList(SpectrumLoaderBase& loaderNonswap,
+                        SpectrumLoaderBase& loaderNue,
+                        SpectrumLoaderBase& loaderNuTau,
+                        const HistAxis& axis,
+                        const Cut& cut,
+                        const std::vector<const ISyst*>& systs,
+                        const SystShifts& shift = kNoShift,
+                        const Var& wei = kUnweighted,
+                        const Binning& trueBins = kTrueEnergyBins);
+
+    PredictionEventList(Loaders& loaders,
+                        const HistAxis& axis,
+                        const Cut& cut,
+                        const std::vector<const ISyst*>& systs,
+                        const SystShifts& shift = kNoShift,
+                        const Var& wei = kUnweighted,
+                        const Binning& trueBins = kTrueEnergyBins);
+
+    virtual ~PredictionEventList();
+
+    virtual Spectrum Predict(osc::IOscCalculator* calc) const override;
+    virtual Spectrum PredictSyst(osc::IOscCalculator* calc,
+                                 const SystShifts& shift) const override;
+
+    virtual Spectrum PredictComponent(osc::IOscCalculator* calc,
+                                      Flavors::Flavors_t flav,
+                                      Current::Current_t curr,
+                                      Sign::Sign_t sign) const override;
+    virtual Spectrum PredictComponentSyst(osc::IOscCalculator* calc,
+                                          const SystShifts& shift,
+                                          Flavors::Flavors_t flav,
+                                          Current::Current_t curr,
+                                          Sign::Sign_t sign) const override;
+
+    virtual void AddComponentTo(osc::IOscCalculator* calc,
+                                Flavors::Flavors_t flav,
+                                Current::Current_t curr,
+                                Sign::Sign_t sign,
+                                double pot,
+                                double* arr) const override;
+    virtual void AddComponentSystTo(osc::IOscCalculator* calc,
+                                    const SystShifts& shift,
+                                    Flavors::Flavors_t flav,
+                                    Current::Current_t curr,
+                                    Sign::Sign_t sign,
+                                    double pot,
+                                    double* arr) const override;
+
+    std::vector<const ISyst*> GetAllSysts() const {return fNonswap->GetAllSysts();}
+
+    /// \brief Migration matrices describing \a syst at each of its knots,
+    /// for the events oscillated by \a calc
+    ///
+    /// Sums \ref EventList::AddMigrationsTo over the three files, normalised
+    /// as the predictions are
+    ///
+    /// \param nComps Number of components \a chanComps maps onto
+    /// \param x0     Set to the first knot
+    /// \param nKnots Set to the number of knots
+    std::vector<double> Migrations(osc::IOscCalculator* calc,
+                                   const ISyst* syst,
+                                   const int* chanComps,
+                                   unsigned int nComps,
+                                   int& x0,
+                                   unsigned int& nKnots) const;
+
+    virtual void SaveTo(TDirectory* dir) const override;
+    static std::unique_ptr<PredictionEventList> LoadFrom(TDirectory* dir);
+
+  protected:
+    /// Constructor for LoadFrom
+    PredictionEventList(std::unique_ptr<EventList> nonswap,
+                        std::unique_ptr<EventList> nue,
+                        std::unique_ptr<EventList> nutau);
+
+    /// Oscillation probabilities in the true binning, shared where possible
+    std::shared_ptr<const OscCurveSet> OscProbs(osc::IOscCalculator* calc) const;
+
+    /// POT the full prediction is normalised to
+    double RefPOT() const;
+
+    /// \brief Weights for \a el's events, for \ref EventList::AddTo, of the
+    /// requested channels oscillated with \a probs and scaled to \a pot
+    void ChannelWeights(const EventList& el,
+                        const OscCurveSet* probs,
+                        Flavors::Flavors_t flav,
+                        Current::Current_t curr,
+                        Sign::Sign_t sign,
+                        double pot,
+                        std::vector<double>& chanWeights) const;
+
+    // Heap-allocated because the loaders hold on to their addresses
+    std::unique_ptr<EventList> fNonswap, fNue, fNuTau;
+  };
+
+  //---------------------------------------------------------------------------
+
+  /// Generates \ref PredictionEventList
+  class EventListPredictionGenerator: public IPredictionGenerator
+  {
+  public:
+    EventListPredictionGenerator(const HistAxis& axis,
+                                 const Cut& cut,
+                                 const std::vector<const ISyst*>& systs,
+                                 const Var& wei = kUnweighted,
+                                 const Binning& trueBins = kTrueEnergyBins)
+      : fAxis(axis), fCut(cut), fSysts(systs), fWei(wei), fTrueBins(trueBins)
+    {
+    }
+
+    virtual std::unique_ptr<IPrediction>
+    Generate(Loaders& loaders, const SystShifts& shiftMC = kNoShift) const override
+    {
+      return std::make_unique<PredictionEventList>(loaders, fAxis, fCut, fSysts,
+                                                   shiftMC, fWei, fTrueBins);
+    }
+
+  protected:
+    HistAxis fAxis;
+    Cut fCut;
+    std::vector<const ISyst*> fSysts;
+    Var fWei;
+    Binning fTrueBins;
+  };
+}
@@ -1,7 +1,9 @@
 #include "CAFAna/Prediction/PredictionExtrap.h"
 
 #include "CAFAna/Extrap/IExtrap.h"
+#include "CAFAna/Core/HistCache.h"
 #include "CAFAna/Core/LoadFromFile.h"
+#include "CAFAna/Core/OscillatableSpectrum.h"
 
 #include "TDirectory.h"
 #include "TObjString.h"
@@ -9,6 +11,32 @@
 
 namespace ana
 {
+  namespace
+  {
+    /// The CC components, in the order they're stored in the stack
+    struct StackChannel
+    {
+      Flavors::Flavors_t flav;
+      Sign::Sign_t sign;
+      int from, to;
+    };
+
+    const StackChannel kStackChannels[] = {
+      {Flavors::kNuEToNuE,    Sign::kNu,     +12, +12},
+      {Flavors::kNuEToNuE,    Sign::kAntiNu, -12, -12},
+      {Flavors::kNuEToNuMu,   Sign::kNu,     +12, +14},
+      {Flavors::kNuEToNuMu,   Sign::kAntiNu, -12, -14},
+      {Flavors::kNuEToNuTau,  Sign::kNu,     +12, +16},
+      {Flavors::kNuEToNuTau,  Sign::kAntiNu, -12, -16},
+      {Flavors::kNuMuToNuE,   Sign::kNu,     +14, +12},
+      {Flavors::kNuMuToNuE,   Sign::kAntiNu, -14, -12},
+      {Flavors::kNuMuToNuMu,  Sign::kNu,     +14, +14},
+      {Flavors::kNuMuToNuMu,  Sign::kAntiNu, -14, -14},
+      {Flavors::kNuMuToNuTau, Sign::kNu,     +14, +16},
+      {Flavors::kNuMuToNuTau, Sign::kAntiNu, -14, -16}
+    };
+  }
+
   //----------------------------------------------------------------------
   PredictionExtrap::PredictionExtrap(IExtrap* extrap)
     : fExtrap(extrap)
@@ -36,38 +64,77 @@ namespace ana
                                               Current::Current_t curr,
                                               Sign::Sign_t sign) const
   {
-    Spectrum ret = fExtrap->NCComponent(); // Get binning
-    ret.Clear();
-
-    if(curr & Current::kCC){
-      if(flav & Flavors::kNuEToNuE    && sign & Sign::kNu)     {
-	ret += fExtrap->NueSurvComponent().    Oscillated(calc, +12, +12);
-      }
-      if(flav & Flavors::kNuEToNuE    && sign & Sign::kAntiNu) ret += fExtrap->AntiNueSurvComponent().Oscillated(calc, -12, -12);
+    // Get binning and exposure
+    const Spectrum nc = fExtrap->NCComponent();
 
-      if(flav & Flavors::kNuEToNuMu   && sign & Sign::kNu)     ret += fExtrap->NumuAppComponent().    Oscillated(calc, +12, +14);
-      if(flav & Flavors::kNuEToNuMu   && sign & Sign::kAntiNu) ret += fExtrap->AntiNumuAppComponent().Oscillated(calc, -12, -14);
+    DontAddDirectory guard;
 
-      if(flav & Flavors::kNuEToNuTau  && sign & Sign::kNu)     ret += fExtrap->TauFromEComponent().    Oscillated(calc, +12, +16);
-      if(flav & Flavors::kNuEToNuTau  && sign & Sign::kAntiNu) ret += fExtrap->AntiTauFromEComponent().Oscillated(calc, -12, -16);
+    // All the components accumulate straight into it
+    TH1D* h = HistCache::New("", nc.Bins1D());
 
-      if(flav & Flavors::kNuMuToNuE   && sign & Sign::kNu)     ret += fExtrap->NueAppComponent().    Oscillated(calc, +14, +12);
-      if(flav & Flavors::kNuMuToNuE   && sign & Sign::kAntiNu) ret += fExtrap->AntiNueAppComponent().Oscillated(calc, -14, -12);
+    AddComponentTo(calc, flav, curr, sign, nc.POT(), h->GetArray());
 
-      if(flav & Flavors::kNuMuToNuMu  && sign & Sign::kNu)     ret += fExtrap->NumuSurvComponent().    Oscillated(calc, +14, +14);
-      if(flav & Flavors::kNuMuToNuMu  && sign & Sign::kAntiNu) ret += fExtrap->AntiNumuSurvComponent().Oscillated(calc, -14, -14);
+    return Spectrum(std::unique_ptr<TH1D>(h), nc.GetLabels(), nc.GetBinnings(),
+                    nc.POT(), nc.Livetime());
+  }
 
-      if(flav & Flavors::kNuMuToNuTau && sign & Sign::kNu)     ret += fExtrap->TauFromMuComponent().    Oscillated(calc, +14, +16);
-      if(flav & Flavors::kNuMuToNuTau && sign & Sign::kAntiNu) ret += fExtrap->AntiTauFromMuComponent().Oscillated(calc, -14, -16);
+  //----------------------------------------------------------------------
+  void PredictionExtrap::AddComponentTo(osc::IOscCalculator* calc,
+                                        Flavors::Flavors_t flav,
+                                        Current::Current_t curr,
+                                        Sign::Sign_t sign,
+                                        double pot,
+                                        double* arr) const
+  {
+    if(curr & Current::kCC){
+      const unsigned int mask = StackMask(flav, sign);
+      if(mask){
+        InitStack();
+        fStack->AddOscillatedTo(calc, mask, pot, arr);
+      }
     }
     if(curr & Current::kNC){
       assert(flav == Flavors::kAll); // Don't know how to calculate anything else
       assert(sign == Sign::kBoth);   // Why would you want to split NCs out by sign?
 
-      ret += fExtrap->NCComponent();
+      fExtrap->AddNCTo(pot, arr);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  unsigned int PredictionExtrap::StackMask(Flavors::Flavors_t flav,
+                                           Sign::Sign_t sign)
+  {
+    unsigned int mask = 0;
+    unsigned int bit = 1;
+    for(const StackChannel& ch: kStackChannels){
+      if((flav & ch.flav) && (sign & ch.sign)) mask |= bit;
+      bit <<= 1;
+    }
+    return mask;
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionExtrap::InitStack() const
+  {
+    if(fStackReady.load(std::memory_order_acquire)) return;
+
+    // If several threads get here at once, only the first does the work
+    std::lock_guard<std::mutex> lock(fStackMutex);
+    if(fStackReady.load(std::memory_order_acquire)) return;
+
+    fStack = std::make_unique<OscillatableStack>();
+    for(const StackChannel& ch: kStackChannels){
+      // Use the extrapolation's own templates where we can, so as not to hold
+      // them twice
+      const OscillatableSpectrum* s = fExtrap->StoredCCComponent(ch.from, ch.to);
+      if(s)
+        fStack->AddRef(*s, ch.from, ch.to);
+      else
+        fStack->Add(ComponentCC(ch.from, ch.to), ch.from, ch.to);
     }
 
-    return ret;
+    fStackReady.store(true, std::memory_order_release);
   }
 
   //----------------------------------------------------------------------
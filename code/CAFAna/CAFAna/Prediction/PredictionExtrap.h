@@ -2,6 +2,12 @@
 
 #include "CAFAna/Prediction/IPrediction.h"
 
+#include "CAFAna/Core/OscillatableStack.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 namespace ana
 {
   class IExtrap;
@@ -21,6 +27,13 @@ namespace ana
                                       Current::Current_t curr,
                                       Sign::Sign_t sign) const override;
 
+    virtual void AddComponentTo(osc::IOscCalculator* calc,
+                                Flavors::Flavors_t flav,
+                                Current::Current_t curr,
+                                Sign::Sign_t sign,
+                                double pot,
+                                double* arr) const override;
+
     OscillatableSpectrum ComponentCC(int from, int to) const override;
     Spectrum ComponentNC() const override;
 
@@ -31,7 +44,22 @@ namespace ana
 
     IExtrap* GetExtrap() const {return fExtrap;}
   protected:
+    /// Which of the CC components of \ref fStack \a flav and \a sign select
+    static unsigned int StackMask(Flavors::Flavors_t flav, Sign::Sign_t sign);
+
+    /// \brief Gather the CC components of the extrapolation into \ref fStack
+    /// on first use. Safe to call from multiple threads
+    ///
+    /// Components the extrapolation stores (IExtrap::StoredCCComponent) are
+    /// used in place, others are copied. The extrapolation mustn't change
+    /// after this.
+    void InitStack() const;
 
     IExtrap* fExtrap;
+
+    /// All the CC components, so they can be oscillated in one go
+    mutable std::unique_ptr<OscillatableStack> fStack;
+    mutable std::mutex fStackMutex;
+    mutable std::atomic<bool> fStackReady{false};
   };
 }
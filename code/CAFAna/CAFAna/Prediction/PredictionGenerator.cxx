@@ -9,15 +9,19 @@ namespace ana
   NoExtrapGenerator::NoExtrapGenerator(
     const HistAxis axis,
     const Cut cut,
-    const Var wei
-  ) : fAxis(axis), fCut(cut), fWei(wei) {}
+    const Var wei,
+    const Binning trueBins,
+    const bool trimTrueBins
+  ) : fAxis(axis), fCut(cut), fWei(wei),
+      fTrueBins(trueBins), fTrimTrueBins(trimTrueBins) {}
 
   std::unique_ptr<IPrediction> NoExtrapGenerator::Generate(
 							   Loaders& loaders,
 							   const SystShifts& shiftMC
 							   ) const {
     return std::unique_ptr<IPrediction>( new PredictionNoExtrap(
-								loaders, fAxis, fCut, shiftMC, fWei ) );
+								loaders, fAxis, fCut, shiftMC, fWei,
+								fTrueBins, fTrimTrueBins ) );
   }
 
 }
@@ -37,7 +37,9 @@ namespace ana
     NoExtrapGenerator(
       const HistAxis axis,
       const Cut cut,
-      const Var wei = kUnweighted );
+      const Var wei = kUnweighted,
+      const Binning trueBins = kTrueEnergyBins,
+      const bool trimTrueBins = false );
 
     std::unique_ptr<IPrediction> Generate(
     					  Loaders& loaders,
@@ -47,5 +49,7 @@ namespace ana
     const HistAxis fAxis;
     const Cut fCut;
     const Var fWei;
+    const Binning fTrueBins;
+    const bool fTrimTrueBins;
   };
 }
@@ -1,13 +1,15 @@
 #include "CAFAna/Prediction/PredictionInterp.h"
 #include "CAFAna/Core/HistCache.h"
 #include "CAFAna/Core/LoadFromFile.h"
+#include "CAFAna/Core/OscCalcKey.h"
 #include "CAFAna/Core/Ratio.h"
 #include "CAFAna/Core/SystRegistry.h"
+#include "CAFAna/Core/ThreadPool.h"
 #include "CAFAna/Core/Utilities.h"
 
 #include "TDirectory.h"
+#include "TFile.h"
 #include "TH2.h"
-#include "TMatrixD.h"
 #include "TObjString.h"
 #include "TVectorD.h"
 
@@ -21,6 +23,7 @@
 #include "CAFAna/Core/Loaders.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <malloc.h>
 
 namespace ana
@@ -36,6 +39,8 @@ namespace ana
       fBinning(0, {}, {}, 0, 0),
       fSplitBySign(mode == kSplitBySign)
   {
+    if(fOscOrigin) fOscTally.Set(0, 1);
+
     for(const ISyst* syst: systs){
       ShiftedPreds sp;
       sp.systName = syst->ShortName();
@@ -71,105 +76,119 @@ namespace ana
   //----------------------------------------------------------------------
   std::vector<std::vector<PredictionInterp::Coeffs>> PredictionInterp::
   FitRatios(const std::vector<double>& shifts,
-            const std::vector<std::unique_ptr<TH1>>& ratios) const
+            const std::vector<std::vector<double>>& ratios)
   {
     assert(shifts.size() == ratios.size());
+    assert(ratios.size() >= 2);
+
+    // This is cubic interpolation. For each adjacent set of four points we
+    // determine coefficients for a cubic which will be the curve between the
+    // center two. We constrain the function to match the two center points
+    // and to have the right mean gradient at them. This causes this patch to
+    // match smoothly with the next one along. The resulting function is
+    // continuous and first and second differentiable. At the ends of the
+    // range we fit a quadratic instead with only one constraint on the
+    // slope. The coordinate conventions are that point y1 sits at x=0 and y2
+    // at x=1.
+    //
+    // The knots are at fixed positions, so solving those constraints gives
+    // the same linear map from knot values to coefficients in every bin. The
+    // maps below are the constraint matrices already inverted and multiplied
+    // through, each row giving one of a, b, c, d as weights on a window of
+    // consecutive knots.
+
+    // Interior intervals, weights on y0..y3
+    static const double kCubic[4][4] = {{-.5,  1.5, -1.5,  .5},
+                                        {  1, -2.5,    2, -.5},
+                                        {-.5,    0,   .5,   0},
+                                        {  0,    1,    0,   0}};
+    // First interval, weights on y1..y3
+    static const double kFirst[4][3] = {{   0, 0,   0},
+                                        {  .5, -1, .5},
+                                        {-1.5,  2, -.5},
+                                        {   1,  0,   0}};
+    // Last interval, weights on y0..y2
+    static const double kLast[4][3] = {{  0,  0,  0},
+                                       { .5, -1, .5},
+                                       {-.5,  0, .5},
+                                       {  0,  1,  0}};
+    // Special-case for linear interpolation, weights on y0..y1
+    static const double kLinear[4][2] = {{ 0, 0},
+                                         { 0, 0},
+                                         {-1, 1},
+                                         { 1, 0}};
 
-    std::vector<std::vector<Coeffs>> ret;
-
-    const int binMax = ratios[0]->GetNbinsX();
-
-    for(int binIdx = 0; binIdx < binMax+2; ++binIdx){
-      ret.push_back({});
-
-      // This is cubic interpolation. For each adjacent set of four points we
-      // determine coefficients for a cubic which will be the curve between the
-      // center two. We constrain the function to match the two center points
-      // and to have the right mean gradient at them. This causes this patch to
-      // match smoothly with the next one along. The resulting function is
-      // continuous and first and second differentiable. At the ends of the
-      // range we fit a quadratic instead with only one constraint on the
-      // slope. The coordinate conventions are that point y1 sits at x=0 and y2
-      // at x=1. The matrices are simply the inverses of writing out the
-      // constraints expressed above.
+    double stride = -1;
+    for(unsigned int i = 0; i < shifts.size()-1; ++i){
+      const double newStride = shifts[i+1]-shifts[i];
+      assert((stride < 0 || fabs(stride-newStride) < 1e-3) &&
+             "Variably-spaced syst templates are unsupported");
+      stride = newStride;
+    }
 
-      // Special-case for linear interpolation
-      if(ratios.size() == 2){
-        const double y0 = ratios[0]->GetBinContent(binIdx);
-        const double y1 = ratios[1]->GetBinContent(binIdx);
+    // If the stride is actually not 1, need to rescale all the coefficients.
+    // Fold that into the maps too.
+    const double scale[4] = {1/util::cube(stride), 1/util::sqr(stride),
+                             1/stride, 1};
 
-        ret.back().emplace_back(0, 0, y1-y0, y0);
-        continue;
-      }
+    // The map for each shift interval, as the index of the first knot it
+    // uses, and a 4x4 matrix padded with zeros
+    struct KnotMap{unsigned int first; double w[4][4];};
+    std::vector<KnotMap> maps;
 
+    auto addMap = [&maps, &scale](unsigned int first, unsigned int nKnots,
+                                  const double* w)
       {
-        const double y1 = ratios[0]->GetBinContent(binIdx);
-        const double y2 = ratios[1]->GetBinContent(binIdx);
-        const double y3 = ratios[2]->GetBinContent(binIdx);
-        const double v[3] = {y1, y2, (y3-y1)/2};
-        const double m[9] = { 1, -1,  1,
-                             -2,  2, -1,
-                              1,  0,  0};
-        const TVectorD res = TMatrixD(3, 3, m) * TVectorD(3, v);
-        ret.back().emplace_back(0, res(0), res(1), res(2));
+        KnotMap m{first, {}};
+        for(int k = 0; k < 4; ++k)
+          for(unsigned int j = 0; j < nKnots; ++j)
+            m.w[k][j] = w[k*nKnots+j]*scale[k];
+        maps.push_back(m);
+      };
+
+    const unsigned int nShifts = ratios.size();
+    if(nShifts == 2){
+      addMap(0, 2, &kLinear[0][0]);
+    }
+    else{
+      addMap(0, 3, &kFirst[0][0]);
+      // We're assuming here that the shifts are separated by exactly 1 sigma.
+      for(unsigned int shiftIdx = 1; shiftIdx < nShifts-2; ++shiftIdx){
+        addMap(shiftIdx-1, 4, &kCubic[0][0]);
       }
+      addMap(nShifts-3, 3, &kLast[0][0]);
+    }
 
-      // We're assuming here that the shifts are separated by exactly 1 sigma.
-      for(unsigned int shiftIdx = 1; shiftIdx < ratios.size()-2; ++shiftIdx){
-        const double y0 = ratios[shiftIdx-1]->GetBinContent(binIdx);
-        const double y1 = ratios[shiftIdx  ]->GetBinContent(binIdx);
-        const double y2 = ratios[shiftIdx+1]->GetBinContent(binIdx);
-        const double y3 = ratios[shiftIdx+2]->GetBinContent(binIdx);
-
-        const double v[4] = {y1, y2, (y2-y0)/2, (y3-y1)/2};
-        const double m[16] = { 2, -2,  1,  1,
-                              -3,  3, -2, -1,
-                               0,  0,  1,  0,
-                               1,  0,  0,  0};
-        const TVectorD res = TMatrixD(4, 4, m) * TVectorD(4, v);
-        ret.back().emplace_back(res(0), res(1), res(2), res(3));
-      } // end for shiftIdx
+    const unsigned int nBins = ratios[0].size();
+    std::vector<std::vector<Coeffs>> ret(nBins);
 
-      {
-        const int N = ratios.size()-3;
-        const double y0 = ratios[N  ]->GetBinContent(binIdx);
-        const double y1 = ratios[N+1]->GetBinContent(binIdx);
-        const double y2 = ratios[N+2]->GetBinContent(binIdx);
-        const double v[3] = {y1, y2, (y2-y0)/2};
-        const double m[9] = {-1,  1, -1,
-                              0,  0,  1,
-                              1,  0,  0};
-        const TVectorD res = TMatrixD(3, 3, m) * TVectorD(3, v);
-        ret.back().emplace_back(0, res(0), res(1), res(2));
+    std::vector<double> y(nShifts+3); // padded so windows never overrun
+    for(unsigned int binIdx = 0; binIdx < nBins; ++binIdx){
+      for(unsigned int i = 0; i < nShifts; ++i) y[i] = ratios[i][binIdx];
+
+      ret[binIdx].reserve(maps.size());
+      for(const KnotMap& m: maps){
+        const double* yw = &y[m.first];
+        double c[4];
+        for(int k = 0; k < 4; ++k){
+          c[k] = m.w[k][0]*yw[0] + m.w[k][1]*yw[1] + m.w[k][2]*yw[2] + m.w[k][3]*yw[3];
+        }
+        ret[binIdx].emplace_back(c[0], c[1], c[2], c[3]);
       }
     } // end for binIdx
 
-    double stride = -1;
-    for(unsigned int i = 0; i < shifts.size()-1; ++i){
-      const double newStride = shifts[i+1]-shifts[i];
-      assert((stride < 0 || fabs(stride-newStride) < 1e-3) &&
-             "Variably-spaced syst templates are unsupported");
-      stride = newStride;
-    }
-
-    // If the stride is actually not 1, need to rescale all the coefficients
-    for(std::vector<Coeffs>& cs: ret)
-      for(Coeffs& c: cs){
-        c = Coeffs(c.a/util::cube(stride),
-                   c.b/util::sqr(stride),
-                   c.c/stride,
-                   c.d);}
     return ret;
   }
 
   //----------------------------------------------------------------------
-  std::vector<std::vector<PredictionInterp::Coeffs>> PredictionInterp::
-  FitComponent(const std::vector<double>& shifts,
-               const std::vector<IPrediction*>& preds,
-               Flavors::Flavors_t flav,
-               Current::Current_t curr,
-               Sign::Sign_t sign,
-               const std::string& systName) const
+  std::vector<std::vector<double>> PredictionInterp::
+  ComponentRatios(osc::IOscCalculator* calc,
+                  const std::vector<double>& shifts,
+                  const std::vector<IPrediction*>& preds,
+                  Flavors::Flavors_t flav,
+                  Current::Current_t curr,
+                  Sign::Sign_t sign,
+                  const std::string& systName) const
   {
     IPrediction* pNom = 0;
     for(unsigned int i = 0; i < shifts.size(); ++i){
@@ -180,112 +199,430 @@ namespace ana
     // Do it this way rather than via fPredNom so that systematics evaluated
     // relative to some alternate nominal (eg Birks C where the appropriate
     // nominal is no-rock) can work.
-    const Spectrum nom = pNom->PredictComponent(fOscOrigin,
-						flav, curr, sign);
+    const Spectrum nom = pNom->PredictComponent(calc, flav, curr, sign);
 
-    std::vector<std::unique_ptr<TH1>> ratios;
+    std::vector<std::vector<double>> ratios;
+    ratios.reserve(preds.size());
     for(auto& p: preds){
-      ratios.emplace_back(Ratio(p->PredictComponent(fOscOrigin,
-                                                    flav, curr, sign),
-                                nom).ToTH1());
+      std::unique_ptr<TH1D> r(Ratio(p->PredictComponent(calc,
+                                                       flav, curr, sign),
+                                   nom).ToTH1());
+
+      const int nBins = r->GetNbinsX()+2;
+      const double* arr = r->GetArray();
+      ratios.emplace_back(arr, arr+nBins);
 
       // Check none of the ratio values is crazy
-      std::unique_ptr<TH1>& r = ratios.back();
-      for(int i = 0; i < r->GetNbinsX()+2; ++i){
-	const double y = r->GetBinContent(i);
+      for(int i = 0; i < nBins; ++i){
+	double& y = ratios.back()[i];
 	if(y > 2){
 	  std::cout << "PredictionInterp: WARNING, ratio in bin "
 		    << i << " for " << shifts[&p-&preds.front()]
                     << " sigma shift of " << systName << " is " << y
                     << " which exceeds limit of 2. Capping." << std::endl;
-	  r->SetBinContent(i, 2);
+	  y = 2;
 	}
       }
     }
 
-    return FitRatios(shifts, ratios);
+    return ratios;
   }
 
   //----------------------------------------------------------------------
   void PredictionInterp::InitFitsHelper(ShiftedPreds& sp,
                                         std::vector<std::vector<std::vector<Coeffs>>>& fits,
-                                        Sign::Sign_t sign) const
+                                        Sign::Sign_t sign,
+                                        std::vector<PendingFit>& pending) const
   {
     fits.resize(kNCoeffTypes);
 
-    fits[kNueApp]   = FitComponent(sp.shifts, sp.preds, Flavors::kNuMuToNuE,  Current::kCC, sign, sp.systName);
-    fits[kNueSurv]  = FitComponent(sp.shifts, sp.preds, Flavors::kNuEToNuE,   Current::kCC, sign, sp.systName);
-    fits[kNumuSurv] = FitComponent(sp.shifts, sp.preds, Flavors::kNuMuToNuMu, Current::kCC, sign, sp.systName);
+    auto add = [&](CoeffsType type, Flavors::Flavors_t flav, Current::Current_t curr)
+      {
+        pending.push_back({&sp, flav, curr, sign, &fits[type]});
+      };
+
+    add(kNueApp,   Flavors::kNuMuToNuE,  Current::kCC);
+    add(kNueSurv,  Flavors::kNuEToNuE,   Current::kCC);
+    add(kNumuSurv, Flavors::kNuMuToNuMu, Current::kCC);
+
+    add(kNC,       Flavors::kAll, Current::kNC);
+
+    add(kOther, Flavors::kNuEToNuMu | Flavors::kAllNuTau, Current::kCC);
+  }
 
-    fits[kNC]       = FitComponent(sp.shifts, sp.preds, Flavors::kAll, Current::kNC, sign, sp.systName);
+  //----------------------------------------------------------------------
+  void PredictionInterp::FitPending(PendingFit* job) const
+  {
+    // Calculators cache their last evaluation, so each task needs its own
+    std::unique_ptr<osc::IOscCalculator> calc(fOscOrigin->Copy());
+
+    const ShiftedPreds& sp = *job->sp;
+    *job->fits = FitRatios(sp.shifts,
+                           ComponentRatios(calc.get(), sp.shifts, sp.preds,
+                                           job->flav, job->curr, job->sign,
+                                           sp.systName));
+  }
 
-    fits[kOther] = FitComponent(sp.shifts, sp.preds, Flavors::kNuEToNuMu | Flavors::kAllNuTau, Current::kCC, sign, sp.systName);
+  //----------------------------------------------------------------------
+  void PredictionInterp::
+  PackCoeffs(const std::vector<std::vector<std::vector<Coeffs>>>& fits,
+             unsigned int binStride,
+             std::vector<double, AlignedAllocator<double>>& packed)
+  {
+    // fits is [type][histogram bin][shift bin]
+    const unsigned int nTypes = fits.size();
+    const unsigned int nBins = fits[0].size();
+    const unsigned int nShiftBins = fits[0][0].size();
+    assert(nBins <= binStride);
+
+    // Padding bins are left as zero
+    packed.assign(nTypes*nShiftBins*4*binStride, 0);
+
+    for(unsigned int type = 0; type < nTypes; ++type){
+      for(unsigned int shiftBin = 0; shiftBin < nShiftBins; ++shiftBin){
+        double* a = &packed[(type*nShiftBins + shiftBin)*4*binStride];
+        double* b = a + binStride;
+        double* c = b + binStride;
+        double* d = c + binStride;
+        for(unsigned int n = 0; n < nBins; ++n){
+          const Coeffs& f = fits[type][n][shiftBin];
+          a[n] = f.a; b[n] = f.b; c[n] = f.c; d[n] = f.d;
+        }
+      }
+    }
   }
 
   //----------------------------------------------------------------------
   void PredictionInterp::InitFits() const
   {
+    if(fFitsReady.load(std::memory_order_acquire)) return;
+
+    // If several threads get here at once, only the first does the work
+    std::lock_guard<std::mutex> lock(fInitMutex);
+
+    // Everything the const predict functions need from fBinning is settled
+    // here, under the lock, so that they never have to modify it
+    auto markReady = [this]()
+      {
+        if(fBinning.POT()==0) fBinning.OverridePOT(1e24);
+        // Bins1D() constructs a new Binning, so don't do it per evaluation
+        fNBinsInto = fBinning.Bins1D().NBins()+2;
+        fFitsReady.store(true, std::memory_order_release);
+      };
+
     // No systs
     if(fPreds.empty()){
-      if(fBinning.POT() > 0 || fBinning.Livetime() > 0) return;
+      if(fBinning.POT() > 0 || fBinning.Livetime() > 0){
+        markReady();
+        return;
+      }
     }
     // Already initialized
-    else if(!fPreds.empty() && !fPreds.begin()->second.fits.empty()) return;
+    else if(!fPreds.empty() && !fPreds.begin()->second.packed.empty()){
+      markReady();
+      return;
+    }
 
+    // Gather everything that needs fitting first, so that the (expensive)
+    // evaluation of the shifted predictions can be shared out between threads
+    std::vector<PendingFit> pending;
     for(auto& it: fPreds){
       ShiftedPreds& sp = it.second;
 
-      if(fSplitBySign){
-        InitFitsHelper(sp, sp.fits, Sign::kNu);
-        InitFitsHelper(sp, sp.fitsNubar, Sign::kAntiNu);
-      }
-      else{
-        InitFitsHelper(sp, sp.fits, Sign::kBoth);
+      // Not read from file yet, will be fit when it is
+      if(!sp.ready.val) continue;
+
+      // The coefficients may already have been read from file
+      if(sp.fits.empty()){
+        if(fSplitBySign){
+          InitFitsHelper(sp, sp.fits, Sign::kNu, pending);
+          InitFitsHelper(sp, sp.fitsNubar, Sign::kAntiNu, pending);
+        }
+        else{
+          InitFitsHelper(sp, sp.fits, Sign::kBoth, pending);
+        }
       }
-      sp.nCoeffs = sp.fits[0][0].size();
+    }
 
-      // Copy the outputs into the remapped indexing order. TODO this is very
-      // ugly. Best would be to generate things in this order natively.
+    // Each is independent, one per syst and component
+    RunPending(pending);
 
-      sp.fitsRemap.resize(sp.fits.size());
-      for(auto& it: sp.fitsRemap){
-        it.resize(sp.fits[0][0].size());
-        for(auto& it2: it) it2.resize(sp.fits[0].size(), Coeffs(0, 0, 0, 0));
-      }
+    for(auto& it: fPreds){
+      if(!it.second.ready.val) continue;
+      CollapseFits(it.second);
+      PackFits(it.second);
+    }
+
+    UpdateCoeffTally();
+
+    // Predict something, anything, so that we can know what binning to use
+    fBinning = fPredNom->Predict(fOscOrigin);
+    fBinning.Clear();
+
+    markReady();
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::RunPending(std::vector<PendingFit>& pending) const
+  {
+    if(pending.empty()) return;
+
+    // Serial unless asked otherwise. Zero means one thread per core
+    const char* env = getenv("CAFANA_PREDINTERP_THREADS");
+    const unsigned int nThreads = env ? std::max(atoi(env), 0) : 1;
+
+    if(nThreads == 1 || pending.size() == 1){
+      for(PendingFit& job: pending) FitPending(&job);
+    }
+    else{
+      ThreadPool pool(nThreads);
+      for(PendingFit& job: pending) pool.AddMemberTask(this, &PredictionInterp::FitPending, &job);
+      pool.Finish();
+    }
+  }
+
+  //----------------------------------------------------------------------
+  int PredictionInterp::PolyDegree(const std::vector<double>& shifts,
+                                   const std::vector<std::vector<Coeffs>>& fits,
+                                   double tol,
+                                   std::vector<std::array<double, 3>>& poly)
+  {
+    const unsigned int K = shifts.size();
+    assert(K >= 3);
+
+    const double stride = shifts[1]-shifts[0];
+
+    // Try a straight line through the end knots, then a parabola through
+    // them and the middle one
+    const double x0 = shifts[0];
+    const double xm = shifts[(K-1)/2];
+    const double x1 = shifts[K-1];
+
+    poly.resize(fits.size());
+
+    int ret = 1;
+    std::vector<double> y(K);
+    for(unsigned int binIdx = 0; binIdx < fits.size(); ++binIdx){
+      // Each segment starts at its knot, and the last one ends at the last
+      const std::vector<Coeffs>& segs = fits[binIdx];
+      assert(segs.size() == K-1);
+      for(unsigned int i = 0; i < K-1; ++i) y[i] = segs[i].d;
+      const Coeffs& f = segs.back();
+      y[K-1] = ((f.a*stride + f.b)*stride + f.c)*stride + f.d;
+
+      auto matches = [&](const std::array<double, 3>& p)
+        {
+          for(unsigned int i = 0; i < K; ++i){
+            const double x = shifts[i];
+            if(fabs((p[2]*x + p[1])*x + p[0] - y[i]) > tol) return false;
+          }
+          return true;
+        };
+
+      const double ym = y[(K-1)/2];
+      const double y0 = y[0];
+      const double y1 = y[K-1];
+
+      const double m = (y1-y0)/(x1-x0);
+      poly[binIdx] = {y0 - m*x0, m, 0};
+      if(matches(poly[binIdx])) continue;
+
+      // Newton's divided differences
+      const double f0m = (ym-y0)/(xm-x0);
+      const double fm1 = (y1-ym)/(x1-xm);
+      const double f2 = (fm1-f0m)/(x1-x0);
+      poly[binIdx] = {y0 - f0m*x0 + f2*x0*xm, f0m - f2*(x0+xm), f2};
+      if(!matches(poly[binIdx])) return 3;
+
+      ret = 2;
+    } // end for binIdx
+
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::CollapseFits(ShiftedPreds& sp) const
+  {
+    static const char* env = getenv("CAFANA_PREDINTERP_POLY_TOL");
+    static const double tol = env ? atof(env) : 0;
+    if(tol <= 0) return;
+
+    const unsigned int K = sp.shifts.size();
+
+    // Already a single segment
+    if(K < 3 || sp.fits.empty() || sp.fits[0].empty() || sp.fits[0][0].size() < 2) return;
+
+    // Every component has to qualify, since they share one layout
+    typedef std::vector<std::vector<std::array<double, 3>>> Polys_t;
+    Polys_t polys(sp.fits.size()), polysNubar(sp.fitsNubar.size());
+    int degree = 1;
+    for(unsigned int type = 0; type < sp.fits.size(); ++type){
+      degree = std::max(degree, PolyDegree(sp.shifts, sp.fits[type], tol, polys[type]));
+      if(degree > 2) return;
+    }
+    for(unsigned int type = 0; type < sp.fitsNubar.size(); ++type){
+      degree = std::max(degree, PolyDegree(sp.shifts, sp.fitsNubar[type], tol, polysNubar[type]));
+      if(degree > 2) return;
+    }
+
+    // Keep three templates around the nominal, enough to refit the same
+    // polynomial later
+    const int i0 = std::find(sp.shifts.begin(), sp.shifts.end(), 0.)-sp.shifts.begin();
+    const int start = std::max(0, std::min(i0-1, int(K)-3));
+
+    std::vector<double> shifts(sp.shifts.begin()+start, sp.shifts.begin()+start+3);
+    std::vector<IPrediction*> preds(sp.preds.begin()+start, sp.preds.begin()+start+3);
 
-      for(unsigned int i = 0; i < sp.fitsRemap.size(); ++i){
-        for(unsigned int j = 0; j < sp.fitsRemap[i].size(); ++j){
-          for(unsigned int k = 0; k < sp.fitsRemap[i][j].size(); ++k){
-            sp.fitsRemap[i][j][k] = sp.fits[i][k][j];
+    int nDeleted = 0;
+    for(IPrediction* p: sp.preds){
+      if(!p || p == fPredNom.get() ||
+         std::find(preds.begin(), preds.end(), p) != preds.end()) continue;
+      delete p;
+      ++nDeleted;
+    }
+
+    sp.shifts = shifts;
+    sp.preds = preds;
+
+    // One segment, relative to the new first knot
+    const double o = shifts[0];
+    auto toFits = [o](const Polys_t& ps, std::vector<std::vector<std::vector<Coeffs>>>& fits)
+      {
+        for(unsigned int type = 0; type < ps.size(); ++type){
+          for(unsigned int binIdx = 0; binIdx < ps[type].size(); ++binIdx){
+            const std::array<double, 3>& p = ps[type][binIdx];
+            fits[type][binIdx] = {Coeffs(0, p[2], p[1] + 2*p[2]*o, (p[2]*o + p[1])*o + p[0])};
           }
         }
+      };
+    toFits(polys, sp.fits);
+    toFits(polysNubar, sp.fitsNubar);
+
+    if(nDeleted > 0){
+      std::cout << "PredictionInterp: " << sp.systName << " responds "
+                << (degree == 1 ? "linearly" : "quadratically")
+                << ", keeping 3 of " << K << " templates. Reducing its "
+                << "PredInterpMaxNSigma() would save making the others."
+                << std::endl;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::PackFits(ShiftedPreds& sp) const
+  {
+    sp.nCoeffs = sp.fits[0][0].size();
+
+    sp.degree = 1;
+    for(auto fits: {&sp.fits, &sp.fitsNubar}){
+      for(auto& it: *fits) for(auto& it2: it) for(const Coeffs& f: it2){
+        if(f.a != 0) sp.degree = 3;
+        else if(f.b != 0) sp.degree = std::max(sp.degree, 2);
       }
+    }
+
+    // Round the bins up to a whole number of cache lines
+    const unsigned int kLine = AlignedAllocator<double>::kAlign/sizeof(double);
+    sp.binStride = (sp.fits[0].size()+kLine-1)/kLine*kLine;
 
-      sp.fitsNubarRemap.resize(sp.fitsNubar.size());
-      for(auto& it: sp.fitsNubarRemap){
-        it.resize(sp.fitsNubar[0][0].size());
-        for(auto& it2: it) it2.resize(sp.fitsNubar[0].size(), Coeffs(0, 0, 0, 0));
+    PackCoeffs(sp.fits, sp.binStride, sp.packed);
+    if(fSplitBySign) PackCoeffs(sp.fitsNubar, sp.binStride, sp.packedNubar);
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::UpdateCoeffTally() const
+  {
+    long nBytes = 0;
+    int nLoaded = 0;
+    for(auto& it: fPreds){
+      if(!it.second.ready.val) continue;
+      ++nLoaded;
+      for(auto fits: {&it.second.fits, &it.second.fitsNubar}){
+        for(auto& it2: *fits) for(auto& it3: it2) nBytes += it3.size()*sizeof(Coeffs);
       }
+      nBytes += (it.second.packed.size()+it.second.packedNubar.size())*sizeof(double);
+    }
+    fCoeffTally.Set(nBytes, nLoaded);
+  }
 
-      for(unsigned int i = 0; i < sp.fitsNubarRemap.size(); ++i){
-        for(unsigned int j = 0; j < sp.fitsNubarRemap[i].size(); ++j){
-          for(unsigned int k = 0; k < sp.fitsNubarRemap[i][j].size(); ++k){
-            sp.fitsNubarRemap[i][j][k] = sp.fitsNubar[i][k][j];
-          }
-        }
+  //----------------------------------------------------------------------
+  void PredictionInterp::LoadLazySyst(const ISyst* syst, ShiftedPreds& sp) const
+  {
+    // Needs the binning and the oscillation origin settled
+    InitFits();
+
+    std::lock_guard<std::mutex> lock(fInitMutex);
+
+    // Another thread may have got here first
+    if(sp.ready.val.load(std::memory_order_acquire)) return;
+
+    DontAddDirectory guard;
+
+    TFile* fin = TFile::Open(fLazyFile.c_str(), "READ");
+    if(!fin || fin->IsZombie()){
+      std::cout << "PredictionInterp: can't reopen " << fLazyFile
+                << " to read " << sp.systName << std::endl;
+      abort();
+    }
+    TDirectory* dir = fLazyDir.empty() ? fin : fin->GetDirectory(fLazyDir.c_str());
+    assert(dir);
+
+    LoadSystFromBody(dir, this, syst, sp, kLazy);
+
+    delete fin;
+
+    if(sp.fits.empty()){
+      std::vector<PendingFit> pending;
+      if(fSplitBySign){
+        InitFitsHelper(sp, sp.fits, Sign::kNu, pending);
+        InitFitsHelper(sp, sp.fitsNubar, Sign::kAntiNu, pending);
       }
+      else{
+        InitFitsHelper(sp, sp.fits, Sign::kBoth, pending);
+      }
+      RunPending(pending);
+    }
 
+    CollapseFits(sp);
+    PackFits(sp);
+
+    sp.ready.val.store(true, std::memory_order_release);
+
+    UpdateCoeffTally();
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::LoadAllLazy() const
+  {
+    for(auto& it: fPreds){
+      if(!it.second.ready.val) LoadLazySyst(it.first, it.second);
     }
+  }
 
-    // Predict something, anything, so that we can know what binning to use
-    fBinning = fPredNom->Predict(fOscOrigin);
-    fBinning.Clear();
+  //----------------------------------------------------------------------
+  unsigned int PredictionInterp::NomCacheSize()
+  {
+    const char* env = getenv("CAFANA_PREDINTERP_NOMCACHE_SIZE");
+    return env ? std::max(atoi(env), 1) : 256;
   }
 
   //----------------------------------------------------------------------
   void PredictionInterp::SetOscSeed(osc::IOscCalculator* oscSeed){
+    // Everything has to be refit, so we need all the shifted predictions
+    LoadAllLazy();
+
     fOscOrigin = oscSeed->Copy();
-    for(auto& it: fPreds) it.second.fits.clear();
+    fOscTally.Set(0, 1);
+    fFitsReady = false;
+    for(auto& it: fPreds){
+      if(std::find(it.second.preds.begin(), it.second.preds.end(), nullptr) != it.second.preds.end()){
+        std::cout << "PredictionInterp: can't refit the coefficients after "
+                  << "MinimizeMemory() or a fit-only load" << std::endl;
+        abort();
+      }
+      it.second.fits.clear();
+      it.second.fitsNubar.clear();
+      it.second.packed.clear();
+    }
     InitFits();
   }
 
@@ -304,16 +641,48 @@ namespace ana
     return fPredNom->PredictComponent(calc, flav, curr, sign);
   }
 
+  //----------------------------------------------------------------------
+  void PredictionInterp::AddComponentTo(osc::IOscCalculator* calc,
+                                        Flavors::Flavors_t flav,
+                                        Current::Current_t curr,
+                                        Sign::Sign_t sign,
+                                        double pot,
+                                        double* arr) const
+  {
+    fPredNom->AddComponentTo(calc, flav, curr, sign, pot, arr);
+  }
+
   //----------------------------------------------------------------------
   Spectrum PredictionInterp::PredictSyst(osc::IOscCalculator* calc,
                                          const SystShifts& shift) const
   {
     InitFits();
 
-    return PredictComponentSyst(calc, shift,
-                                Flavors::kAll,
-                                Current::kBoth,
-                                Sign::kBoth);
+    DontAddDirectory guard;
+
+    TH1D* h = HistCache::New("", fBinning.Bins1D());
+
+    PredictSystInto(calc, shift, fBinning.POT(), h->GetArray());
+
+    return Spectrum(std::unique_ptr<TH1D>(h),
+                    fBinning.GetLabels(), fBinning.GetBinnings(),
+                    fBinning.POT(), fBinning.Livetime());
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::PredictSystInto(osc::IOscCalculator* calc,
+                                         const SystShifts& shift,
+                                         double pot,
+                                         double* arr) const
+  {
+    InitFits();
+
+    const unsigned int N = fNBinsInto;
+    for(unsigned int n = 0; n < N; ++n) arr[n] = 0;
+
+    AddComponentSystTo(calc, shift,
+                       Flavors::kAll, Current::kBoth, Sign::kBoth,
+                       pot, arr);
   }
 
   //----------------------------------------------------------------------
@@ -323,12 +692,25 @@ namespace ana
                 bool nubar,
                 const SystShifts& shift) const
   {
-    if(nubar) assert(fSplitBySign);
+    CheckSysts(shift);
 
     // TODO histogram operations could be too slow
     TH1D* h = s.ToTH1(s.POT());
 
-    const unsigned int N = h->GetNbinsX()+2;
+    ShiftBins(h->GetNbinsX()+2, h->GetArray(), type, nubar, shift);
+
+    return Spectrum(std::unique_ptr<TH1D>(h), s.GetLabels(), s.GetBinnings(), s.POT(), s.Livetime());
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::ShiftBins(unsigned int N,
+                                   double* arr,
+                                   CoeffsType type,
+                                   bool nubar,
+                                   const SystShifts& shift) const
+  {
+    if(nubar) assert(fSplitBySign);
+
     double corr[N];
     for(unsigned int i = 0; i < N; ++i) corr[i] = 1;
 
@@ -344,77 +726,142 @@ namespace ana
       shiftBin = std::max(0, shiftBin);
       shiftBin = std::min(shiftBin, sp.nCoeffs-1);
 
-      const Coeffs* fits = nubar ? &sp.fitsNubarRemap[type][shiftBin].front() : &sp.fitsRemap[type][shiftBin].front();
+      const double* __restrict__ A = sp.Packed(nubar, type, shiftBin);
+      const double* __restrict__ B = A + sp.binStride;
+      const double* __restrict__ C = B + sp.binStride;
+      const double* __restrict__ D = C + sp.binStride;
 
       x -= sp.shifts[shiftBin];
 
-      const double x_cube = util::cube(x);
-      const double x_sqr = util::sqr(x);
-
-      for(unsigned int n = 0; n < N; ++n){
-        // Uncomment to debug crashes in this function
-        // assert(type < fits.size());
-        // assert(n < sp.fits[type].size());
-        // assert(shiftBin < int(sp.fits[type][n].size()));
-
-        const Coeffs& f = fits[n];
-	corr[n] *= f.a*x_cube + f.b*x_sqr + f.c*x + f.d;
-      } // end for n
+      // Straight-line and branch-free so the compiler can vectorise it.
+      // Systs that respond linearly or quadratically skip the higher terms.
+      if(sp.degree == 1){
+        for(unsigned int n = 0; n < N; ++n) corr[n] *= C[n]*x + D[n];
+      }
+      else if(sp.degree == 2){
+        for(unsigned int n = 0; n < N; ++n) corr[n] *= (B[n]*x + C[n])*x + D[n];
+      }
+      else{
+        for(unsigned int n = 0; n < N; ++n){
+          corr[n] *= ((A[n]*x + B[n])*x + C[n])*x + D[n];
+        } // end for n
+      }
     } // end for syst
 
-    double* arr = h->GetArray();
     for(unsigned int n = 0; n < N; ++n){
 	arr[n] *= std::max(corr[n], 0.);
     }
-
-    return Spectrum(std::unique_ptr<TH1D>(h), s.GetLabels(), s.GetBinnings(), s.POT(), s.Livetime());
   }
 
   //----------------------------------------------------------------------
-  Spectrum PredictionInterp::
-  ShiftedComponent(osc::IOscCalculator* calc,
-                   const TMD5* hash,
-                   const SystShifts& shift,
-                   Flavors::Flavors_t flav,
-                   Current::Current_t curr,
-                   Sign::Sign_t sign,
-                   CoeffsType type) const
+  unsigned int PredictionInterp::ListComponents(Flavors::Flavors_t flav,
+                                                Current::Current_t curr,
+                                                Sign::Sign_t sign,
+                                                Component* ret) const
   {
+    unsigned int n = 0;
+
+    // The two signs have separate coefficients
     if(fSplitBySign && sign == Sign::kBoth){
-      return (ShiftedComponent(calc, hash, shift, flav, curr, Sign::kAntiNu, type)+
-              ShiftedComponent(calc, hash, shift, flav, curr, Sign::kNu,     type));
+      n += ListComponents(flav, curr, Sign::kAntiNu, ret);
+      n += ListComponents(flav, curr, Sign::kNu, ret+n);
+      return n;
     }
 
-    // Must be the base case of the recursion to use the cache. Otherwise we
-    // can cache systematically shifted versions of our children, which is
-    // wrong. Also, some calculators won't hash themselves.
-    const bool canCache = (hash != 0);
+    if(curr & Current::kCC){
+      if(flav & Flavors::kNuEToNuE)    ret[n++] = {Flavors::kNuEToNuE,    Current::kCC, sign, kNueSurv};
+      if(flav & Flavors::kNuEToNuMu)   ret[n++] = {Flavors::kNuEToNuMu,   Current::kCC, sign, kOther};
+      if(flav & Flavors::kNuEToNuTau)  ret[n++] = {Flavors::kNuEToNuTau,  Current::kCC, sign, kOther};
 
-    const Key_t key = {flav, curr, sign};
-    auto it = fNomCache.find(key);
+      if(flav & Flavors::kNuMuToNuE)   ret[n++] = {Flavors::kNuMuToNuE,   Current::kCC, sign, kNueApp};
+      if(flav & Flavors::kNuMuToNuMu)  ret[n++] = {Flavors::kNuMuToNuMu,  Current::kCC, sign, kNumuSurv};
+      if(flav & Flavors::kNuMuToNuTau) ret[n++] = {Flavors::kNuMuToNuTau, Current::kCC, sign, kOther};
+    }
+    if(curr & Current::kNC){
+      assert(flav == Flavors::kAll); // Don't know how to calculate anything else
 
-    // Should the interpolation use the nubar fits?
-    const bool nubar = (fSplitBySign && sign == Sign::kAntiNu);
+      ret[n++] = {Flavors::kAll, Current::kNC, sign, kNC};
+    }
+
+    return n;
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::CheckSyst(const ISyst* syst) const
+  {
+    auto it = fPreds.find(syst);
+    if(it == fPreds.end()){
+      std::cerr << "This PredictionInterp is not set up to handle the requested systematic: " << syst->ShortName() << std::endl;
+      abort();
+    }
 
-    // We have the nominal for this exact combination of flav, curr, sign, calc
-    // stored.  Shift it and return.
-    if(canCache && it != fNomCache.end() && it->second.hash == *hash){
-      return ShiftSpectrum(it->second.nom, type, nubar, shift);
+    if(!it->second.ready.val.load(std::memory_order_acquire)){
+      LoadLazySyst(syst, it->second);
     }
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::CheckSysts(const SystShifts& shift) const
+  {
+    // Iterate directly, this is called once per fit iteration
+    for(const auto& it: shift) CheckSyst(it.first);
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::
+  AddNominalComponentTo(osc::IOscCalculator* calc,
+                        const std::string* calcKey,
+                        const Component& c,
+                        double pot,
+                        double* arr) const
+  {
+    // Some calculators can't be identified
+    const bool canCache = (calcKey != 0);
 
-    // We need to compute the nominal again for whatever reason
-    const Spectrum nom = fPredNom->PredictComponent(calc, flav, curr, sign);
+    const NomKey_t key = {c.flav, c.curr, c.sign, canCache ? *calcKey : ""};
 
-    if(canCache){
-      // Insert into the cache if not already there, or update if there but
-      // with old oscillation parameters.
-      if(it == fNomCache.end())
-        fNomCache.emplace(key, Val_t({*hash, nom}));
-      else
-        it->second = {*hash, nom};
+    if(canCache && fNomCache.Visit(key, [&](const Spectrum& nom){nom.AddTo(pot, arr);})){
+      // We have the nominal for this exact combination of flav, curr, sign,
+      // calc stored.
     }
+    else if(canCache){
+      // We need to compute the nominal again for whatever reason. If another
+      // thread is doing the same at the same time, one result overwrites the
+      // other, which is harmless.
+      Spectrum nom = fPredNom->PredictComponent(calc, c.flav, c.curr, c.sign);
+      nom.AddTo(pot, arr);
+
+      nom.SetMemoryCategory(MemoryTally::kCaches);
+      fNomCache.Insert(key, std::move(nom));
+    }
+    else{
+      // Nothing to cache, so no need for an intermediate Spectrum
+      fPredNom->AddComponentTo(calc, c.flav, c.curr, c.sign, pot, arr);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::
+  AddShiftedComponentTo(osc::IOscCalculator* calc,
+                        const std::string* calcKey,
+                        const SystShifts& shift,
+                        const Component& c,
+                        double pot,
+                        unsigned int N,
+                        double* arr) const
+  {
+    // Should the interpolation use the nubar fits?
+    const bool nubar = (fSplitBySign && c.sign == Sign::kAntiNu);
+
+    // This component on its own, before shifting
+    double comp[N];
+    for(unsigned int n = 0; n < N; ++n) comp[n] = 0;
 
-    return ShiftSpectrum(nom, type, nubar, shift);
+    AddNominalComponentTo(calc, calcKey, c, pot, comp);
+
+    ShiftBins(N, comp, c.type, nubar, shift);
+
+    for(unsigned int n = 0; n < N; ++n) arr[n] += comp[n];
   }
 
   //----------------------------------------------------------------------
@@ -426,102 +873,250 @@ namespace ana
   {
     InitFits();
 
-    Spectrum& ret = fBinning;
-    ret.Clear();
+    DontAddDirectory guard;
 
-    if(ret.POT()==0) ret.OverridePOT(1e24);
+    // The only allocation. All the components accumulate straight into it.
+    TH1D* h = HistCache::New("", fBinning.Bins1D());
 
-    // Check that we're able to handle all the systs we were passed
-    for(const ISyst* syst: shift.ActiveSysts()){
-      if(fPreds.find(syst) == fPreds.end()){
-        std::cerr << "This PredictionInterp is not set up to handle the requested systematic: " << syst->ShortName() << std::endl;
-        abort();
-      }
-    } // end for syst
+    AddComponentSystTo(calc, shift, flav, curr, sign,
+                       fBinning.POT(), h->GetArray());
+
+    return Spectrum(std::unique_ptr<TH1D>(h),
+                    fBinning.GetLabels(), fBinning.GetBinnings(),
+                    fBinning.POT(), fBinning.Livetime());
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::AddComponentSystTo(osc::IOscCalculator* calc,
+                                            const SystShifts& shift,
+                                            Flavors::Flavors_t flav,
+                                            Current::Current_t curr,
+                                            Sign::Sign_t sign,
+                                            double pot,
+                                            double* arr) const
+  {
+    InitFits();
 
+    // Check that we're able to handle all the systs we were passed
+    CheckSysts(shift);
 
-    const TMD5* hash = calc ? calc->GetParamsHash() : 0;
+    std::string key;
+    const std::string* calcKey = GetOscCalcKey(calc, key) ? &key : 0;
 
-    if(curr & Current::kCC){
-      if(flav & Flavors::kNuEToNuE)    ret += ShiftedComponent(calc, hash, shift, Flavors::kNuEToNuE,    Current::kCC, sign, kNueSurv);
-      if(flav & Flavors::kNuEToNuMu)   ret += ShiftedComponent(calc, hash, shift, Flavors::kNuEToNuMu,   Current::kCC, sign, kOther  );
-      if(flav & Flavors::kNuEToNuTau)  ret += ShiftedComponent(calc, hash, shift, Flavors::kNuEToNuTau,  Current::kCC, sign, kOther  );
+    const unsigned int N = fNBinsInto;
 
-      if(flav & Flavors::kNuMuToNuE)   ret += ShiftedComponent(calc, hash, shift, Flavors::kNuMuToNuE,   Current::kCC, sign, kNueApp  );
-      if(flav & Flavors::kNuMuToNuMu)  ret += ShiftedComponent(calc, hash, shift, Flavors::kNuMuToNuMu,  Current::kCC, sign, kNumuSurv);
-      if(flav & Flavors::kNuMuToNuTau) ret += ShiftedComponent(calc, hash, shift, Flavors::kNuMuToNuTau, Current::kCC, sign, kOther   );
+    Component comps[kMaxComponents];
+    const unsigned int nComps = ListComponents(flav, curr, sign, comps);
+    for(unsigned int i = 0; i < nComps; ++i){
+      AddShiftedComponentTo(calc, calcKey, shift, comps[i], pot, N, arr);
     }
-    if(curr & Current::kNC){
-      assert(flav == Flavors::kAll); // Don't know how to calculate anything else
+  }
 
-      ret += ShiftedComponent(calc, hash, shift, Flavors::kAll, Current::kNC, sign, kNC);
-    }
+  //----------------------------------------------------------------------
+  std::vector<Spectrum> PredictionInterp::
+  PredictSystBatch(const std::vector<PredictionPoint>& points) const
+  {
+    InitFits();
 
-    delete hash;
+    const unsigned int N = NBinsInto();
+    std::vector<double> arr(points.size()*N);
+    PredictSystBatchInto(points, fBinning.POT(), arr.data());
 
+    DontAddDirectory guard;
+
+    std::vector<Spectrum> ret;
+    ret.reserve(points.size());
+    for(unsigned int i = 0; i < points.size(); ++i){
+      TH1D* h = HistCache::New("", fBinning.Bins1D());
+      std::copy(&arr[i*N], &arr[i*N]+N, h->GetArray());
+      ret.emplace_back(std::unique_ptr<TH1D>(h),
+                       fBinning.GetLabels(), fBinning.GetBinnings(),
+                       fBinning.POT(), fBinning.Livetime());
+    }
     return ret;
   }
 
   //----------------------------------------------------------------------
   void PredictionInterp::
-  ComponentDerivative(osc::IOscCalculator* calc,
-                      Flavors::Flavors_t flav,
-                      Current::Current_t curr,
-                      Sign::Sign_t sign,
-                      CoeffsType type,
-                      const SystShifts& shift,
-                      double pot,
-                      std::unordered_map<const ISyst*, std::vector<double>>& dp) const
+  PredictSystBatchInto(const std::vector<PredictionPoint>& points,
+                       double pot,
+                       double* arr) const
   {
-    if(fSplitBySign && sign == Sign::kBoth){
-      ComponentDerivative(calc, flav, curr, Sign::kNu,     type, shift, pot, dp);
-      ComponentDerivative(calc, flav, curr, Sign::kAntiNu, type, shift, pot, dp);
-      return;
+    InitFits();
+
+    const unsigned int N = NBinsInto();
+    for(unsigned int n = 0; n < points.size()*N; ++n) arr[n] = 0;
+
+    for(const PredictionPoint& p: points) if(p.shift) CheckSysts(*p.shift);
+
+    // Group together the points with the same oscillation parameters. Those
+    // that can't be identified can still share if they use the same
+    // calculator.
+    struct Group
+    {
+      osc::IOscCalculator* calc;
+      bool keyed;
+      std::string calcKey;
+      std::vector<unsigned int> idxs;
+    };
+    std::vector<Group> groups;
+    std::map<std::pair<const osc::IOscCalculator*, std::string>, unsigned int> groupIdx;
+
+    for(unsigned int i = 0; i < points.size(); ++i){
+      osc::IOscCalculator* calc = points[i].calc;
+      std::string calcKey;
+      const bool keyed = GetOscCalcKey(calc, calcKey);
+
+      const auto key = keyed ? std::make_pair((const osc::IOscCalculator*)0, calcKey) : std::make_pair((const osc::IOscCalculator*)calc, std::string());
+
+      auto it = groupIdx.find(key);
+      if(it == groupIdx.end()){
+        groupIdx.emplace(key, groups.size());
+        groups.push_back({calc, keyed, calcKey, {i}});
+      }
+      else{
+        groups[it->second].idxs.push_back(i);
+      }
+    }
+
+    Component comps[kMaxComponents];
+    const unsigned int nComps = ListComponents(Flavors::kAll, Current::kBoth, Sign::kBoth, comps);
+
+    double nom[N];
+    double comp[N];
+
+    for(const Group& g: groups){
+      for(unsigned int c = 0; c < nComps; ++c){
+        // The oscillated nominal is shared by the whole group
+        for(unsigned int n = 0; n < N; ++n) nom[n] = 0;
+        AddNominalComponentTo(g.calc, g.keyed ? &g.calcKey : 0, comps[c], pot, nom);
+
+        const bool nubar = (fSplitBySign && comps[c].sign == Sign::kAntiNu);
+
+        // Apply each point's shifts while this component's coefficients are
+        // still in cache
+        for(unsigned int i: g.idxs){
+          for(unsigned int n = 0; n < N; ++n) comp[n] = nom[n];
+          ShiftBins(N, comp, comps[c].type, nubar,
+                    points[i].shift ? *points[i].shift : kNoShift);
+
+          double* out = &arr[i*N];
+          for(unsigned int n = 0; n < N; ++n) out[n] += comp[n];
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionInterp::
+  PredictSystAndDerivative(osc::IOscCalculator* calc,
+                           const SystShifts& shift,
+                           double pot,
+                           std::unordered_map<const ISyst*, std::vector<double>>& dp) const
+  {
+    InitFits();
+
+    // Check that we're able to handle all the systs we were passed
+    CheckSysts(shift);
+    for(auto& it: dp) CheckSyst(it.first);
+
+    const unsigned int N = NBinsInto();
+    for(auto& it: dp) it.second.assign(N, 0);
+
+    // Everything that contributes to the prediction, or that we need the
+    // derivative for
+    struct ActiveSyst
+    {
+      const ShiftedPreds* sp;
+      double x;
+      std::vector<double>* diff; ///< Null if not requested
+    };
+    std::vector<ActiveSyst> active;
+    active.reserve(fPreds.size());
+    for(const auto& it: fPreds){
+      const double x = shift.GetShift(it.first);
+      auto dit = dp.find(it.first);
+      if(x == 0 && dit == dp.end()) continue;
+      active.push_back({&it.second, x, dit == dp.end() ? 0 : &dit->second});
     }
 
-    const Spectrum base = PredictComponentSyst(calc, shift, flav, curr, sign);
-    TH1D* h = base.ToTH1(pot);
+    // Derivative of the log of each requested syst's correction
+    std::vector<double> dlog(dp.size()*N);
+
+    DontAddDirectory guard;
+
+    TH1D* h = HistCache::New("", fBinning.Bins1D());
     double* arr = h->GetArray();
-    const unsigned int N = h->GetNbinsX()+2;
 
+    std::string key;
+    const std::string* calcKey = GetOscCalcKey(calc, key) ? &key : 0;
 
-    // Should the interpolation use the nubar fits?
-    const bool nubar = (fSplitBySign && sign == Sign::kAntiNu);
+    Component comps[kMaxComponents];
+    const unsigned int nComps = ListComponents(Flavors::kAll, Current::kBoth, Sign::kBoth, comps);
 
-    for(auto& it: dp){
-      const ISyst* syst = it.first;
-      std::vector<double>& diff = it.second;
-      if(diff.empty()) diff.resize(N);
-      assert(diff.size() == N);
-      assert(fPreds.find(syst) != fPreds.end());
-      const ShiftedPreds& sp = fPreds[syst];
+    double comp[N];
+    double corr[N];
 
-      double x = shift.GetShift(syst);
+    for(unsigned int c = 0; c < nComps; ++c){
+      // The oscillated nominal is evaluated once and serves for both
+      for(unsigned int n = 0; n < N; ++n) comp[n] = 0;
+      AddNominalComponentTo(calc, calcKey, comps[c], pot, comp);
 
-      int shiftBin = (x - sp.shifts[0])/sp.Stride();
-      shiftBin = std::max(0, shiftBin);
-      shiftBin = std::min(shiftBin, sp.nCoeffs-1);
+      const bool nubar = (fSplitBySign && comps[c].sign == Sign::kAntiNu);
 
-      const Coeffs* fits = nubar ? &sp.fitsNubarRemap[type][shiftBin].front() : &sp.fitsRemap[type][shiftBin].front();
+      // Same as ShiftBins, but picking up the derivatives along the way
+      for(unsigned int n = 0; n < N; ++n) corr[n] = 1;
 
-      x -= sp.shifts[shiftBin];
+      unsigned int k = 0;
+      for(const ActiveSyst& a: active){
+        const ShiftedPreds& sp = *a.sp;
+
+        int shiftBin = (a.x - sp.shifts[0])/sp.Stride();
+        shiftBin = std::max(0, shiftBin);
+        shiftBin = std::min(shiftBin, sp.nCoeffs-1);
+
+        const double* __restrict__ A = sp.Packed(nubar, comps[c].type, shiftBin);
+        const double* __restrict__ B = A + sp.binStride;
+        const double* __restrict__ C = B + sp.binStride;
+        const double* __restrict__ D = C + sp.binStride;
+
+        const double x = a.x - sp.shifts[shiftBin];
+
+        if(!a.diff){
+          for(unsigned int n = 0; n < N; ++n){
+            corr[n] *= ((A[n]*x + B[n])*x + C[n])*x + D[n];
+          }
+          continue;
+        }
 
-      const double x_cube = util::cube(x);
-      const double x_sqr = util::sqr(x);
+        double* __restrict__ dl = &dlog[N*k++];
+        for(unsigned int n = 0; n < N; ++n){
+          const double v = ((A[n]*x + B[n])*x + C[n])*x + D[n];
+          // Unshifted systs don't contribute to the prediction itself
+          if(a.x != 0) corr[n] *= v;
+          dl[n] = (v > 0) ? ((3*A[n]*x + 2*B[n])*x + C[n])/v : 0;
+        }
+      } // end for a
 
       for(unsigned int n = 0; n < N; ++n){
-        // Uncomment to debug crashes in this function
-        // assert(type < fits.size());
-        // assert(n < sp.fits[type].size());
-        // assert(shiftBin < int(sp.fits[type][n].size()));
-        const Coeffs& f = fits[n];
-
-        const double corr = f.a*x_cube + f.b*x_sqr + f.c*x + f.d;
-        if(corr > 0) diff[n] += (3*f.a*x_sqr + 2*f.b*x + f.c)/corr*arr[n];
-      } // end for n
-    } // end for syst
+        comp[n] *= std::max(corr[n], 0.);
+        arr[n] += comp[n];
+      }
+
+      // The derivative of the product is the shifted prediction times the
+      // derivative of the log of the one correction that varies
+      k = 0;
+      for(const ActiveSyst& a: active){
+        if(!a.diff) continue;
+        const double* dl = &dlog[N*k++];
+        std::vector<double>& diff = *a.diff;
+        for(unsigned int n = 0; n < N; ++n) diff[n] += dl[n]*comp[n];
+      }
+    } // end for c
 
-    HistCache::Delete(h);
+    return Spectrum(std::unique_ptr<TH1D>(h),
+                    fBinning.GetLabels(), fBinning.GetBinnings(),
+                    pot, fBinning.Livetime());
   }
 
   //----------------------------------------------------------------------
@@ -531,26 +1126,8 @@ namespace ana
              double pot,
              std::unordered_map<const ISyst*, std::vector<double>>& dp) const
   {
-    InitFits();
-
-    // Check that we're able to handle all the systs we were passed
-    for(auto& it: dp){
-      if(fPreds.find(it.first) == fPreds.end()){
-        std::cerr << "This PredictionInterp is not set up to handle the requested systematic: " << it.first->ShortName() << std::endl;
-        abort();
-      }
-      it.second.clear();
-    } // end for syst
-
-    ComponentDerivative(calc, Flavors::kNuEToNuE,    Current::kCC, Sign::kBoth, kNueSurv,  shift, pot, dp);
-    ComponentDerivative(calc, Flavors::kNuEToNuMu,   Current::kCC, Sign::kBoth, kOther,    shift, pot, dp);
-    ComponentDerivative(calc, Flavors::kNuEToNuTau,  Current::kCC, Sign::kBoth, kOther,    shift, pot, dp);
-
-    ComponentDerivative(calc, Flavors::kNuMuToNuE,   Current::kCC, Sign::kBoth, kNueApp,   shift, pot, dp);
-    ComponentDerivative(calc, Flavors::kNuMuToNuMu,  Current::kCC, Sign::kBoth, kNumuSurv, shift, pot, dp);
-    ComponentDerivative(calc, Flavors::kNuMuToNuTau, Current::kCC, Sign::kBoth, kOther,    shift, pot, dp);
-
-    ComponentDerivative(calc, Flavors::kAll, Current::kNC, Sign::kBoth, kNC, shift, pot, dp);
+    // Evaluating the derivatives needs the prediction anyway
+    PredictSystAndDerivative(calc, shift, pot, dp);
 
     // Simpler (much slower) implementation in terms of finite differences for
     // test purposes
@@ -581,10 +1158,95 @@ namespace ana
     */
   }
 
+  //----------------------------------------------------------------------
+  void PredictionInterp::
+  SecondDerivative(osc::IOscCalculator* calc,
+                   const SystShifts& shift,
+                   double pot,
+                   const std::vector<const ISyst*>& systs,
+                   std::vector<std::vector<double>>& d2p) const
+  {
+    InitFits();
+
+    CheckSysts(shift);
+    for(const ISyst* s: systs) CheckSyst(s);
+
+    const unsigned int N = NBinsInto();
+    const unsigned int S = systs.size();
+    d2p.assign(S*S, std::vector<double>(N, 0));
+
+    // The shifted prediction is the nominal times a product of one
+    // correction per syst. Each syst's correction only depends on its own
+    // shift, so the off-diagonal terms are the shifted prediction times the
+    // two first log-derivatives, and the diagonal terms the shifted
+    // prediction times v''/v.
+    std::vector<double> dlog(S*N), d2rel(S*N);
+
+    std::string key;
+    const std::string* calcKey = GetOscCalcKey(calc, key) ? &key : 0;
+
+    Component comps[kMaxComponents];
+    const unsigned int nComps = ListComponents(Flavors::kAll, Current::kBoth, Sign::kBoth, comps);
+
+    double comp[N];
+
+    for(unsigned int c = 0; c < nComps; ++c){
+      for(unsigned int n = 0; n < N; ++n) comp[n] = 0;
+      AddNominalComponentTo(calc, calcKey, comps[c], pot, comp);
+
+      const bool nubar = (fSplitBySign && comps[c].sign == Sign::kAntiNu);
+
+      ShiftBins(N, comp, comps[c].type, nubar, shift);
+
+      for(unsigned int i = 0; i < S; ++i){
+        const ShiftedPreds& sp = fPreds.find(systs[i])->second;
+        const double xs = shift.GetShift(systs[i]);
+
+        int shiftBin = (xs - sp.shifts[0])/sp.Stride();
+        shiftBin = std::max(0, shiftBin);
+        shiftBin = std::min(shiftBin, sp.nCoeffs-1);
+
+        const double* __restrict__ A = sp.Packed(nubar, comps[c].type, shiftBin);
+        const double* __restrict__ B = A + sp.binStride;
+        const double* __restrict__ C = B + sp.binStride;
+        const double* __restrict__ D = C + sp.binStride;
+
+        const double x = xs - sp.shifts[shiftBin];
+
+        double* __restrict__ dl = &dlog[N*i];
+        double* __restrict__ d2 = &d2rel[N*i];
+        for(unsigned int n = 0; n < N; ++n){
+          const double v = ((A[n]*x + B[n])*x + C[n])*x + D[n];
+          dl[n] = (v > 0) ? ((3*A[n]*x + 2*B[n])*x + C[n])/v : 0;
+          d2[n] = (v > 0) ? (6*A[n]*x + 2*B[n])/v : 0;
+        }
+      } // end for i
+
+      for(unsigned int i = 0; i < S; ++i){
+        const double* dli = &dlog[N*i];
+
+        std::vector<double>& diag = d2p[i*S+i];
+        const double* d2 = &d2rel[N*i];
+        for(unsigned int n = 0; n < N; ++n) diag[n] += d2[n]*comp[n];
+
+        for(unsigned int j = i+1; j < S; ++j){
+          const double* dlj = &dlog[N*j];
+          std::vector<double>& off = d2p[i*S+j];
+          for(unsigned int n = 0; n < N; ++n) off[n] += dli[n]*dlj[n]*comp[n];
+        }
+      } // end for i
+    } // end for c
+
+    // Fill in the other triangle
+    for(unsigned int i = 0; i < S; ++i)
+      for(unsigned int j = i+1; j < S; ++j) d2p[j*S+i] = d2p[i*S+j];
+  }
+
   //----------------------------------------------------------------------
   void PredictionInterp::SaveTo(TDirectory* dir) const
   {
     InitFits();
+    LoadAllLazy();
 
     TDirectory* tmp = gDirectory;
 
@@ -600,7 +1262,7 @@ namespace ana
 
       for(unsigned int i = 0; i < sp.shifts.size(); ++i){
         if(!sp.preds[i]){
-          std::cout << "Can't save a PredictionInterp after MinimizeMemory()" << std::endl;
+          std::cout << "Can't save a PredictionInterp after MinimizeMemory() or a fit-only load" << std::endl;
           abort();
         }
         sp.preds[i]->SaveTo(dir->mkdir(TString::Format("pred_%s_%+d",
@@ -611,6 +1273,18 @@ namespace ana
 
     ana::SaveTo(*fOscOrigin, dir->mkdir("osc_origin"));
 
+    // The fitted coefficients too, so that later jobs don't have to refit,
+    // and can skip loading the shifted predictions entirely
+    for(auto it: fPreds){
+      const ShiftedPreds& sp = it.second;
+
+      TDirectory* coeffDir = dir->mkdir(TString::Format("coeffs_%s", sp.systName.c_str()));
+      coeffDir->cd();
+      TVectorD(sp.shifts.size(), &sp.shifts[0]).Write("shifts");
+      FlattenCoeffs(sp.fits).Write("fits");
+      if(fSplitBySign) FlattenCoeffs(sp.fitsNubar).Write("fits_nubar");
+    }
+
     if(!fPreds.empty()){
       TH1F hSystNames("syst_names", ";Syst names", fPreds.size(), 0, fPreds.size());
       int binIdx = 1;
@@ -628,8 +1302,75 @@ namespace ana
     tmp->cd();
   }
 
+  //----------------------------------------------------------------------
+  TVectorD PredictionInterp::
+  FlattenCoeffs(const std::vector<std::vector<std::vector<Coeffs>>>& fits)
+  {
+    // [type][histogram bin][shift bin][a,b,c,d], with the dimensions up front
+    // Nothing fit (yet) is written as zero-sized, which UnflattenCoeffs
+    // reads back the same way
+    const unsigned int nTypes = fits.size();
+    const unsigned int nBins = fits.empty() ? 0 : fits[0].size();
+    const unsigned int nShiftBins = nBins == 0 ? 0 : fits[0][0].size();
+
+    TVectorD ret(3 + nTypes*nBins*nShiftBins*4);
+    ret[0] = nTypes;
+    ret[1] = nBins;
+    ret[2] = nShiftBins;
+
+    int i = 3;
+    for(const auto& type: fits){
+      for(const auto& bin: type){
+        for(const Coeffs& c: bin){
+          ret[i++] = c.a;
+          ret[i++] = c.b;
+          ret[i++] = c.c;
+          ret[i++] = c.d;
+        }
+      }
+    }
+
+    return ret;
+  }
+
+  //----------------------------------------------------------------------
+  std::vector<std::vector<std::vector<PredictionInterp::Coeffs>>>
+  PredictionInterp::UnflattenCoeffs(const TVectorD& v)
+  {
+    const unsigned int nTypes = v[0];
+    const unsigned int nBins = v[1];
+    const unsigned int nShiftBins = v[2];
+    assert(v.GetNrows() == int(3 + nTypes*nBins*nShiftBins*4));
+
+    std::vector<std::vector<std::vector<Coeffs>>> ret(nTypes);
+
+    int i = 3;
+    for(auto& type: ret){
+      type.resize(nBins);
+      for(auto& bin: type){
+        bin.reserve(nShiftBins);
+        for(unsigned int k = 0; k < nShiftBins; ++k){
+          bin.emplace_back(v[i], v[i+1], v[i+2], v[i+3]);
+          i += 4;
+        }
+      }
+    }
+
+    return ret;
+  }
+
   //----------------------------------------------------------------------
   std::unique_ptr<PredictionInterp> PredictionInterp::LoadFrom(TDirectory* dir)
+  {
+    ELoadMode mode = kLoadAll;
+    if(getenv("CAFANA_PREDINTERP_FIT_ONLY")) mode = kFitOnly;
+    if(getenv("CAFANA_PREDINTERP_LAZY")) mode = kLazy;
+    return LoadFrom(dir, mode);
+  }
+
+  //----------------------------------------------------------------------
+  std::unique_ptr<PredictionInterp> PredictionInterp::LoadFrom(TDirectory* dir,
+                                                               ELoadMode mode)
   {
     TObjString* tag = (TObjString*)dir->Get("type");
     assert(tag);
@@ -638,21 +1379,40 @@ namespace ana
 
     std::unique_ptr<PredictionInterp> ret(new PredictionInterp);
 
-    LoadFromBody(dir, ret.get());
-
     TObjString* split_sign = (TObjString*)dir->Get("split_sign");
     // Can be missing from old files
     ret->fSplitBySign = (split_sign && split_sign->String() == "yes");
 
+    LoadFromBody(dir, ret.get(), {}, mode);
+
     return ret;
   }
 
   //----------------------------------------------------------------------
   void PredictionInterp::LoadFromBody(TDirectory* dir, PredictionInterp* ret,
-				      std::vector<const ISyst*> veto)
+				      std::vector<const ISyst*> veto,
+                                      ELoadMode mode)
   {
     ret->fPredNom = ana::LoadFrom<IPrediction>(dir->GetDirectory("pred_nom"));
 
+    // Remember where to come back to for the systs
+    if(mode == kLazy){
+      TFile* f = dir->GetFile();
+      if(f){
+        ret->fLazyFile = f->GetName();
+        // Path within the file, after the "filename:/"
+        const std::string path = dir->GetPath();
+        ret->fLazyDir = path.substr(path.rfind(':')+1);
+        while(!ret->fLazyDir.empty() && ret->fLazyDir[0] == '/') ret->fLazyDir.erase(0, 1);
+      }
+      else{
+        std::cout << "PredictionInterp: " << dir->GetName() << " isn't in a "
+                  << "file, can't load it lazily. Loading everything now."
+                  << std::endl;
+        mode = kLoadAll;
+      }
+    }
+
     TH1* hSystNames = (TH1*)dir->Get("syst_names");
     if(hSystNames){
       for(int systIdx = 0; systIdx < hSystNames->GetNbinsX(); ++systIdx){
@@ -663,28 +1423,97 @@ namespace ana
 
         if(std::find(veto.begin(), veto.end(), syst) != veto.end()) continue;
 
-        // Use whichever of these gives the most restrictive range
-        const int x0 = std::max(-syst->PredInterpMaxNSigma(), int(trunc(syst->Min())));
-        const int x1 = std::min(+syst->PredInterpMaxNSigma(), int(trunc(syst->Max())));
-
-        for(int shift = x0; shift <= x1; ++shift){
-          TDirectory* preddir = dir->GetDirectory(TString::Format("pred_%s_%+d", sp.systName.c_str(), shift).Data());
-          if(!preddir){
-            std::cout << "PredictionInterp: " << syst->ShortName() << " " << shift << " sigma " << " not found in " << dir->GetName() << std::endl;
-            continue;
-          }
-
-          IPrediction* pred = ana::LoadFrom<IPrediction>(preddir).release();
-
-          sp.shifts.push_back(shift);
-          sp.preds.push_back(pred);
-        } // end for shift
+        if(mode == kLazy){
+          // Read on first use, in CheckSyst()
+          sp.ready = false;
+        }
+        else{
+          LoadSystFromBody(dir, ret, syst, sp, mode);
+        }
 
         ret->fPreds.emplace(syst, sp);
       } // end for systIdx
     } // end if hSystNames
 
     ret->fOscOrigin = ana::LoadFrom<osc::IOscCalculator>(dir->GetDirectory("osc_origin")).release();
+    ret->fOscTally.Set(0, 1);
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionInterp::LoadSystFromBody(TDirectory* dir,
+                                          const PredictionInterp* ret,
+                                          const ISyst* syst,
+                                          ShiftedPreds& sp,
+                                          ELoadMode mode)
+  {
+    // Stored coefficients, if this file has them
+    std::vector<double> storedShifts;
+    TDirectory* coeffDir = dir->GetDirectory(TString::Format("coeffs_%s", sp.systName.c_str()));
+    // Lazy loads are for fits, so take the coefficients when we can
+    const bool fitOnly = (mode == kFitOnly || (mode == kLazy && coeffDir));
+    if(coeffDir){
+      TVectorD* shifts = (TVectorD*)coeffDir->Get("shifts");
+      TVectorD* fits = (TVectorD*)coeffDir->Get("fits");
+      TVectorD* fitsNubar = (TVectorD*)coeffDir->Get("fits_nubar");
+      assert(shifts && fits);
+      assert(fitsNubar || !ret->fSplitBySign);
+
+      sp.fits = UnflattenCoeffs(*fits);
+      if(fitsNubar) sp.fitsNubar = UnflattenCoeffs(*fitsNubar);
+
+      for(int i = 0; i < shifts->GetNrows(); ++i) storedShifts.push_back((*shifts)[i]);
+
+      if(fitOnly){
+        // The coefficients are all we need. Keep the shifts they were
+        // fitted with, and leave the shifted predictions unloaded, as if
+        // after MinimizeMemory().
+        sp.shifts = storedShifts;
+        for(double shift: sp.shifts)
+          sp.preds.push_back(shift == 0 ? ret->fPredNom.get() : 0);
+      }
+
+      delete shifts;
+      delete fits;
+      delete fitsNubar;
+
+      if(fitOnly) return;
+    }
+    else if(mode == kFitOnly){
+      std::cout << "PredictionInterp: fit-only load requested, but "
+                << dir->GetName() << " has no stored coefficients for "
+                << sp.systName << ". Resave it, or load normally."
+                << std::endl;
+      abort();
+    }
+
+    // Use whichever of these gives the most restrictive range
+    const int x0 = std::max(-syst->PredInterpMaxNSigma(), int(trunc(syst->Min())));
+    const int x1 = std::min(+syst->PredInterpMaxNSigma(), int(trunc(syst->Max())));
+
+    for(int shift = x0; shift <= x1; ++shift){
+      TDirectory* preddir = dir->GetDirectory(TString::Format("pred_%s_%+d", sp.systName.c_str(), shift).Data());
+      // Templates that CollapseFits decided weren't needed
+      if(!preddir && !storedShifts.empty() &&
+         std::find(storedShifts.begin(), storedShifts.end(), shift) == storedShifts.end()) continue;
+      if(!preddir){
+        std::cout << "PredictionInterp: " << syst->ShortName() << " " << shift << " sigma " << " not found in " << dir->GetName() << std::endl;
+        continue;
+      }
+
+      IPrediction* pred = ana::LoadFrom<IPrediction>(preddir).release();
+
+      sp.shifts.push_back(shift);
+      sp.preds.push_back(pred);
+    } // end for shift
+
+    // Only trust stored coefficients that were fit to the same templates
+    if(!sp.fits.empty() && sp.shifts != storedShifts){
+      std::cout << "PredictionInterp: stored coefficients for "
+                << sp.systName << " don't match the shifted predictions, "
+                << "will refit" << std::endl;
+      sp.fits.clear();
+      sp.fitsNubar.clear();
+    }
   }
 
   //----------------------------------------------------------------------
@@ -725,6 +1554,7 @@ namespace ana
                 << syst->ShortName() << " not found" << std::endl;
       return;
     }
+    CheckSyst(syst); // make sure it's loaded
 
     std::unique_ptr<TH1> nom(fPredNom->PredictComponent(calc, flav, curr, sign).ToTH1(18e20));
     const int nbins = nom->GetNbinsX();
@@ -3,14 +3,22 @@
 #include "CAFAna/Prediction/IPrediction.h"
 #include "CAFAna/Prediction/PredictionGenerator.h"
 
+#include "CAFAna/Core/BoundedCache.h"
+#include "CAFAna/Core/MemoryTally.h"
 #include "CAFAna/Core/SpectrumLoader.h"
 #include "CAFAna/Core/SystShifts.h"
+#include "CAFAna/Core/Utilities.h"
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 
 #include "TMD5.h"
+#include "TVectorD.h"
 
 class TH1;
 
@@ -52,6 +60,36 @@ namespace ana
     virtual Spectrum PredictSyst(osc::IOscCalculator* calc,
                                  const SystShifts& shift) const override;
 
+    /// \brief Allocation-free equivalent of \ref PredictSyst
+    ///
+    /// Overwrites \a arr with the shifted prediction scaled to \a pot. \a arr
+    /// is owned by the caller and must hold \ref NBinsInto entries, laid out
+    /// as TH1::GetArray(), ie including underflow and overflow. So long as the
+    /// nominal components are already cached for this oscillation point, no
+    /// Spectrum or histogram is created.
+    void PredictSystInto(osc::IOscCalculator* calc,
+                         const SystShifts& shift,
+                         double pot,
+                         double* arr) const;
+
+    /// Size of the array \ref PredictSystInto expects
+    unsigned int NBinsInto() const {InitFits(); return fNBinsInto;}
+
+    /// \brief Evaluates the oscillated nominal once for each distinct set of
+    /// oscillation parameters among \a points, and applies all the shifts
+    /// for one component before moving on to the next
+    virtual std::vector<Spectrum>
+    PredictSystBatch(const std::vector<PredictionPoint>& points) const override;
+
+    /// \brief Allocation-light equivalent of \ref PredictSystBatch
+    ///
+    /// Overwrites \a arr with the predictions for each of \a points, scaled
+    /// to \a pot. \a arr must hold points.size() times \ref NBinsInto
+    /// entries, and the predictions are laid out one after another.
+    void PredictSystBatchInto(const std::vector<PredictionPoint>& points,
+                              double pot,
+                              double* arr) const;
+
     virtual Spectrum PredictComponent(osc::IOscCalculator* calc,
                                       Flavors::Flavors_t flav,
                                       Current::Current_t curr,
@@ -62,13 +100,65 @@ namespace ana
                                           Current::Current_t curr,
                                           Sign::Sign_t sign) const override;
 
+    virtual void AddComponentTo(osc::IOscCalculator* calc,
+                                Flavors::Flavors_t flav,
+                                Current::Current_t curr,
+                                Sign::Sign_t sign,
+                                double pot,
+                                double* arr) const override;
+    virtual void AddComponentSystTo(osc::IOscCalculator* calc,
+                                    const SystShifts& shift,
+                                    Flavors::Flavors_t flav,
+                                    Current::Current_t curr,
+                                    Sign::Sign_t sign,
+                                    double pot,
+                                    double* arr) const override;
+
     virtual void Derivative(osc::IOscCalculator* calc,
                             const SystShifts& shift,
                             double pot,
                             std::unordered_map<const ISyst*, std::vector<double>>& dp) const override;
 
+    /// Shares the oscillated nominals and the coefficient lookups between
+    /// the prediction and its derivatives
+    virtual Spectrum PredictSystAndDerivative(osc::IOscCalculator* calc,
+                                              const SystShifts& shift,
+                                              double pot,
+                                              std::unordered_map<const ISyst*, std::vector<double>>& dp) const override;
+
+    /// Exact, given the spline parameterization of each syst's response
+    virtual void SecondDerivative(osc::IOscCalculator* calc,
+                                  const SystShifts& shift,
+                                  double pot,
+                                  const std::vector<const ISyst*>& systs,
+                                  std::vector<std::vector<double>>& d2p) const override;
+
+    /// Includes the fitted spline coefficients, see \ref kFitOnly
     virtual void SaveTo(TDirectory* dir) const override;
+
+    enum ELoadMode{
+      kLoadAll, ///< Everything, so we can refit, save, or draw debug plots
+      /// \brief Only the nominal and the stored coefficients
+      ///
+      /// Skips all the shifted predictions, which are most of the file. The
+      /// result can predict and fit but, like after \ref MinimizeMemory, it
+      /// can't be saved or refit.
+      kFitOnly,
+      /// \brief Only the nominal and the list of systs up front
+      ///
+      /// Each syst is read the first time it's shifted or has its derivative
+      /// asked for, so fits that only float a few of them don't pay for the
+      /// rest. Reads the coefficients where the file has them, as \ref
+      /// kFitOnly, and the shifted predictions otherwise. The file is reopened
+      /// by name for each read, so needn't be kept open.
+      kLazy
+    };
+
+    /// \brief The mode is kLoadAll unless CAFANA_PREDINTERP_FIT_ONLY or
+    /// CAFANA_PREDINTERP_LAZY is set
     static std::unique_ptr<PredictionInterp> LoadFrom(TDirectory* dir);
+    static std::unique_ptr<PredictionInterp> LoadFrom(TDirectory* dir,
+                                                      ELoadMode mode);
 
     /// After calling this DebugPlots won't work fully and SaveTo won't work at
     /// all.
@@ -112,7 +202,8 @@ namespace ana
     PredictionInterp() : fBinning(0, {}, {}, 0, 0) {}
 
     static void LoadFromBody(TDirectory* dir, PredictionInterp* ret,
-			     std::vector<const ISyst*> veto = {});
+			     std::vector<const ISyst*> veto = {},
+                             ELoadMode mode = kLoadAll);
 
     struct Coeffs{
       Coeffs(double _a, double _b, double _c, double _d)
@@ -120,33 +211,84 @@ namespace ana
       double a, b, c, d;
     };
 
-    /// Find coefficients describing this set of shifts
-    std::vector<std::vector<Coeffs>>
+    /// \brief Find coefficients describing this set of shifts
+    ///
+    /// \a ratios is indexed [shift][bin]. Depends only on its arguments, so
+    /// is safe to call from multiple threads at once
+    static std::vector<std::vector<Coeffs>>
     FitRatios(const std::vector<double>& shifts,
-              const std::vector<std::unique_ptr<TH1>>& ratios) const;
-
-    /// Find coefficients describing the ratios from this component
-    std::vector<std::vector<Coeffs>>
-    FitComponent(const std::vector<double>& shifts,
-                 const std::vector<IPrediction*>& preds,
-                 Flavors::Flavors_t flav,
-                 Current::Current_t curr,
-                 Sign::Sign_t sign,
-                 const std::string& systName) const;
+              const std::vector<std::vector<double>>& ratios);
+
+    /// \brief Ratios of each shifted prediction of this component to the
+    /// nominal, indexed [shift][bin], ready for \ref FitRatios
+    std::vector<std::vector<double>>
+    ComponentRatios(osc::IOscCalculator* calc,
+                    const std::vector<double>& shifts,
+                    const std::vector<IPrediction*>& preds,
+                    Flavors::Flavors_t flav,
+                    Current::Current_t curr,
+                    Sign::Sign_t sign,
+                    const std::string& systName) const;
 
     Spectrum ShiftSpectrum(const Spectrum& s,
                            CoeffsType type,
                            bool nubar, // try to use fitsNubar if it exists
                            const SystShifts& shift) const;
 
-    /// Helper for PredictComponentSyst
-    Spectrum ShiftedComponent(osc::IOscCalculator* calc,
-                              const TMD5* hash,
-                              const SystShifts& shift,
-                              Flavors::Flavors_t flav,
-                              Current::Current_t curr,
-                              Sign::Sign_t sign,
-                              CoeffsType type) const;
+    /// Apply the interpolated shifts to the \a N bins of \a arr in-place
+    void ShiftBins(unsigned int N,
+                   double* arr,
+                   CoeffsType type,
+                   bool nubar, // try to use fitsNubar if it exists
+                   const SystShifts& shift) const;
+
+    /// One separately-interpolated piece of a prediction
+    struct Component
+    {
+      Flavors::Flavors_t flav;
+      Current::Current_t curr;
+      Sign::Sign_t sign;
+      CoeffsType type;
+    };
+    /// Most there can be: six CC flavours plus NC, for each sign
+    static const unsigned int kMaxComponents = 14;
+
+    /// \brief Break down the requested flavours, currents and signs into the
+    /// pieces the coefficients describe
+    ///
+    /// \a ret must have room for \ref kMaxComponents entries
+    /// \return How many components were written
+    unsigned int ListComponents(Flavors::Flavors_t flav,
+                                Current::Current_t curr,
+                                Sign::Sign_t sign,
+                                Component* ret) const;
+
+    /// \brief Abort if \a syst isn't one we know about. Read it from file
+    /// first if this is its first use, see \ref kLazy
+    void CheckSyst(const ISyst* syst) const;
+
+    /// Abort if \a shift contains any systs we don't know about
+    void CheckSysts(const SystShifts& shift) const;
+
+    /// \brief Adds the unshifted component, scaled to \a pot, into \a arr,
+    /// making use of the nominal cache where possible
+    void AddNominalComponentTo(osc::IOscCalculator* calc,
+                               const std::string* calcKey,
+                               const Component& comp,
+                               double pot,
+                               double* arr) const;
+
+    /// \brief Helper for AddComponentSystTo
+    ///
+    /// Adds the shifted component, scaled to \a pot, into the \a N bins of
+    /// \a arr
+    void AddShiftedComponentTo(osc::IOscCalculator* calc,
+                               const std::string* calcKey,
+                               const SystShifts& shift,
+                               const Component& comp,
+                               double pot,
+                               unsigned int N,
+                               double* arr) const;
 
     std::unique_ptr<IPrediction> fPredNom; ///< The nominal prediction
 
@@ -160,15 +302,47 @@ namespace ana
 
       int nCoeffs; // Faster than calling size()
 
+      /// \brief Highest power of x in any of the coefficients
+      ///
+      /// Less than three for systs \ref CollapseFits found to respond
+      /// linearly or quadratically, which lets \ref ShiftBins skip the
+      /// higher terms
+      int degree = 3;
+
       /// Indices: [type][histogram bin][shift bin]
       std::vector<std::vector<std::vector<Coeffs>>> fits;
       /// Will be filled if signs are separated, otherwise not
       std::vector<std::vector<std::vector<Coeffs>>> fitsNubar;
 
-      // Same info as above but with more-easily-iterable index order
-      // [type][shift bin][histogram bin]. TODO this is ugly
-      std::vector<std::vector<std::vector<Coeffs>>> fitsRemap;
-      std::vector<std::vector<std::vector<Coeffs>>> fitsNubarRemap;
+      /// \brief The same coefficients as \ref fits and \ref fitsNubar, packed
+      /// for evaluation
+      ///
+      /// Structure-of-arrays, indexed [type][shift bin][a,b,c,d][histogram
+      /// bin]. Each run of bins is \ref binStride long and starts on a cache
+      /// line, so the per-bin loops vectorise. Use \ref Packed to index.
+      std::vector<double, AlignedAllocator<double>> packed, packedNubar;
+      unsigned int binStride;
+
+      /// \brief Whether the coefficients are ready to use. False until first
+      /// use after a \ref kLazy load.
+      ///
+      /// Checked on every evaluation, so is atomic rather than relying on a
+      /// lock. Copies take the current value.
+      struct ReadyFlag
+      {
+        ReadyFlag(bool r = true) : val(r) {}
+        ReadyFlag(const ReadyFlag& f) : val(f.val.load()) {}
+        ReadyFlag& operator=(const ReadyFlag& f) {val = f.val.load(); return *this;}
+        std::atomic<bool> val;
+      };
+      ReadyFlag ready;
+
+      /// Start of the a coefficients, followed by b, c and d at multiples of
+      /// \ref binStride
+      const double* Packed(bool nubar, int type, int shiftBin) const
+      {
+        return &(nubar ? packedNubar : packed)[(type*nCoeffs + shiftBin)*4*binStride];
+      }
     };
 
   protected:
@@ -177,43 +351,124 @@ namespace ana
     /// The oscillation values we assume when evaluating the coefficients
     osc::IOscCalculator* fOscOrigin;
 
-    mutable Spectrum fBinning; ///< Dummy spectrum to provide binning
+    /// Dummy spectrum to provide binning. Only written by \ref InitFits
+    mutable Spectrum fBinning;
+    /// Size of \ref fBinning including under and overflow, set by \ref InitFits
+    mutable unsigned int fNBinsInto = 0;
 
-    struct Key_t
+    /// The nominal is cached per component and oscillation parameters
+    struct NomKey_t
     {
       Flavors::Flavors_t flav;
       Current::Current_t curr;
       Sign::Sign_t sign;
-      bool operator<(const Key_t& rhs) const
+      std::string hash; ///< From \ref GetOscCalcKey
+      bool operator==(const NomKey_t& rhs) const
       {
-        return (std::make_tuple(flav, curr, sign) <
-                std::make_tuple(rhs.flav, rhs.curr, rhs.sign));
+        return (std::make_tuple(flav, curr, sign, hash) ==
+                std::make_tuple(rhs.flav, rhs.curr, rhs.sign, rhs.hash));
       }
     };
-    struct Val_t
+    struct NomKeyHash
     {
-      TMD5 hash;
-      Spectrum nom;
+      size_t operator()(const NomKey_t& k) const
+      {
+        return std::hash<std::string>()(k.hash) ^ (size_t(k.flav) << 8) ^
+          (size_t(k.curr) << 16) ^ (size_t(k.sign) << 20);
+      }
     };
-    mutable std::map<Key_t, Val_t> fNomCache;
+    /// \brief Safe to use from multiple threads at once
+    ///
+    /// The size is set by CAFANA_PREDINTERP_NOMCACHE_SIZE (default 256)
+    mutable BoundedCache<NomKey_t, Spectrum, NomKeyHash> fNomCache{NomCacheSize()};
+    static unsigned int NomCacheSize();
+
+    /// Accounts for all the coefficients in fPreds
+    mutable MemoryTally::Handle fCoeffTally{MemoryTally::kSplineCoeffs};
+    /// Accounts for fOscOrigin
+    MemoryTally::Handle fOscTally{MemoryTally::kCalculators};
 
     bool fSplitBySign;
 
+    /// Evaluates the coefficients on first use. Safe to call from multiple
+    /// threads
     void InitFits() const;
+    mutable std::mutex fInitMutex;
+    /// Set once InitFits has completed, so later calls needn't lock
+    mutable std::atomic<bool> fFitsReady{false};
+
+    /// Where to find the systs still to be read after a \ref kLazy load
+    std::string fLazyFile, fLazyDir;
+
+    /// Read \a syst from fLazyFile and fit it if necessary
+    void LoadLazySyst(const ISyst* syst, ShiftedPreds& sp) const;
+    /// For operations that need every syst
+    void LoadAllLazy() const;
+
+    /// One component of one syst, yet to be evaluated and fit
+    struct PendingFit
+    {
+      const ShiftedPreds* sp;
+      Flavors::Flavors_t flav;
+      Current::Current_t curr;
+      Sign::Sign_t sign;
+      std::vector<std::vector<Coeffs>>* fits; ///< Where to put the result
+    };
 
+    /// Queue the components of \a sp for fitting into \a fits
     void InitFitsHelper(ShiftedPreds& sp,
                         std::vector<std::vector<std::vector<Coeffs>>>& fits,
-                        Sign::Sign_t sign) const;
-
-     /// Helper for \ref Derivative
-    void ComponentDerivative(osc::IOscCalculator* calc,
-                             Flavors::Flavors_t flav,
-                             Current::Current_t curr,
-                             Sign::Sign_t sign,
-                             CoeffsType type,
-                             const SystShifts& shift,
-                             double pot,
-                             std::unordered_map<const ISyst*, std::vector<double>>& dp) const;
+                        Sign::Sign_t sign,
+                        std::vector<PendingFit>& pending) const;
+
+    /// \brief Task for the thread pool in \ref InitFits. Evaluates the
+    /// ratios of \a job with its own copy of \ref fOscOrigin and fits them
+    void FitPending(PendingFit* job) const;
+    /// Fit all of \a pending, serially unless CAFANA_PREDINTERP_THREADS is
+    /// set (zero for one thread per core)
+    void RunPending(std::vector<PendingFit>& pending) const;
+
+    /// \brief If every component of \a sp is one linear or quadratic
+    /// function of the shift, replace its splines by that single polynomial
+    ///
+    /// Only the three templates needed to reproduce it are kept. The
+    /// tolerance on the ratios is CAFANA_PREDINTERP_POLY_TOL. Off unless
+    /// that is set to something positive.
+    void CollapseFits(ShiftedPreds& sp) const;
+
+    /// \brief Lowest degree of polynomial in the shift that describes every
+    /// bin of \a fits to within \a tol at the knots
+    ///
+    /// \param poly Filled with the constant, linear and quadratic terms for
+    ///             each bin, in absolute sigma
+    /// \return 3 if no single quadratic will do
+    static int PolyDegree(const std::vector<double>& shifts,
+                          const std::vector<std::vector<Coeffs>>& fits,
+                          double tol,
+                          std::vector<std::array<double, 3>>& poly);
+
+    /// Fill the packed coefficients of \a sp from its fits
+    void PackFits(ShiftedPreds& sp) const;
+    /// Account for the coefficients of all the loaded systs
+    void UpdateCoeffTally() const;
+
+    /// \brief Read the coefficients and/or the shifted predictions for \a
+    /// syst from \a dir into \a sp
+    ///
+    /// Needs \a ret's nominal already loaded
+    static void LoadSystFromBody(TDirectory* dir, const PredictionInterp* ret,
+                                 const ISyst* syst, ShiftedPreds& sp,
+                                 ELoadMode mode);
+
+    /// For storing fits and fitsNubar in a file
+    static TVectorD FlattenCoeffs(const std::vector<std::vector<std::vector<Coeffs>>>& fits);
+    static std::vector<std::vector<std::vector<Coeffs>>> UnflattenCoeffs(const TVectorD& v);
+
+    /// Fill \a packed from \a fits, in the layout described by \ref
+    /// ShiftedPreds::packed
+    static void PackCoeffs(const std::vector<std::vector<std::vector<Coeffs>>>& fits,
+                           unsigned int binStride,
+                           std::vector<double, AlignedAllocator<double>>& packed);
   };
 
 }
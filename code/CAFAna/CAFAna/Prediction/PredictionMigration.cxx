@@ -0,0 +1,368 @@
+#include "CAFAna/Prediction/PredictionMigration.h"
+
+#include "CAFAna/Core/HistCache.h"
+#include "CAFAna/Core/LoadFromFile.h"
+#include "CAFAna/Core/Loaders.h"
+#include "CAFAna/Core/SystRegistry.h"
+#include "CAFAna/Core/Utilities.h"
+
+#include "OscLib/func/IOscCalculator.h"
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TObjString.h"
+#include "TVectorD.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+namespace ana
+{
+  const PredictionMigration::Component
+  PredictionMigration::kComponents[PredictionMigration::kNComponents] = {
+    {Flavors::kNuMuToNuE,  Current::kCC, Sign::kNu},
+    {Flavors::kNuEToNuE,   Current::kCC, Sign::kNu},
+    {Flavors::kNuMuToNuMu, Current::kCC, Sign::kNu},
+    {Flavors::kNuEToNuMu | Flavors::kAllNuTau, Current::kCC, Sign::kNu},
+    {Flavors::kNuMuToNuE,  Current::kCC, Sign::kAntiNu},
+    {Flavors::kNuEToNuE,   Current::kCC, Sign::kAntiNu},
+    {Flavors::kNuMuToNuMu, Current::kCC, Sign::kAntiNu},
+    {Flavors::kNuEToNuMu | Flavors::kAllNuTau, Current::kCC, Sign::kAntiNu},
+    {Flavors::kAll, Current::kNC, Sign::kBoth}
+  };
+
+  //----------------------------------------------------------------------
+  PredictionMigration::PredictionMigration(std::unique_ptr<IPrediction> base,
+                                           SpectrumLoaderBase& loaderNonswap,
+                                           SpectrumLoaderBase& loaderNue,
+                                           SpectrumLoaderBase& loaderNuTau,
+                                           const HistAxis& axis,
+                                           const Cut& cut,
+                                           const std::vector<const ISyst*>& systs,
+                                           osc::IOscCalculator* osc,
+                                           const SystShifts& shiftMC,
+                                           const Var& wei)
+    : fBase(std::move(base)),
+      fOscOrigin(osc->Copy()),
+      fSystList(systs),
+      fBinning(0, {}, {}, 0, 0)
+  {
+    fEvents = std::make_unique<PredictionEventList>(loaderNonswap,
+                                                    loaderNue,
+                                                    loaderNuTau,
+                                                    axis, cut, systs,
+                                                    shiftMC, wei);
+  }
+
+  //----------------------------------------------------------------------
+  PredictionMigration::PredictionMigration(std::unique_ptr<IPrediction> base,
+                                           Loaders& loaders,
+                                           const HistAxis& axis,
+                                           const Cut& cut,
+                                           const std::vector<const ISyst*>& systs,
+                                           osc::IOscCalculator* osc,
+                                           const SystShifts& shiftMC,
+                                           const Var& wei)
+    : PredictionMigration(std::move(base),
+                          loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNonSwap),
+                          loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNueSwap),
+                          loaders.GetLoader(caf::kFARDET, Loaders::kMC, ana::kBeam, Loaders::kNuTauSwap),
+                          axis, cut, systs, osc, shiftMC, wei)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  PredictionMigration::PredictionMigration(std::unique_ptr<IPrediction> base)
+    : fBase(std::move(base)),
+      fBinning(0, {}, {}, 0, 0)
+  {
+  }
+
+  //----------------------------------------------------------------------
+  PredictionMigration::~PredictionMigration()
+  {
+  }
+
+  //----------------------------------------------------------------------
+  std::vector<const ISyst*> PredictionMigration::GetAllSysts() const
+  {
+    return fSystList;
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionMigration::InitMatrices() const
+  {
+    if(fReady.load(std::memory_order_acquire)) return;
+
+    // If several threads get here at once, only the first does the work
+    std::lock_guard<std::mutex> lock(fInitMutex);
+    if(fReady.load(std::memory_order_acquire)) return;
+
+    // Predict something, anything, so that we can know what binning to use
+    fBinning = fBase->PredictUnoscillated();
+    fBinning.Clear();
+    // Settled here, under the lock, so the const predict functions never
+    // have to modify it
+    if(fBinning.POT()==0) fBinning.OverridePOT(1e24);
+
+    const unsigned int N = fBinning.Bins1D().NBins()+2;
+
+    if(fEvents){
+      // Which component each of the event lists' channels belongs to
+      int chanComps[EventList::kNChannels];
+      for(int chan = 0; chan < EventList::kNChannels; ++chan){
+        chanComps[chan] = -1;
+        for(unsigned int c = 0; c < kNComponents; ++c){
+          const Component& comp = kComponents[c];
+          if(chan == EventList::kNCChannel){
+            if(comp.curr == Current::kNC) chanComps[chan] = c;
+            continue;
+          }
+          const Sign::Sign_t sign = EventList::ChannelFrom(chan) > 0 ? Sign::kNu : Sign::kAntiNu;
+          // Channels are numbered in the same order as Flavors_t
+          if(comp.curr == Current::kCC && (comp.sign & sign) &&
+             (comp.flav & (1 << (chan%6)))) chanComps[chan] = c;
+        }
+      }
+
+      for(const ISyst* syst: fSystList){
+        SystMatrices sm;
+        sm.syst = syst;
+        sm.mx = fEvents->Migrations(fOscOrigin.get(), syst, chanComps,
+                                    kNComponents, sm.x0, sm.nKnots);
+        assert(sm.mx.size() == kNComponents*sm.nKnots*N*N);
+
+        // Columns of the nominal knot hold all the weight in each bin. Divide
+        // that out so that the matrices describe fractions
+        const int kNom = -sm.x0;
+        assert(kNom >= 0 && kNom < int(sm.nKnots));
+
+        for(unsigned int c = 0; c < kNComponents; ++c){
+          double* comp = &sm.mx[c*sm.nKnots*N*N];
+          std::vector<double> nom(N);
+          for(unsigned int j = 0; j < N; ++j) nom[j] = comp[(kNom*N+j)*N+j];
+
+          for(unsigned int k = 0; k < sm.nKnots; ++k){
+            double* m = &comp[k*N*N];
+            for(unsigned int j = 0; j < N; ++j){
+              // No events to say otherwise, so leave the bin be
+              if(nom[j] == 0){
+                for(unsigned int i = 0; i < N; ++i) m[i*N+j] = (i == j);
+                continue;
+              }
+              for(unsigned int i = 0; i < N; ++i) m[i*N+j] /= nom[j];
+            }
+          }
+        }
+
+        fMatrices.push_back(std::move(sm));
+      }
+
+      // Everything we need is in the matrices now
+      fEvents.reset();
+    }
+
+    fReady.store(true, std::memory_order_release);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionMigration::Predict(osc::IOscCalculator* calc) const
+  {
+    return PredictComponentSyst(calc, kNoShift,
+                                Flavors::kAll, Current::kBoth, Sign::kBoth);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionMigration::PredictSyst(osc::IOscCalculator* calc,
+                                            const SystShifts& shift) const
+  {
+    return PredictComponentSyst(calc, shift,
+                                Flavors::kAll, Current::kBoth, Sign::kBoth);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionMigration::PredictComponent(osc::IOscCalculator* calc,
+                                                 Flavors::Flavors_t flav,
+                                                 Current::Current_t curr,
+                                                 Sign::Sign_t sign) const
+  {
+    return PredictComponentSyst(calc, kNoShift, flav, curr, sign);
+  }
+
+  //----------------------------------------------------------------------
+  Spectrum PredictionMigration::PredictComponentSyst(osc::IOscCalculator* calc,
+                                                     const SystShifts& shift,
+                                                     Flavors::Flavors_t flav,
+                                                     Current::Current_t curr,
+                                                     Sign::Sign_t sign) const
+  {
+    InitMatrices();
+
+    DontAddDirectory guard;
+
+    TH1D* h = HistCache::New("", fBinning.Bins1D());
+    AddComponentSystTo(calc, shift, flav, curr, sign, fBinning.POT(), h->GetArray());
+
+    return Spectrum(std::unique_ptr<TH1D>(h),
+                    fBinning.GetLabels(), fBinning.GetBinnings(),
+                    fBinning.POT(), fBinning.Livetime());
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionMigration::AddComponentTo(osc::IOscCalculator* calc,
+                                           Flavors::Flavors_t flav,
+                                           Current::Current_t curr,
+                                           Sign::Sign_t sign,
+                                           double pot,
+                                           double* arr) const
+  {
+    fBase->AddComponentTo(calc, flav, curr, sign, pot, arr);
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionMigration::AddComponentSystTo(osc::IOscCalculator* calc,
+                                               const SystShifts& shift,
+                                               Flavors::Flavors_t flav,
+                                               Current::Current_t curr,
+                                               Sign::Sign_t sign,
+                                               double pot,
+                                               double* arr) const
+  {
+    InitMatrices();
+
+    // Split the shift into the parts handled here and by the base prediction
+    std::vector<std::pair<const SystMatrices*, double>> active;
+    SystShifts other;
+    for(const auto& it: shift){
+      if(it.second == 0) continue;
+      auto sm = std::find_if(fMatrices.begin(), fMatrices.end(),
+                             [&it](const SystMatrices& m){return m.syst == it.first;});
+      if(sm == fMatrices.end()) other.SetShift(it.first, it.second);
+    }
+    // Apply the matrices in a fixed order, whatever the order of the shifts
+    for(const SystMatrices& sm: fMatrices){
+      const double x = shift.GetShift(sm.syst);
+      if(x != 0) active.emplace_back(&sm, x);
+    }
+
+    if(active.empty()){
+      fBase->AddComponentSystTo(calc, other, flav, curr, sign, pot, arr);
+      return;
+    }
+
+    if(curr & Current::kNC){
+      assert(flav == Flavors::kAll); // Don't know how to calculate anything else
+      assert(sign == Sign::kBoth);   // Why would you want to split NCs out by sign?
+    }
+
+    const unsigned int N = fBinning.Bins1D().NBins()+2;
+    std::vector<double> in(N), out(N);
+
+    for(unsigned int c = 0; c < kNComponents; ++c){
+      const Component& comp = kComponents[c];
+
+      if(!(curr & comp.curr)) continue;
+      const Flavors::Flavors_t flavC = Flavors::Flavors_t(flav & comp.flav);
+      const Sign::Sign_t signC = Sign::Sign_t(sign & comp.sign);
+      if(!flavC || !signC) continue;
+
+      std::fill(in.begin(), in.end(), 0);
+      fBase->AddComponentSystTo(calc, other, flavC, comp.curr, signC, pot, in.data());
+
+      for(const auto& a: active){
+        const SystMatrices& sm = *a.first;
+
+        // As EventList::InterpKnots, extrapolating the end segments
+        int k = int(std::floor(a.second))-sm.x0;
+        k = std::max(0, std::min(k, int(sm.nKnots)-2));
+        const double t = a.second-(sm.x0+k);
+
+        const double* m0 = &sm.mx[(c*sm.nKnots+k)*N*N];
+        const double* m1 = m0+N*N;
+
+        for(unsigned int i = 0; i < N; ++i){
+          double tot = 0;
+          for(unsigned int j = 0; j < N; ++j){
+            if(in[j] == 0) continue;
+            tot += (m0[i*N+j]+t*(m1[i*N+j]-m0[i*N+j]))*in[j];
+          }
+          out[i] = tot;
+        }
+        in.swap(out);
+      }
+
+      for(unsigned int i = 0; i < N; ++i) arr[i] += std::max(0., in[i]);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  void PredictionMigration::SaveTo(TDirectory* dir) const
+  {
+    InitMatrices();
+
+    TDirectory* tmp = gDirectory;
+
+    dir->cd();
+    TObjString("PredictionMigration").Write("type");
+
+    fBase->SaveTo(dir->mkdir("base"));
+
+    for(unsigned int i = 0; i < fMatrices.size(); ++i){
+      const SystMatrices& sm = fMatrices[i];
+
+      TDirectory* systDir = dir->mkdir(TString::Format("syst%d", i));
+      systDir->cd();
+
+      TObjString(sm.syst->ShortName().c_str()).Write("name");
+      TVectorD knots(2);
+      knots[0] = sm.x0;
+      knots[1] = sm.nKnots;
+      knots.Write("knots");
+      TVectorD(sm.mx.size(), sm.mx.data()).Write("mx");
+    }
+
+    tmp->cd();
+  }
+
+  //----------------------------------------------------------------------
+  std::unique_ptr<PredictionMigration> PredictionMigration::LoadFrom(TDirectory* dir)
+  {
+    TObjString* tag = (TObjString*)dir->Get("type");
+    assert(tag);
+    assert(tag->GetString() == "PredictionMigration");
+    delete tag;
+
+    TDirectory* baseDir = dir->GetDirectory("base");
+    assert(baseDir);
+    std::unique_ptr<PredictionMigration> ret(new PredictionMigration(ana::LoadFrom<IPrediction>(baseDir)));
+    delete baseDir;
+
+    for(int i = 0; ; ++i){
+      TDirectory* systDir = dir->GetDirectory(TString::Format("syst%d", i));
+      if(!systDir) break;
+
+      TObjString* name = (TObjString*)systDir->Get("name");
+      TVectorD* knots = (TVectorD*)systDir->Get("knots");
+      TVectorD* mx = (TVectorD*)systDir->Get("mx");
+      assert(name && knots && mx);
+
+      SystMatrices sm;
+      sm.syst = SystRegistry::ShortNameToSyst(name->GetString().Data());
+      sm.x0 = int((*knots)[0]);
+      sm.nKnots = (unsigned int)((*knots)[1]);
+      sm.mx.assign(mx->GetMatrixArray(), mx->GetMatrixArray()+mx->GetNrows());
+
+      ret->fSystList.push_back(sm.syst);
+      ret->fMatrices.push_back(std::move(sm));
+
+      delete name;
+      delete knots;
+      delete mx;
+      delete systDir;
+    }
+
+    return ret;
+  }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "CAFAna/Prediction/IPrediction.h"
+#include "CAFAna/Prediction/PredictionEventList.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ana
+{
+  class Loaders;
+
+  /// \brief Applies energy-scale systematics to another prediction as
+  /// migration matrices in the reconstructed variable
+  ///
+  /// For each of \a systs and each of its integer shifts, a matrix gives the
+  /// fraction of the nominal contents of each reco bin that ends up in each
+  /// other bin, including any change in weight or events leaving the
+  /// selection. They're made separately for each oscillation channel group,
+  /// as \ref PredictionInterp splits them, weighted by the oscillation
+  /// probabilities at \a osc. All systs and shifts come from one pass over
+  /// the files, via an \ref EventList that is dropped once the matrices are
+  /// made.
+  ///
+  /// A shifted prediction interpolates the matrices linearly between the
+  /// shifts and applies them to the components of \a base, so events move
+  /// between bins rather than each bin being scaled. Shifts of any other
+  /// systs are passed on to \a base.
+  class PredictionMigration: public IPrediction
+  {
+  public:
+    /// \param base    Prediction to apply the migrations to. Should be made
+    ///                from the same loaders, selection and weight
+    /// \param systs   Energy-scale systs to describe with matrices
+    /// \param osc     The oscillation point to weight the events with
+    /// \param shiftMC Underlying shift, as for \ref PredictionInterp
+    PredictionMigration(std::unique_ptr<IPrediction> base,
+                        SpectrumLoaderBase& loaderNonswap,
+                        SpectrumLoaderBase& loaderNue,
+                        SpectrumLoaderBase& loaderNuTau,
+                        const HistAxis& axis,
+                        const Cut& cut,
+                        const std::vector<const ISyst*>& systs,
+                        osc::IOscCalculator* osc,
+                        const SystShifts& shiftMC = kNoShift,
+                        const Var& wei = kUnweighted);
+
+    PredictionMigration(std::unique_ptr<IPrediction> base,
+                        Loaders& loaders,
+                        const HistAxis& axis,
+                        const Cut& cut,
+                        const std::vector<const ISyst*>& systs,
+                        osc::IOscCalculator* osc,
+                        const SystShifts& shiftMC = kNoShift,
+                        const Var& wei = kUnweighted);
+
+    virtual ~PredictionMigration();
+
+    virtual Spectrum Predict(osc::IOscCalculator* calc) const override;
+    virtual Spectrum PredictSyst(osc::IOscCalculator* calc,
+                                 const SystShifts& shift) const override;
+
+    virtual Spectrum PredictComponent(osc::IOscCalculator* calc,
+                                      Flavors::Flavors_t flav,
+                                      Current::Current_t curr,
+                                      Sign::Sign_t sign) const override;
+    virtual Spectrum PredictComponentSyst(osc::IOscCalculator* calc,
+                                          const SystShifts& shift,
+                                          Flavors::Flavors_t flav,
+                                          Current::Current_t curr,
+                                          Sign::Sign_t sign) const override;
+
+    virtual void AddComponentTo(osc::IOscCalculator* calc,
+                                Flavors::Flavors_t flav,
+                                Current::Current_t curr,
+                                Sign::Sign_t sign,
+                                double pot,
+                                double* arr) const override;
+    virtual void AddComponentSystTo(osc::IOscCalculator* calc,
+                                    const SystShifts& shift,
+                                    Flavors::Flavors_t flav,
+                                    Current::Current_t curr,
+                                    Sign::Sign_t sign,
+                                    double pot,
+                                    double* arr) const override;
+
+    std::vector<const ISyst*> GetAllSysts() const;
+
+    virtual void SaveTo(TDirectory* dir) const override;
+    static std::unique_ptr<PredictionMigration> LoadFrom(TDirectory* dir);
+
+    /// The groups of channels with their own matrices
+    struct Component
+    {
+      Flavors::Flavors_t flav;
+      Current::Current_t curr;
+      Sign::Sign_t sign;
+    };
+    static const unsigned int kNComponents = 9;
+    static const Component kComponents[kNComponents];
+
+  protected:
+    /// Constructor for LoadFrom
+    PredictionMigration(std::unique_ptr<IPrediction> base);
+
+    struct SystMatrices
+    {
+      const ISyst* syst;
+      int x0; ///< The lowest shift
+      unsigned int nKnots;
+      /// Indexed [component][knot][to bin][from bin]
+      std::vector<double> mx;
+    };
+
+    /// Make the matrices from the event lists on first use, and settle the
+    /// binning. Safe to call from multiple threads
+    void InitMatrices() const;
+    mutable std::mutex fInitMutex;
+    mutable std::atomic<bool> fReady{false};
+
+    std::unique_ptr<IPrediction> fBase;
+
+    /// Only until the matrices have been made
+    mutable std::unique_ptr<PredictionEventList> fEvents;
+    mutable std::unique_ptr<osc::IOscCalculator> fOscOrigin;
+    std::vector<const ISyst*> fSystList;
+
+    mutable std::vector<SystMatrices> fMatrices;
+
+    /// Dummy spectrum to provide binning. Only written by \ref InitMatrices
+    mutable Spectrum fBinning;
+  };
+}
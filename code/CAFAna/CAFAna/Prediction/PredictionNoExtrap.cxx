@@ -34,9 +34,12 @@ namespace ana
 					 const HistAxis& axis,
                                          const Cut& cut,
                                          const SystShifts& shift,
-                                         const Var& wei)
+                                         const Var& wei,
+                                         const Binning& trueBins,
+                                         bool trimTrueBins)
     : PredictionExtrap(new TrivialExtrap(loaderNonswap, loaderNue, loaderNuTau,
-                                         axis, cut, shift, wei))
+                                         axis, cut, shift, wei,
+                                         trueBins, trimTrueBins))
   {
   }
 
@@ -62,8 +65,11 @@ namespace ana
                                          const HistAxis& axis,
                                          const Cut& cut,
                                          const SystShifts& shift,
-                                         const Var& wei)
-    : PredictionExtrap(new TrivialExtrap(loaders, axis, cut, shift, wei))
+                                         const Var& wei,
+                                         const Binning& trueBins,
+                                         bool trimTrueBins)
+    : PredictionExtrap(new TrivialExtrap(loaders, axis, cut, shift, wei,
+                                         trueBins, trimTrueBins))
   {
   }
 
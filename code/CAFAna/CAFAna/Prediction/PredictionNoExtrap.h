@@ -31,7 +31,9 @@ namespace ana
 		       const HistAxis& axis,
 		       const Cut& cut,
                        const SystShifts& shift = kNoShift,
-                       const Var& wei = kUnweighted);
+                       const Var& wei = kUnweighted,
+                       const Binning& trueBins = kTrueEnergyBins,
+                       bool trimTrueBins = false);
 
     PredictionNoExtrap(Loaders& loaders,
                        const std::string& label,
@@ -45,7 +47,9 @@ namespace ana
                        const HistAxis& axis,
                        const Cut& cut,
                        const SystShifts& shift = kNoShift,
-                       const Var& wei = kUnweighted);
+                       const Var& wei = kUnweighted,
+                       const Binning& trueBins = kTrueEnergyBins,
+                       bool trimTrueBins = false);
 
     virtual ~PredictionNoExtrap();
 
@@ -57,20 +61,27 @@ namespace ana
   class NoExtrapPredictionGenerator: public IPredictionGenerator
   {
   public:
-    NoExtrapPredictionGenerator(HistAxis axis, Cut cut, Var wei = kUnweighted)
-      : fAxis(axis), fCut(cut), fWei(wei)
+    /// \param trueBins     True energy binning of the oscillatable templates
+    /// \param trimTrueBins Drop empty true energy rows after loading
+    NoExtrapPredictionGenerator(HistAxis axis, Cut cut, Var wei = kUnweighted,
+                                Binning trueBins = kTrueEnergyBins,
+                                bool trimTrueBins = false)
+      : fAxis(axis), fCut(cut), fWei(wei),
+        fTrueBins(trueBins), fTrimTrueBins(trimTrueBins)
     {
     }
 
     virtual std::unique_ptr<IPrediction>
     Generate(Loaders& loaders, const SystShifts& shiftMC = kNoShift) const override
     {
-      return std::unique_ptr<IPrediction>(new PredictionNoExtrap(loaders, fAxis, fCut, shiftMC, fWei));
+      return std::unique_ptr<IPrediction>(new PredictionNoExtrap(loaders, fAxis, fCut, shiftMC, fWei, fTrueBins, fTrimTrueBins));
     }
 
   protected:
     HistAxis fAxis;
     Cut fCut;
     Var fWei;
+    Binning fTrueBins;
+    bool fTrimTrueBins;
   };
 }
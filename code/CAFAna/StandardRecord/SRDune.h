@@ -4,29 +4,70 @@
 
 namespace caf
 {
+  /// \brief Per-event record
+  ///
+  /// The members are laid out hot first: the fields that cuts, vars and
+  /// systematic shifts read for almost every event are grouped together at
+  /// the top, with no padding, so that evaluating them touches a handful of
+  /// cache lines rather than the whole record. Rarely used truth and
+  /// bookkeeping follow, and the bulky GENIE universe weights come last.
+  ///
+  /// When adding a field, put it in the hot block only if it's used by the
+  /// standard selections or energy-scale systematics.
   class SRDune
   {
   public:
+    // ---------------------------------------------------------------------
+    // Hot block. Doubles first, then ints, so there are no holes
+
     // Reco info
-    double eRec_FromDep; // Unified parameterized reco that can be used at near and far. Should only be used for missing proton energy fake data studies that cannot use the CVN FD Reco
     double Ev_reco; // for ND?
     double Ev_reco_nue;
     double Ev_reco_numu;
-    double mvaresult;
-    double mvanue;
-    double mvanumu;
-    double cvnnue;
-    double cvnnumu;
-    double cvnnutau;
-    int reco_q;
     double Elep_reco;
-    double theta_reco;
 
     double RecoLepEnNue;
     double RecoHadEnNue;
     double RecoLepEnNumu;
     double RecoHadEnNumu;
 
+    double eRec_FromDep; // Unified parameterized reco that can be used at near and far. Should only be used for missing proton energy fake data studies that cannot use the CVN FD Reco
+
+    double mvaresult;
+    double cvnnue;
+    double cvnnumu;
+    // To prevent errors when compiling DUNENDSysts
+    double nue_pid;
+    double numu_pid;
+
+    double Ehad_veto;
+
+    // Reconstructed energy of particles by species
+    double eRecoP;
+    double eRecoN;
+    double eRecoPip;
+    double eRecoPim;
+    double eRecoPi0;
+
+    // Truth info
+    double Ev;
+    double Y;
+    double LepE;
+
+    double vtx_x;
+    double vtx_y;
+    double vtx_z;
+
+    /// Product of genie_cv_wgt, filled by the loader
+    double total_cv_wgt;
+
+    // config
+    int isFD;
+    int isFHC;
+    int run;
+
+    int reco_q;
+
     // ND pseudo-reconstruction flags
     int reco_numu;
     int reco_nue;
@@ -36,21 +77,7 @@ namespace caf
     // ND containment flags
     int muon_contained;
     int muon_tracker;
-    int muon_ecal;
-    int muon_exit;
-    double Ehad_veto;
-
-    // To prevent errors when compiling DUNENDSysts
-    double nue_pid;
-    double numu_pid;
 
-    // Containment flag
-    int LongestTrackContNumu;
-
-    // Truth info
-    double Ev;
-    double Elep;
-    //  float enu_truth; // so what's this one?
     int isCC;
     //    int ccnc;
     //    int cc;
@@ -58,7 +85,6 @@ namespace caf
     //    int neu;
     int nuPDG;
     int nuPDGunosc;
-    int LepPDG;
 
     // This mode depends on whether the file is ND/FD
     // See converter in SpectrumLoader.cxx that fills GENIE_ScatteringMode
@@ -80,20 +106,23 @@ namespace caf
     /// * GlashowRES: 13
     /// * IMDAnnihalation: 14
     int GENIE_ScatteringMode;
-    int nP;
-    int nN;
-    int nipi0;
-    int nipip;
-    int nipim;
+
+    // ---------------------------------------------------------------------
+    // Cold block. Rarely used reco and truth
+
+    double mvanue;
+    double mvanumu;
+    double cvnnutau;
+    double theta_reco;
+
+    double eRecoOther;
+
+    double Elep;
+    //  float enu_truth; // so what's this one?
     double Q2;
     double W;
-    double Y;
     double X;
 
-    double vtx_x;
-    double vtx_y;
-    double vtx_z;
-
     // Near detector offset in m
     double det_x;
 
@@ -105,14 +134,6 @@ namespace caf
     double ePi0;
     double eOther;
 
-    // Reconstructed energy of particles by species
-    double eRecoP;
-    double eRecoN;
-    double eRecoPip;
-    double eRecoPim;
-    double eRecoPi0;
-    double eRecoOther;
-
     //At FD
     double eDepP;
     double eDepN;
@@ -127,23 +148,37 @@ namespace caf
     double LepMomX;
     double LepMomY;
     double LepMomZ;
-    double LepE;
     double LepNuAngle;
 
-    // config
-    int run;
-    int isFD;
-    int isFHC;
-
     // sigmas
     double sigma_Ev_reco;
     double sigma_Elep_reco;
     double sigma_numu_pid;
     double sigma_nue_pid;
-    double total_cv_wgt;
 
-    // First index is systematic ID
-    std::vector<std::vector<double>> genie_wgt;
+    // CW: added for the ND cuts Chris (M) wants
+    int muon_ecal;
+    int muon_exit;
+
+    // Containment flag
+    int LongestTrackContNumu;
+
+    int LepPDG;
+    int nP;
+    int nN;
+    int nipi0;
+    int nipip;
+    int nipim;
+
+    // ---------------------------------------------------------------------
+    // GENIE weights
+
     std::vector<double> genie_cv_wgt;
+
+    /// \brief First index is systematic ID
+    ///
+    /// Only read from file for events where a systematic shift is being
+    /// applied. Otherwise the inner vectors are empty.
+    std::vector<std::vector<double>> genie_wgt;
   };
 }